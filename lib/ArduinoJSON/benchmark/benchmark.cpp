@@ -0,0 +1,282 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+// Measures parse, lookup and serialize throughput, JsonBuffer size, malloc
+// count and network writes on THiNX documents: those captured from devices
+// and the API (corpus/captured/*.json, when present), hand-written ones
+// (corpus/*.json), generated telemetry arrays and a 128-key configuration push.
+// The results are printed as JSON, to compare a change with the previous
+// release:
+//
+//   ArduinoJsonBenchmark [--iterations N] [--output FILE] corpus/*.json
+//
+// Each measurement goes through N KB of JSON: a 1 KB document is processed N
+// times, a 10 KB one N / 10 times (at least once).
+
+#include <ArduinoJson.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static size_t mallocs;
+
+struct CountingAllocator {
+  void* allocate(size_t n) {
+    mallocs++;
+    return malloc(n);
+  }
+  void deallocate(void* p) {
+    free(p);
+  }
+};
+
+typedef Internals::DynamicJsonBufferBase<CountingAllocator> CountingJsonBuffer;
+
+// Stands for a network client: each write() costs a packet
+struct Socket {
+  size_t writes;
+
+  Socket() : writes(0) {}
+
+  size_t print(char) {
+    writes++;
+    return 1;
+  }
+  size_t print(const char* s) {
+    return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+  }
+  size_t write(const uint8_t*, size_t n) {
+    writes++;
+    return n;
+  }
+};
+
+struct Document {
+  std::string name;
+  std::string json;
+  bool captured;  // recorded traffic, not written for the benchmark
+
+  Document() : captured(false) {}
+};
+
+// Megabytes per second, 0 when too fast to measure
+static double throughput(size_t bytes, size_t count, std::clock_t ticks) {
+  if (ticks <= 0) return 0;
+  double seconds = static_cast<double>(ticks) / CLOCKS_PER_SEC;
+  return static_cast<double>(bytes) * static_cast<double>(count) / seconds /
+         1e6;
+}
+
+static bool readFile(const char* path, Document& doc) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::ostringstream content;
+  content << file.rdbuf();
+  doc.json = content.str();
+  while (!doc.json.empty() && isspace(doc.json[doc.json.size() - 1]))
+    doc.json.erase(doc.json.size() - 1);
+
+  std::string name(path);
+  doc.captured = name.find("captured/") != std::string::npos ||
+                 name.find("captured\\") != std::string::npos;
+  size_t slash = name.find_last_of("/\\");
+  if (slash != std::string::npos) name = name.substr(slash + 1);
+  size_t dot = name.rfind('.');
+  if (dot != std::string::npos) name = name.substr(0, dot);
+  doc.name = name;
+  return true;
+}
+
+// One reading per minute, as published by a THiNX sensor
+static Document telemetry(int count) {
+  std::ostringstream json;
+  json << '[';
+  for (int i = 0; i < count; i++) {
+    if (i) json << ',';
+    json << "{\"t\":" << 1514764800 + i * 60 << ",\"temp\":" << 21 + i % 7
+         << '.' << (i * 37) % 1000 << ",\"hum\":" << 40 + i % 20
+         << ".5,\"rssi\":-" << 60 + i % 25 << ",\"ok\":true}";
+  }
+  json << ']';
+
+  Document doc;
+  std::ostringstream name;
+  name << "Telemetry" << count;
+  doc.name = name.str();
+  doc.json = json.str();
+  return doc;
+}
+
+// A configuration push with many keys, large enough for the object index
+static Document configuration(int count) {
+  std::ostringstream json;
+  json << "{\"configuration\":{";
+  for (int i = 0; i < count; i++) {
+    if (i) json << ',';
+    json << "\"THINX_ENV_" << i << "\":" << i * 7;
+  }
+  json << "}}";
+
+  Document doc;
+  std::ostringstream name;
+  name << "Configuration" << count;
+  doc.name = name.str();
+  doc.json = json.str();
+  return doc;
+}
+
+// Looks up every key of every object, as handlers reading a push do
+static long lookupAll(JsonVariant variant) {
+  long found = 0;
+  if (variant.is<JsonArray>()) {
+    JsonArray& array = variant.as<JsonArray>();
+    for (JsonArray::iterator it = array.begin(); it != array.end(); ++it)
+      found += lookupAll(*it);
+  } else if (variant.is<JsonObject>()) {
+    JsonObject& object = variant.as<JsonObject>();
+    for (JsonObject::iterator it = object.begin(); it != object.end(); ++it) {
+      found += object.containsKey(it->key);
+      found += lookupAll(it->value);
+    }
+  }
+  return found;
+}
+
+static void run(const Document& doc, size_t iterations, JsonArray& results) {
+  const size_t bytes = doc.json.size();
+  size_t count = iterations * 1024 / bytes;
+  if (count == 0) count = 1;
+
+  JsonObject& result = results.createNestedObject();
+  result["name"] = doc.name;
+  result["source"] = doc.captured ? "captured" : "synthetic";
+  result["bytes"] = bytes;
+  result["iterations"] = count;
+
+  // a fresh buffer shows the malloc count and final size of one parse
+  mallocs = 0;
+  CountingJsonBuffer measured;
+  JsonVariant root = measured.parse(doc.json.c_str());
+  if (!root.success()) {
+    result["error"] = "parse failed";
+    return;
+  }
+  JsonObject& parse = result.createNestedObject("parse");
+  parse["json_buffer_size"] = measured.size();
+  parse["mallocs"] = mallocs;
+
+  // from a char[], strings stay in the input (zero-copy)
+  std::vector<char> input(bytes + 1);
+  CountingJsonBuffer jb;
+  std::clock_t start = std::clock();
+  for (size_t i = 0; i < count; i++) {
+    memcpy(&input[0], doc.json.c_str(), bytes + 1);
+    jb.parse(&input[0]);
+    jb.reset();
+  }
+  parse["in_place_mbps"] = throughput(bytes, count, std::clock() - start);
+
+  // from a const char*, strings are copied into the JsonBuffer
+  start = std::clock();
+  for (size_t i = 0; i < count; i++) {
+    jb.parse(doc.json.c_str());
+    jb.reset();
+  }
+  parse["copy_mbps"] = throughput(bytes, count, std::clock() - start);
+
+  std::string packed;
+  root.msgPackTo(packed);
+  start = std::clock();
+  for (size_t i = 0; i < count; i++) {
+    jb.parseMsgPack(packed.data(), packed.size());
+    jb.reset();
+  }
+  parse["msgpack_mbps"] = throughput(bytes, count, std::clock() - start);
+
+  long found = 0;
+  start = std::clock();
+  for (size_t i = 0; i < count; i++) found += lookupAll(root);
+  result["lookup_mbps"] = throughput(bytes, count, std::clock() - start);
+  result["lookups"] = found / static_cast<long>(count);
+
+  JsonObject& serialize = result.createNestedObject("serialize");
+  std::vector<char> output(bytes * 2 + 1);
+
+  start = std::clock();
+  for (size_t i = 0; i < count; i++) root.printTo(&output[0], output.size());
+  serialize["print_mbps"] = throughput(bytes, count, std::clock() - start);
+
+  start = std::clock();
+  for (size_t i = 0; i < count; i++) root.measureLength();
+  serialize["measure_mbps"] = throughput(bytes, count, std::clock() - start);
+
+  size_t msgPackBytes = 0;
+  start = std::clock();
+  for (size_t i = 0; i < count; i++)
+    msgPackBytes = root.msgPackTo(&output[0], output.size());
+  serialize["msgpack_mbps"] = throughput(bytes, count, std::clock() - start);
+  serialize["msgpack_bytes"] = msgPackBytes;
+
+  // write() calls to a network client, direct and through BufferedPrint
+  Socket direct, buffered;
+  root.printTo(direct);
+  {
+    BufferedPrint<Socket> out(buffered);
+    root.printTo(out);
+  }
+  serialize["writes"] = direct.writes;
+  serialize["buffered_writes"] = buffered.writes;
+}
+
+int main(int argc, const char* argv[]) {
+  size_t iterations = 10000;
+  const char* outputPath = NULL;
+  std::vector<Document> corpus;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = static_cast<size_t>(strtoul(argv[++i], NULL, 10));
+    } else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else {
+      Document doc;
+      if (!readFile(argv[i], doc)) {
+        std::cerr << "Cannot read " << argv[i] << std::endl;
+        return 1;
+      }
+      corpus.push_back(doc);
+    }
+  }
+  size_t captured = 0;
+  for (size_t i = 0; i < corpus.size(); i++)
+    if (corpus[i].captured) captured++;
+  corpus.push_back(telemetry(100));
+  corpus.push_back(telemetry(1000));
+  corpus.push_back(configuration(128));
+
+  DynamicJsonBuffer jb;
+  JsonObject& report = jb.createObject();
+  report["corpus"] = captured ? "captured and synthetic" : "synthetic";
+  report["captured_documents"] = captured;
+  report["kb_per_measurement"] = iterations;
+  JsonArray& results = report.createNestedArray("documents");
+  for (size_t i = 0; i < corpus.size(); i++)
+    run(corpus[i], iterations, results);
+
+  std::string json;
+  report.prettyPrintTo(json);
+  if (outputPath) {
+    std::ofstream file(outputPath);
+    file << json << std::endl;
+  } else {
+    std::cout << json << std::endl;
+  }
+  return 0;
+}
@@ -7,11 +7,16 @@
 #include "ArduinoJson/DynamicJsonBuffer.hpp"
 #include "ArduinoJson/JsonArray.hpp"
 #include "ArduinoJson/JsonObject.hpp"
+#include "ArduinoJson/Serialization/BufferedPrint.hpp"
+#include "ArduinoJson/Serialization/ChunkedJsonSerializer.hpp"
 #include "ArduinoJson/StaticJsonBuffer.hpp"
 
 #include "ArduinoJson/Deserialization/JsonParserImpl.hpp"
+#include "ArduinoJson/Deserialization/MsgPackParserImpl.hpp"
 #include "ArduinoJson/JsonArrayImpl.hpp"
 #include "ArduinoJson/JsonBufferImpl.hpp"
 #include "ArduinoJson/JsonObjectImpl.hpp"
 #include "ArduinoJson/JsonVariantImpl.hpp"
+#include "ArduinoJson/Serialization/ChunkedJsonSerializerImpl.hpp"
 #include "ArduinoJson/Serialization/JsonSerializerImpl.hpp"
+#include "ArduinoJson/Serialization/MsgPackSerializerImpl.hpp"
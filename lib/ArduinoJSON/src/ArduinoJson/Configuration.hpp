@@ -146,6 +146,31 @@
 #define ARDUINOJSON_NEGATIVE_EXPONENTIATION_THRESHOLD 1e-5
 #endif
 
+// Write floats with the shortest digits that read back as the same value
+// (up to 17 significant digits for a double, 9 for a float) instead of a
+// fixed 9 or 6 decimal places. Adds about 1 KB of constant data.
+#ifndef ARDUINOJSON_ENABLE_SHORTEST_FLOAT
+#define ARDUINOJSON_ENABLE_SHORTEST_FLOAT 0
+#endif
+
+// Index big objects for constant time key lookups.
+// Adds a pointer to every JsonObject; the index of an object with n members
+// takes 4 to 8 pointers per member from the JsonBuffer (12 to 16 while it
+// grows). All translation units must agree on this setting.
+#ifndef ARDUINOJSON_ENABLE_OBJECT_INDEX
+#define ARDUINOJSON_ENABLE_OBJECT_INDEX 0
+#endif
+
+// Number of members a lookup must go through before the object gets indexed
+#ifndef ARDUINOJSON_OBJECT_INDEX_THRESHOLD
+#define ARDUINOJSON_OBJECT_INDEX_THRESHOLD 16
+#endif
+
+// Control the longest key a filtered parse can match
+#ifndef ARDUINOJSON_FILTER_KEY_SIZE
+#define ARDUINOJSON_FILTER_KEY_SIZE 32
+#endif
+
 #if ARDUINOJSON_USE_LONG_LONG && ARDUINOJSON_USE_INT64
 #error ARDUINOJSON_USE_LONG_LONG and ARDUINOJSON_USE_INT64 cannot be set together
 #endif
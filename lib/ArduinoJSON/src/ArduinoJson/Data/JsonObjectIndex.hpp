@@ -0,0 +1,86 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../JsonBuffer.hpp"
+#include "../JsonPair.hpp"
+#include "../StringTraits/StringTraits.hpp"
+#include "ListNode.hpp"
+
+namespace ArduinoJson {
+namespace Internals {
+
+// An open-addressing hash table from keys to the nodes of a JsonObject.
+// It is allocated in the JsonBuffer, like the object itself. It starts at most
+// a quarter full; when it gets half full, the object builds a new one and
+// the old one is abandoned.
+class JsonObjectIndex {
+ public:
+  typedef ListNode<JsonPair> node_type;
+
+  // Creates an index of the given nodes, or returns NULL if the buffer is full
+  static JsonObjectIndex *create(JsonBuffer *buffer, node_type *first) {
+    size_t count = 0;
+    for (node_type *node = first; node; node = node->next) count++;
+
+    size_t capacity = 8;
+    while (capacity < count * 4) capacity *= 2;
+
+    void *p = buffer->alloc(sizeof(JsonObjectIndex) +
+                            (capacity - 1) * sizeof(node_type *));
+    if (!p) return NULL;
+
+    JsonObjectIndex *index = static_cast<JsonObjectIndex *>(p);
+    index->_capacity = capacity;
+    index->_count = 0;
+    for (size_t i = 0; i < capacity; i++) index->_slots[i] = NULL;
+    for (node_type *node = first; node; node = node->next) index->add(node);
+    return index;
+  }
+
+  // Returns the node with the specified key, or NULL
+  template <typename TStringRef>
+  node_type *find(TStringRef key) const {
+    size_t mask = _capacity - 1;
+    for (size_t i = hash<TStringRef>(key) & mask;; i = (i + 1) & mask) {
+      node_type *node = _slots[i];
+      if (!node) return NULL;
+      if (StringTraits<TStringRef>::equals(key, node->content.key))
+        return node;
+    }
+  }
+
+  // Adds a node whose key is not in the index yet
+  void add(node_type *node) {
+    size_t mask = _capacity - 1;
+    size_t i = hash<const char *>(node->content.key) & mask;
+    while (_slots[i]) i = (i + 1) & mask;
+    _slots[i] = node;
+    _count++;
+  }
+
+  bool isFull() const {
+    return _count * 2 >= _capacity;
+  }
+
+ private:
+  // FNV-1a, reads the key the same way regardless of its type
+  template <typename TStringRef>
+  static size_t hash(TStringRef key) {
+    typename StringTraits<TStringRef>::Reader reader(key);
+    uint32_t h = 2166136261UL;
+    for (char c = reader.current(); c; reader.move(), c = reader.current()) {
+      h ^= static_cast<uint8_t>(c);
+      h *= 16777619UL;
+    }
+    return h;
+  }
+
+  size_t _capacity;  // power of two
+  size_t _count;
+  node_type *_slots[1];
+};
+}
+}
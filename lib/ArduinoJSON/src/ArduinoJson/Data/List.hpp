@@ -85,6 +85,10 @@ class List {
   }
 
  protected:
+  static node_type *nodeOf(iterator it) {
+    return it._node;
+  }
+
   JsonBuffer *_buffer;
 
  private:
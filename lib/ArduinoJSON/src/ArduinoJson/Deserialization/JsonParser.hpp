@@ -27,6 +27,7 @@ class JsonParser {
 
   JsonArray &parseArray();
   JsonObject &parseObject();
+  JsonObject &parseObject(const JsonObject &filter);
 
   JsonVariant parseVariant() {
     JsonVariant result;
@@ -49,6 +50,19 @@ class JsonParser {
   inline bool parseObjectTo(JsonVariant *destination);
   inline bool parseStringTo(JsonVariant *destination);
 
+  // Filtered parsing: only what the filter selects is stored
+  JsonArray &parseArray(const JsonVariant &filter);
+  bool parseFilteredTo(JsonVariant *destination, const JsonVariant &filter);
+  bool parseKey(char (&key)[ARDUINOJSON_FILTER_KEY_SIZE]);
+  const char *copyString(const char *s);
+  bool skipAnything();
+  bool skipString();
+
+  static inline bool isSelected(const JsonVariant &filter) {
+    return filter.is<JsonObject>() || filter.is<JsonArray>() ||
+           (filter.is<bool>() && filter.as<bool>());
+  }
+
   static inline bool isBetween(char c, char min, char max) {
     return min <= c && c <= max;
   }
@@ -187,3 +187,255 @@ inline bool ArduinoJson::Internals::JsonParser<TReader, TWriter>::parseStringTo(
   }
   return true;
 }
+
+template <typename TReader, typename TWriter>
+inline ArduinoJson::JsonObject &
+ArduinoJson::Internals::JsonParser<TReader, TWriter>::parseObject(
+    const JsonObject &filter) {
+  if (_nestingLimit == 0) return JsonObject::invalid();
+  _nestingLimit--;
+
+  // Create an empty object
+  JsonObject &object = _buffer->createObject();
+
+  // Check opening brace
+  if (!eat('{')) goto ERROR_MISSING_BRACE;
+  if (eat('}')) goto SUCCESS_EMPTY_OBJECT;
+
+  // Read each key value pair
+  for (;;) {
+    // 1 - Parse key, kept out of the buffer until selected
+    char key[ARDUINOJSON_FILTER_KEY_SIZE];
+    bool fits = parseKey(key);
+    if (!eat(':')) goto ERROR_MISSING_COLON;
+
+    // 2 - Parse or skip value
+    JsonVariant subFilter;
+    if (fits) subFilter = filter.get<JsonVariant>(key);
+    if (!isSelected(subFilter)) subFilter = filter.get<JsonVariant>("*");
+    if (fits && isSelected(subFilter)) {
+      JsonVariant value;
+      if (!parseFilteredTo(&value, subFilter)) goto ERROR_INVALID_VALUE;
+      if (value.success()) {
+        const char *storedKey = copyString(key);
+        if (!storedKey) goto ERROR_NO_MEMORY;
+        if (!object.set(storedKey, value)) goto ERROR_NO_MEMORY;
+      }
+    } else {
+      if (!skipAnything()) goto ERROR_INVALID_VALUE;
+    }
+
+    // 3 - More keys/values?
+    if (eat('}')) goto SUCCESS_NON_EMPTY_OBJECT;
+    if (!eat(',')) goto ERROR_MISSING_COMMA;
+  }
+
+SUCCESS_EMPTY_OBJECT:
+SUCCESS_NON_EMPTY_OBJECT:
+  _nestingLimit++;
+  return object;
+
+ERROR_INVALID_VALUE:
+ERROR_MISSING_BRACE:
+ERROR_MISSING_COLON:
+ERROR_MISSING_COMMA:
+ERROR_NO_MEMORY:
+  return JsonObject::invalid();
+}
+
+template <typename TReader, typename TWriter>
+inline ArduinoJson::JsonArray &
+ArduinoJson::Internals::JsonParser<TReader, TWriter>::parseArray(
+    const JsonVariant &filter) {
+  if (_nestingLimit == 0) return JsonArray::invalid();
+  _nestingLimit--;
+
+  // The first element of the filter applies to every element
+  JsonVariant elementFilter = filter.as<JsonArray>().get<JsonVariant>(0);
+
+  // Create an empty array
+  JsonArray &array = _buffer->createArray();
+
+  // Check opening braket
+  if (!eat('[')) goto ERROR_MISSING_BRACKET;
+  if (eat(']')) goto SUCCESS_EMPTY_ARRAY;
+
+  // Read each value
+  for (;;) {
+    // 1 - Parse or skip value
+    if (isSelected(elementFilter)) {
+      JsonVariant value;
+      if (!parseFilteredTo(&value, elementFilter)) goto ERROR_INVALID_VALUE;
+      if (value.success() && !array.add(value)) goto ERROR_NO_MEMORY;
+    } else {
+      if (!skipAnything()) goto ERROR_INVALID_VALUE;
+    }
+
+    // 2 - More values?
+    if (eat(']')) goto SUCCES_NON_EMPTY_ARRAY;
+    if (!eat(',')) goto ERROR_MISSING_COMMA;
+  }
+
+SUCCESS_EMPTY_ARRAY:
+SUCCES_NON_EMPTY_ARRAY:
+  _nestingLimit++;
+  return array;
+
+ERROR_INVALID_VALUE:
+ERROR_MISSING_BRACKET:
+ERROR_MISSING_COMMA:
+ERROR_NO_MEMORY:
+  return JsonArray::invalid();
+}
+
+// Leaves destination undefined when the value doesn't match the filter
+template <typename TReader, typename TWriter>
+inline bool
+ArduinoJson::Internals::JsonParser<TReader, TWriter>::parseFilteredTo(
+    JsonVariant *destination, const JsonVariant &filter) {
+  if (filter.is<bool>()) return parseAnythingTo(destination);
+
+  skipSpacesAndComments(_reader);
+
+  switch (_reader.current()) {
+    case '[':
+      if (!filter.is<JsonArray>()) return skipAnything();
+      {
+        JsonArray &array = parseArray(filter);
+        if (!array.success()) return false;
+        *destination = array;
+      }
+      return true;
+
+    case '{':
+      if (!filter.is<JsonObject>()) return skipAnything();
+      {
+        JsonObject &object = parseObject(filter.as<JsonObject>());
+        if (!object.success()) return false;
+        *destination = object;
+      }
+      return true;
+
+    default:
+      return skipAnything();
+  }
+}
+
+// Reads a key into a fixed buffer; returns false if it was truncated
+template <typename TReader, typename TWriter>
+inline bool ArduinoJson::Internals::JsonParser<TReader, TWriter>::parseKey(
+    char (&key)[ARDUINOJSON_FILTER_KEY_SIZE]) {
+  size_t length = 0;
+  bool fits = true;
+
+  skipSpacesAndComments(_reader);
+  char c = _reader.current();
+
+  if (isQuote(c)) {  // quotes
+    _reader.move();
+    char stopChar = c;
+    for (;;) {
+      c = _reader.current();
+      if (c == '\0') break;
+      _reader.move();
+
+      if (c == stopChar) break;
+
+      if (c == '\\') {
+        // replace char
+        c = Encoding::unescapeChar(_reader.current());
+        if (c == '\0') break;
+        _reader.move();
+      }
+
+      if (length < ARDUINOJSON_FILTER_KEY_SIZE - 1)
+        key[length++] = c;
+      else
+        fits = false;
+    }
+  } else {  // no quotes
+    for (;;) {
+      if (!canBeInNonQuotedString(c)) break;
+      _reader.move();
+      if (length < ARDUINOJSON_FILTER_KEY_SIZE - 1)
+        key[length++] = c;
+      else
+        fits = false;
+      c = _reader.current();
+    }
+  }
+
+  key[length] = '\0';
+  return fits;
+}
+
+template <typename TReader, typename TWriter>
+inline const char *
+ArduinoJson::Internals::JsonParser<TReader, TWriter>::copyString(
+    const char *s) {
+  typename RemoveReference<TWriter>::type::String str = _writer.startString();
+  while (*s) str.append(*s++);
+  return str.c_str();
+}
+
+template <typename TReader, typename TWriter>
+inline bool
+ArduinoJson::Internals::JsonParser<TReader, TWriter>::skipAnything() {
+  skipSpacesAndComments(_reader);
+
+  switch (_reader.current()) {
+    case '[':
+    case '{': {
+      if (_nestingLimit == 0) return false;
+      _nestingLimit--;
+
+      char closing = _reader.current() == '[' ? ']' : '}';
+      bool isObject = closing == '}';
+      _reader.move();
+      if (!eat(closing)) {
+        for (;;) {
+          if (isObject && (!skipString() || !eat(':'))) return false;
+          if (!skipAnything()) return false;
+          if (eat(closing)) break;
+          if (!eat(',')) return false;
+        }
+      }
+
+      _nestingLimit++;
+      return true;
+    }
+
+    default:
+      return skipString();
+  }
+}
+
+template <typename TReader, typename TWriter>
+inline bool ArduinoJson::Internals::JsonParser<TReader, TWriter>::skipString() {
+  skipSpacesAndComments(_reader);
+  char c = _reader.current();
+
+  if (isQuote(c)) {  // quotes
+    _reader.move();
+    char stopChar = c;
+    for (;;) {
+      c = _reader.current();
+      if (c == '\0') return false;
+      _reader.move();
+
+      if (c == stopChar) return true;
+
+      if (c == '\\') {
+        if (_reader.current() == '\0') return false;
+        _reader.move();
+      }
+    }
+  }
+
+  // no quotes
+  while (canBeInNonQuotedString(c)) {
+    _reader.move();
+    c = _reader.current();
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../JsonBuffer.hpp"
+#include "../JsonVariant.hpp"
+
+namespace ArduinoJson {
+namespace Internals {
+
+// Parse MessagePack to create JsonArrays and JsonObjects
+// This internal class is not indended to be used directly.
+// Instead, use JsonBuffer.parseMsgPackArray() or .parseMsgPackObject()
+//
+// Unlike JsonParser, the input is not modified: MessagePack strings are not
+// null-terminated, so they are copied into the JsonBuffer.
+class MsgPackParser {
+ public:
+  MsgPackParser(JsonBuffer *buffer, const uint8_t *data, size_t size,
+                uint8_t nestingLimit)
+      : _buffer(buffer),
+        _ptr(data),
+        _end(data ? data + size : data),
+        _nestingLimit(nestingLimit) {}
+
+  JsonArray &parseArray();
+  JsonObject &parseObject();
+
+  JsonVariant parseVariant() {
+    JsonVariant result;
+    parseAnythingTo(&result);
+    return result;
+  }
+
+ private:
+  MsgPackParser &operator=(const MsgPackParser &);  // non-copiable
+
+  bool parseAnythingTo(JsonVariant *destination);
+  bool parseArrayTo(JsonVariant *destination, size_t size);
+  bool parseObjectTo(JsonVariant *destination, size_t size);
+  bool parseArrayBody(JsonArray &array, size_t size);
+  bool parseObjectBody(JsonObject &object, size_t size);
+  bool readString(const char **destination, size_t size);
+  bool readString(const char **destination);  // reads header, then string
+
+  bool readArraySize(size_t *size);
+  bool readObjectSize(size_t *size);
+
+  bool readByte(uint8_t *value) {
+    if (_ptr >= _end) return false;
+    *value = *_ptr++;
+    return true;
+  }
+
+  // Reads a big endian unsigned integer of n bytes; bits that don't fit in
+  // JsonUInt are dropped.
+  bool readUInt(JsonUInt *value, size_t n) {
+    if (size_t(_end - _ptr) < n) return false;
+    JsonUInt result = 0;
+    while (n--) result = JsonUInt(result << 8) | *_ptr++;
+    *value = result;
+    return true;
+  }
+
+  bool readSize(size_t *size, size_t n) {
+    JsonUInt value;
+    if (!readUInt(&value, n)) return false;
+    *size = size_t(value);
+    return true;
+  }
+
+  template <typename T>
+  bool readFloat(JsonFloat *value) {
+    if (size_t(_end - _ptr) < sizeof(T)) return false;
+    T native;
+    copyBigEndian(&native, _ptr, sizeof(T));
+    _ptr += sizeof(T);
+    *value = static_cast<JsonFloat>(native);
+    return true;
+  }
+
+  // Every element needs at least one byte, this rejects absurd sizes early
+  bool fits(size_t elements) const {
+    return elements <= size_t(_end - _ptr);
+  }
+
+  JsonBuffer *_buffer;
+  const uint8_t *_ptr;
+  const uint8_t *_end;
+  uint8_t _nestingLimit;
+};
+}  // namespace Internals
+}  // namespace ArduinoJson
@@ -0,0 +1,252 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../Polyfills/bigEndian.hpp"
+#include "../RawJson.hpp"
+#include "MsgPackParser.hpp"
+
+inline bool ArduinoJson::Internals::MsgPackParser::parseAnythingTo(
+    JsonVariant *destination) {
+  uint8_t code;
+  if (!readByte(&code)) return false;
+
+  if (code <= 0x7f) {  // positive fixint
+    *destination = JsonUInt(code);
+    return true;
+  }
+  if (code >= 0xe0) {  // negative fixint
+    *destination = int(code) - 0x100;
+    return true;
+  }
+  if ((code & 0xf0) == 0x80) return parseObjectTo(destination, code & 0x0f);
+  if ((code & 0xf0) == 0x90) return parseArrayTo(destination, code & 0x0f);
+
+  const char *str;
+  JsonUInt u;
+  JsonFloat f;
+  size_t size;
+
+  switch (code) {
+    case 0xc0:  // nil
+      *destination = RawJson("null");
+      return true;
+
+    case 0xc2:
+      *destination = false;
+      return true;
+
+    case 0xc3:
+      *destination = true;
+      return true;
+
+    case 0xca:
+      if (!readFloat<float>(&f)) return false;
+      *destination = f;
+      return true;
+
+    case 0xcb:
+      if (!readFloat<double>(&f)) return false;
+      *destination = f;
+      return true;
+
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+      if (!readUInt(&u, size_t(1) << (code - 0xcc))) return false;
+      *destination = u;
+      return true;
+
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: {
+      size_t n = size_t(1) << (code - 0xd0);
+      if (!readUInt(&u, n)) return false;
+      // sign extend from n bytes (no-op for 8 bytes or when JsonUInt is
+      // narrower)
+      if (n < sizeof(JsonUInt) && (u >> (8 * n - 1)) != 0)
+        u |= ~JsonUInt(0) << (8 * n);
+      *destination = JsonInteger(u);
+      return true;
+    }
+
+    case 0xc4:  // bin 8/16/32 are exposed as strings
+    case 0xd9:  // str 8
+      if (!readSize(&size, 1)) return false;
+      break;
+
+    case 0xc5:
+    case 0xda:  // str 16
+      if (!readSize(&size, 2)) return false;
+      break;
+
+    case 0xc6:
+    case 0xdb:  // str 32
+      if (!readSize(&size, 4)) return false;
+      break;
+
+    case 0xdc:
+      return readSize(&size, 2) && parseArrayTo(destination, size);
+
+    case 0xdd:
+      return readSize(&size, 4) && parseArrayTo(destination, size);
+
+    case 0xde:
+      return readSize(&size, 2) && parseObjectTo(destination, size);
+
+    case 0xdf:
+      return readSize(&size, 4) && parseObjectTo(destination, size);
+
+    default:
+      if ((code & 0xe0) == 0xa0) {  // fixstr
+        size = code & 0x1f;
+        break;
+      }
+      return false;  // extension types are not supported
+  }
+
+  if (!readString(&str, size)) return false;
+  *destination = str;
+  return true;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::readString(
+    const char **destination, size_t size) {
+  if (size_t(_end - _ptr) < size) return false;
+  char *str = static_cast<char *>(_buffer->alloc(size + 1));
+  if (!str) return false;
+  memcpy(str, _ptr, size);
+  str[size] = '\0';
+  _ptr += size;
+  *destination = str;
+  return true;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::readString(
+    const char **destination) {
+  uint8_t code;
+  size_t size;
+  if (!readByte(&code)) return false;
+  if ((code & 0xe0) == 0xa0) {
+    size = code & 0x1f;
+  } else if (code == 0xd9) {
+    if (!readSize(&size, 1)) return false;
+  } else if (code == 0xda) {
+    if (!readSize(&size, 2)) return false;
+  } else if (code == 0xdb) {
+    if (!readSize(&size, 4)) return false;
+  } else {
+    return false;  // keys must be strings
+  }
+  return readString(destination, size);
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::readArraySize(
+    size_t *size) {
+  uint8_t code;
+  if (!readByte(&code)) return false;
+  if ((code & 0xf0) == 0x90) {
+    *size = code & 0x0f;
+    return true;
+  }
+  if (code == 0xdc) return readSize(size, 2);
+  if (code == 0xdd) return readSize(size, 4);
+  return false;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::readObjectSize(
+    size_t *size) {
+  uint8_t code;
+  if (!readByte(&code)) return false;
+  if ((code & 0xf0) == 0x80) {
+    *size = code & 0x0f;
+    return true;
+  }
+  if (code == 0xde) return readSize(size, 2);
+  if (code == 0xdf) return readSize(size, 4);
+  return false;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::parseArrayBody(
+    JsonArray &array, size_t size) {
+  if (!fits(size)) return false;
+  while (size--) {
+    JsonVariant value;
+    if (!parseAnythingTo(&value)) return false;
+    if (!array.add(value)) return false;
+  }
+  return true;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::parseObjectBody(
+    JsonObject &object, size_t size) {
+  if (!fits(size)) return false;
+  while (size--) {
+    const char *key;
+    if (!readString(&key)) return false;
+    JsonVariant value;
+    if (!parseAnythingTo(&value)) return false;
+    if (!object.set(key, value)) return false;
+  }
+  return true;
+}
+
+inline ArduinoJson::JsonArray &
+ArduinoJson::Internals::MsgPackParser::parseArray() {
+  size_t size;
+  if (_nestingLimit == 0) return JsonArray::invalid();
+  if (!readArraySize(&size)) return JsonArray::invalid();
+  _nestingLimit--;
+
+  JsonArray &array = _buffer->createArray();
+  if (!array.success() || !parseArrayBody(array, size))
+    return JsonArray::invalid();
+
+  _nestingLimit++;
+  return array;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::parseArrayTo(
+    JsonVariant *destination, size_t size) {
+  if (_nestingLimit == 0) return false;
+  _nestingLimit--;
+
+  JsonArray &array = _buffer->createArray();
+  if (!array.success() || !parseArrayBody(array, size)) return false;
+
+  _nestingLimit++;
+  *destination = array;
+  return true;
+}
+
+inline ArduinoJson::JsonObject &
+ArduinoJson::Internals::MsgPackParser::parseObject() {
+  size_t size;
+  if (_nestingLimit == 0) return JsonObject::invalid();
+  if (!readObjectSize(&size)) return JsonObject::invalid();
+  _nestingLimit--;
+
+  JsonObject &object = _buffer->createObject();
+  if (!object.success() || !parseObjectBody(object, size))
+    return JsonObject::invalid();
+
+  _nestingLimit++;
+  return object;
+}
+
+inline bool ArduinoJson::Internals::MsgPackParser::parseObjectTo(
+    JsonVariant *destination, size_t size) {
+  if (_nestingLimit == 0) return false;
+  _nestingLimit--;
+
+  JsonObject &object = _buffer->createObject();
+  if (!object.success() || !parseObjectBody(object, size)) return false;
+
+  _nestingLimit++;
+  *destination = object;
+  return true;
+}
@@ -30,6 +30,40 @@ class DefaultAllocator {
   }
 };
 
+// Hands out up to SLOT_COUNT blocks of SLOT_SIZE bytes from a fixed pool,
+// so a long-lived buffer never touches the heap.
+// Requests larger than SLOT_SIZE fail.
+template <size_t SLOT_SIZE, size_t SLOT_COUNT>
+class FixedBlockAllocator {
+  union Slot {
+    Slot* next;
+    uint8_t data[SLOT_SIZE];
+  };
+
+ public:
+  FixedBlockAllocator() : _free(NULL) {
+    for (size_t i = 0; i < SLOT_COUNT; i++) deallocate(&_slots[i]);
+  }
+
+  void* allocate(size_t size) {
+    if (size > SLOT_SIZE || _free == NULL) return NULL;
+    Slot* slot = _free;
+    _free = slot->next;
+    return slot;
+  }
+
+  void deallocate(void* pointer) {
+    if (pointer == NULL) return;
+    Slot* slot = static_cast<Slot*>(pointer);
+    slot->next = _free;
+    _free = slot;
+  }
+
+ private:
+  Slot _slots[SLOT_COUNT];
+  Slot* _free;
+};
+
 template <typename TAllocator>
 class DynamicJsonBufferBase
     : public JsonBufferBase<DynamicJsonBufferBase<TAllocator> > {
@@ -79,6 +113,29 @@ class DynamicJsonBufferBase
     _head = 0;
   }
 
+  // Resets the buffer but keeps its largest block for the next document,
+  // so a long-lived buffer stops allocating once it has grown big enough.
+  // USE WITH CAUTION: this invalidates all previously allocated data
+  void reset() {
+    Block* largest = _head;
+    Block* currentBlock = _head;
+    while (currentBlock != NULL) {
+      if (currentBlock->capacity > largest->capacity) largest = currentBlock;
+      currentBlock = currentBlock->next;
+    }
+    currentBlock = _head;
+    while (currentBlock != NULL) {
+      Block* nextBlock = currentBlock->next;
+      if (currentBlock != largest) _allocator.deallocate(currentBlock);
+      currentBlock = nextBlock;
+    }
+    _head = largest;
+    if (_head) {
+      _head->next = NULL;
+      _head->size = 0;
+    }
+  }
+
   class String {
    public:
     String(DynamicJsonBufferBase* parent)
@@ -132,8 +189,13 @@ class DynamicJsonBufferBase
   void* allocInNewBlock(size_t bytes) {
     size_t capacity = _nextBlockCapacity;
     if (bytes > capacity) capacity = bytes;
-    if (!addNewBlock(capacity)) return NULL;
-    _nextBlockCapacity *= 2;
+    if (addNewBlock(capacity)) {
+      _nextBlockCapacity *= 2;
+    } else {
+      // can't grow (fragmented heap, fixed-size pool): retry at current size
+      if (_head == NULL || bytes > _head->capacity) return NULL;
+      if (!addNewBlock(_head->capacity)) return NULL;
+    }
     return allocInHead(bytes);
   }
 
@@ -154,6 +216,21 @@ class DynamicJsonBufferBase
 };
 }
 
+// Implements a JsonBuffer whose blocks come from a fixed pool of SLOT_COUNT
+// blocks of SLOT_SIZE bytes (block header included) instead of the heap.
+// Combine with reset() to reuse the same memory for every document.
+template <size_t SLOT_SIZE, size_t SLOT_COUNT>
+class PooledJsonBuffer
+    : public Internals::DynamicJsonBufferBase<
+          Internals::FixedBlockAllocator<SLOT_SIZE, SLOT_COUNT> > {
+  typedef Internals::DynamicJsonBufferBase<
+      Internals::FixedBlockAllocator<SLOT_SIZE, SLOT_COUNT> >
+      base_type;
+
+ public:
+  PooledJsonBuffer() : base_type(SLOT_SIZE - base_type::EmptyBlockSize) {}
+};
+
 #if defined(__clang__)
 #pragma clang diagnostic pop
 #elif defined(__GNUC__)
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "Deserialization/JsonParser.hpp"
+#include "Deserialization/MsgPackParser.hpp"
 
 namespace ArduinoJson {
 namespace Internals {
@@ -86,6 +87,46 @@ class JsonBufferBase : public JsonBuffer {
     return Internals::makeParser(that(), json, nestingLimit).parseObject();
   }
 
+  // Allocates and populate a JsonObject with only the members selected by
+  // a filter, skipping the rest of the input without storing it.
+  //
+  // In the filter, a member set to true selects the whole value, a nested
+  // object filters a nested object, an array holding one filter applies it
+  // to every element, and the key "*" matches any key. Keys longer than
+  // ARDUINOJSON_FILTER_KEY_SIZE - 1 are skipped.
+  // With a stream, the JsonBuffer only has to hold the selected members.
+  //
+  // JsonObject& parseObject(TString, const JsonObject& filter);
+  // TString = const std::string&, const String&
+  template <typename TString>
+  typename Internals::EnableIf<!Internals::IsArray<TString>::value,
+                               JsonObject &>::type
+  parseObject(const TString &json, const JsonObject &filter,
+              uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return Internals::makeParser(that(), json, nestingLimit)
+        .parseObject(filter);
+  }
+  //
+  // JsonObject& parseObject(TString, const JsonObject& filter);
+  // TString = const char*, const char[N], const FlashStringHelper*
+  template <typename TString>
+  JsonObject &parseObject(
+      TString *json, const JsonObject &filter,
+      uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return Internals::makeParser(that(), json, nestingLimit)
+        .parseObject(filter);
+  }
+  //
+  // JsonObject& parseObject(TString, const JsonObject& filter);
+  // TString = std::istream&, Stream&
+  template <typename TString>
+  JsonObject &parseObject(
+      TString &json, const JsonObject &filter,
+      uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return Internals::makeParser(that(), json, nestingLimit)
+        .parseObject(filter);
+  }
+
   // Generalized version of parseArray() and parseObject(), also works for
   // integral types.
   //
@@ -115,6 +156,39 @@ class JsonBufferBase : public JsonBuffer {
     return Internals::makeParser(that(), json, nestingLimit).parseVariant();
   }
 
+  // Allocates and populate a JsonArray, JsonObject or JsonVariant from
+  // MessagePack data.
+  //
+  // The input is not modified, strings are copied into the JsonBuffer, so
+  // size the buffer for the strings too.
+  //
+  // JsonArray& parseMsgPackArray(TChar*, size_t);
+  // TChar = const char, const unsigned char
+  template <typename TChar>
+  JsonArray &parseMsgPackArray(
+      const TChar *data, size_t size,
+      uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return msgPackParser(data, size, nestingLimit).parseArray();
+  }
+  //
+  // JsonObject& parseMsgPackObject(TChar*, size_t);
+  // TChar = const char, const unsigned char
+  template <typename TChar>
+  JsonObject &parseMsgPackObject(
+      const TChar *data, size_t size,
+      uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return msgPackParser(data, size, nestingLimit).parseObject();
+  }
+  //
+  // JsonVariant parseMsgPack(TChar*, size_t);
+  // TChar = const char, const unsigned char
+  template <typename TChar>
+  JsonVariant parseMsgPack(
+      const TChar *data, size_t size,
+      uint8_t nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT) {
+    return msgPackParser(data, size, nestingLimit).parseVariant();
+  }
+
  protected:
   ~JsonBufferBase() {}
 
@@ -122,6 +196,13 @@ class JsonBufferBase : public JsonBuffer {
   TDerived *that() {
     return static_cast<TDerived *>(this);
   }
+
+  template <typename TChar>
+  Internals::MsgPackParser msgPackParser(const TChar *data, size_t size,
+                                         uint8_t nestingLimit) {
+    return Internals::MsgPackParser(
+        that(), reinterpret_cast<const uint8_t *>(data), size, nestingLimit);
+  }
 };
 }
 }
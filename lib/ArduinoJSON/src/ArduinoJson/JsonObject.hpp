@@ -5,6 +5,7 @@
 #pragma once
 
 #include "Data/JsonBufferAllocated.hpp"
+#include "Data/JsonObjectIndex.hpp"
 #include "Data/List.hpp"
 #include "Data/ReferenceType.hpp"
 #include "Data/ValueSaver.hpp"
@@ -47,7 +48,13 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
   // You should not use this constructor directly.
   // Instead, use JsonBuffer::createObject() or JsonBuffer.parseObject().
   explicit JsonObject(JsonBuffer* buffer) throw()
-      : Internals::List<JsonPair>(buffer) {}
+      : Internals::List<JsonPair>(buffer)
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+        ,
+        _index(NULL)
+#endif
+  {
+  }
 
   // Gets or sets the value associated with the specified key.
   //
@@ -251,7 +258,12 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
   }
   //
   // void remove(iterator)
-  using Internals::List<JsonPair>::remove;
+  void remove(iterator it) {
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    _index = NULL;  // rebuilt on demand
+#endif
+    Internals::List<JsonPair>::remove(it);
+  }
 
   // Returns a reference an invalid JsonObject.
   // This object is meant to replace a NULL pointer.
@@ -263,12 +275,27 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
 
  private:
   // Returns the list node that matches the specified key.
+  // Only lookups build the index: set() must not take memory from the
+  // members a JsonBuffer was sized for.
   template <typename TStringRef>
-  iterator findKey(TStringRef key) {
+  iterator findKey(TStringRef key, bool buildIndex = true) {
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    if (_index) return iterator(_index->find<TStringRef>(key));
+    size_t scanned = 0;
+#endif
     iterator it;
     for (it = begin(); it != end(); ++it) {
       if (Internals::StringTraits<TStringRef>::equals(key, it->key)) break;
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+      scanned++;
+#endif
     }
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    if (buildIndex && scanned >= ARDUINOJSON_OBJECT_INDEX_THRESHOLD && _buffer)
+      _index = Internals::JsonObjectIndex::create(_buffer, nodeOf(begin()));
+#else
+    (void)buildIndex;
+#endif
     return it;
   }
   template <typename TStringRef>
@@ -286,7 +313,7 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
 
   template <typename TStringRef, typename TValueRef>
   bool set_impl(TStringRef key, TValueRef value) {
-    iterator it = findKey<TStringRef>(key);
+    iterator it = findKey<TStringRef>(key, false);
     if (it == end()) {
       it = Internals::List<JsonPair>::add();
       if (it == end()) return false;
@@ -294,6 +321,12 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
       bool key_ok =
           Internals::ValueSaver<TStringRef>::save(_buffer, it->key, key);
       if (!key_ok) return false;
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+      if (_index && _index->isFull())
+        _index = Internals::JsonObjectIndex::create(_buffer, nodeOf(begin()));
+      else if (_index)
+        _index->add(nodeOf(it));
+#endif
     }
     return Internals::ValueSaver<TValueRef>::save(_buffer, it->value, value);
   }
@@ -309,6 +342,10 @@ class JsonObject : public Internals::JsonPrintable<JsonObject>,
 
   template <typename TStringRef>
   JsonObject& createNestedObject_impl(TStringRef key);
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  Internals::JsonObjectIndex* _index;
+#endif
 };
 
 namespace Internals {
@@ -39,6 +39,8 @@ class JsonObject;
 class JsonVariant : public Internals::JsonVariantBase<JsonVariant> {
   template <typename Print>
   friend class Internals::JsonSerializer;
+  template <typename Writer>
+  friend class Internals::MsgPackSerializer;
 
  public:
   // Creates an uninitialized JsonVariant
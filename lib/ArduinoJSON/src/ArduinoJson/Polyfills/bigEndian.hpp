@@ -0,0 +1,30 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for uint8_t
+
+namespace ArduinoJson {
+namespace Internals {
+
+inline bool isLittleEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t *>(&one) == 1;
+}
+
+// Copies the native representation of a value in network (big endian) order,
+// or back. Works for floats and doubles without 64-bit integer arithmetic.
+inline void copyBigEndian(void *dst, const void *src, size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  if (isLittleEndian()) {
+    for (size_t i = 0; i < size; i++) d[i] = s[size - 1 - i];
+  } else {
+    for (size_t i = 0; i < size; i++) d[i] = s[i];
+  }
+}
+}
+}
@@ -11,6 +11,54 @@
 namespace ArduinoJson {
 namespace Internals {
 
+// Digits gathered per multiplication of the mantissa, in a type narrower
+// than the mantissa: nine in 32 bits for double, four in 16 bits for float.
+template <size_t MantissaSize>
+struct DigitChunk {
+  typedef uint16_t type;
+  static const int digits = 4;
+  static const type scale = 10000;
+};
+
+template <>
+struct DigitChunk<8> {
+  typedef uint32_t type;
+  static const int digits = 9;
+  static const type scale = 1000000000;
+};
+
+// Appends the digits at s to mantissa and returns how many were kept; the
+// digits that would exceed max are skipped and counted in dropped.
+// While there is room, digits are gathered a chunk at a time, which saves a
+// wide multiplication per digit on 8 and 32-bit MCUs.
+template <typename TMantissa>
+inline int parseDigits(const char*& s, TMantissa& mantissa, TMantissa max,
+                       int& dropped) {
+  typedef DigitChunk<sizeof(TMantissa)> chunk_traits;
+  typedef typename chunk_traits::type chunk_t;
+  const TMantissa chunkMax = TMantissa(max / chunk_traits::scale - 1);
+  int kept = 0;
+  while (isdigit(*s)) {
+    if (mantissa < chunkMax) {
+      chunk_t chunk = 0;
+      chunk_t scale = 1;
+      for (int n = 0; n < chunk_traits::digits && isdigit(*s); n++) {
+        chunk = chunk_t(chunk * 10 + chunk_t(*s++ - '0'));
+        scale = chunk_t(scale * 10);
+        kept++;
+      }
+      mantissa = TMantissa(mantissa * TMantissa(scale) + TMantissa(chunk));
+    } else if (mantissa < max / 10) {
+      mantissa = TMantissa(mantissa * 10 + (*s++ - '0'));
+      kept++;
+    } else {
+      s++;
+      dropped++;
+    }
+  }
+  return kept;
+}
+
 template <typename T>
 inline T parseFloat(const char* s) {
   typedef FloatTraits<T> traits;
@@ -36,25 +84,14 @@ inline T parseFloat(const char* s) {
     return negative_result ? -traits::inf() : traits::inf();
 
   mantissa_t mantissa = 0;
-  exponent_t exponent_offset = 0;
-
-  while (isdigit(*s)) {
-    if (mantissa < traits::mantissa_max / 10)
-      mantissa = mantissa * 10 + (*s - '0');
-    else
-      exponent_offset++;
-    s++;
-  }
+  int dropped = 0;
+  parseDigits(s, mantissa, traits::mantissa_max, dropped);
+  exponent_t exponent_offset = exponent_t(dropped);
 
   if (*s == '.') {
     s++;
-    while (isdigit(*s)) {
-      if (mantissa < traits::mantissa_max / 10) {
-        mantissa = mantissa * 10 + (*s - '0');
-        exponent_offset--;
-      }
-      s++;
-    }
+    int kept = parseDigits(s, mantissa, traits::mantissa_max, dropped);
+    exponent_offset = exponent_t(exponent_offset - kept);
   }
 
   int exponent = 0;
@@ -82,7 +119,17 @@ inline T parseFloat(const char* s) {
   }
   exponent += exponent_offset;
 
-  T result = traits::make_float(static_cast<T>(mantissa), exponent);
+  T result;
+  if (mantissa <= traits::mantissa_max && exponent <= traits::exact_power_max &&
+      exponent >= -traits::exact_power_max) {
+    // both operands are exact, so is the rounding of the result
+    if (exponent < 0)
+      result = static_cast<T>(mantissa) / traits::exactPowerOfTen(-exponent);
+    else
+      result = static_cast<T>(mantissa) * traits::exactPowerOfTen(exponent);
+  } else {
+    result = traits::make_float(static_cast<T>(mantissa), exponent);
+  }
 
   return negative_result ? -result : result;
 }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "../Configuration.hpp"
@@ -30,9 +31,16 @@ T parseInteger(const char *s) {
       break;
   }
 
+  // digits are gathered nine at a time in 32 bits, which saves a 64-bit
+  // multiplication per digit on 8 and 32-bit MCUs
   while (isdigit(*s)) {
-    result = T(result * 10 + T(*s - '0'));
-    s++;
+    uint32_t chunk = 0;
+    uint32_t scale = 1;
+    for (int n = 0; n < 9 && isdigit(*s); n++) {
+      chunk = chunk * 10 + uint32_t(*s++ - '0');
+      scale *= 10;
+    }
+    result = T(result * T(scale) + T(chunk));
   }
 
   return negative_result ? T(~result + 1) : result;
@@ -0,0 +1,79 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>  // for memcpy, strlen
+
+namespace ArduinoJson {
+
+// A Print implementation that collects the output in a fixed buffer and
+// passes it to the destination in chunks of N bytes. The default size is one
+// TCP segment on Ethernet/WiFi, so each write() to a network client fills a
+// packet:
+//
+//   BufferedPrint<WiFiClient> out(client);
+//   root.printTo(out);
+//   out.flush();
+//
+// TDestination needs a write(const uint8_t*, size_t) like Arduino's Print.
+// The remaining bytes are also flushed by the destructor.
+template <typename TDestination, size_t N = 1460>
+class BufferedPrint {
+ public:
+  explicit BufferedPrint(TDestination &destination)
+      : _destination(destination), _size(0), _failed(false) {}
+
+  ~BufferedPrint() {
+    flush();
+  }
+
+  size_t print(char c) {
+    if (_size == N) flush();
+    _buffer[_size++] = static_cast<uint8_t>(c);
+    return 1;
+  }
+
+  size_t print(const char *s) {
+    return write(reinterpret_cast<const uint8_t *>(s), strlen(s));
+  }
+
+  size_t write(const uint8_t *s, size_t n) {
+    size_t written = n;
+    while (n) {
+      if (_size == N) flush();
+      size_t chunk = N - _size < n ? N - _size : n;
+      memcpy(_buffer + _size, s, chunk);
+      _size += chunk;
+      s += chunk;
+      n -= chunk;
+    }
+    return written;
+  }
+
+  // Passes the pending bytes to the destination.
+  // Returns false if the destination didn't take all of them (then or in an
+  // earlier flush).
+  bool flush() {
+    if (_size) {
+      if (_destination.write(_buffer, _size) != _size) _failed = true;
+      _size = 0;
+    }
+    return !_failed;
+  }
+
+  size_t pending() const {
+    return _size;
+  }
+
+ private:
+  BufferedPrint &operator=(const BufferedPrint &);  // cannot be assigned
+
+  TDestination &_destination;
+  size_t _size;
+  bool _failed;
+  uint8_t _buffer[N];
+};
+}
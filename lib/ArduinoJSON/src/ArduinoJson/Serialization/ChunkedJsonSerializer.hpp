@@ -0,0 +1,126 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../Configuration.hpp"
+#include "../Data/ListConstIterator.hpp"
+#include "../JsonPair.hpp"
+#include "../JsonVariant.hpp"
+#include "JsonWriter.hpp"
+
+namespace ArduinoJson {
+namespace Internals {
+
+// A Print implementation that writes in a window of a char[], after skipping
+// the part of the current token that was sent in the previous window
+class ChunkWindow {
+ public:
+  ChunkWindow(char *buffer, size_t size)
+      : _p(buffer), _end(buffer + size), _skip(0) {}
+
+  size_t print(char c) {
+    put(c);
+    return 1;
+  }
+
+  size_t print(const char *s) {
+    size_t n = 0;
+    while (s[n]) put(s[n++]);
+    return n;
+  }
+
+  size_t write(const uint8_t *s, size_t n) {
+    for (size_t i = 0; i < n; i++) put(char(s[i]));
+    return n;
+  }
+
+  void skip(size_t n) {
+    _skip = n;
+  }
+
+  char *position() const {
+    return _p;
+  }
+
+  bool full() const {
+    return _p == _end;
+  }
+
+ private:
+  void put(char c) {
+    if (_skip)
+      _skip--;
+    else if (_p < _end)
+      *_p++ = c;
+  }
+
+  char *_p;
+  char *_end;
+  size_t _skip;
+};
+}
+
+// Serializes a JsonArray, JsonObject or JsonVariant one window at a time.
+// Each call to next() fills the caller's buffer and returns; the following
+// call resumes where it stopped. A document can so be sent through a small
+// TX buffer, with no copy of the whole output in RAM:
+//
+//   ChunkedJsonSerializer serializer(root);
+//   char window[256];
+//   while (size_t n = serializer.next(window, sizeof(window)))
+//     client.write(window, n);
+//
+// The output is the same as printTo(). The document must not be modified
+// before the output is complete.
+class ChunkedJsonSerializer {
+ public:
+  explicit ChunkedJsonSerializer(const JsonVariant &root);
+
+  // Copies the next part of the output to buffer (not null-terminated).
+  // Returns the number of bytes written, 0 once the output is complete.
+  size_t next(char *buffer, size_t size);
+
+  bool done() const {
+    return _done;
+  }
+
+  // True if the document was nested deeper than
+  // ARDUINOJSON_DEFAULT_NESTING_LIMIT; the output was cut there.
+  bool overflowed() const {
+    return _overflowed;
+  }
+
+  // Returns the number of bytes produced by all calls to next()
+  size_t bytesWritten() const {
+    return _written;
+  }
+
+ private:
+  enum Stage { COMMA, KEY, COLON, CLOSE };
+
+  struct Frame {
+    Internals::ListConstIterator<JsonVariant> element;
+    Internals::ListConstIterator<JsonPair> member;
+    bool isObject;
+    Stage stage;
+  };
+
+  void writeToken(Internals::JsonWriter<Internals::ChunkWindow> &);
+  void endToken();
+  void open();
+  void endValue();
+
+  static const size_t MAX_DEPTH = ARDUINOJSON_DEFAULT_NESTING_LIMIT + 1;
+
+  JsonVariant _root;
+  const JsonVariant *_pending;  // value whose token comes next, if any
+  Frame _stack[MAX_DEPTH];
+  size_t _depth;
+  size_t _tokenOffset;  // bytes of the current token already written
+  size_t _written;
+  bool _done;
+  bool _overflowed;
+};
+}
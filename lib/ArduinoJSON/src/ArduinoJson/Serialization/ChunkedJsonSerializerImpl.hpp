@@ -0,0 +1,151 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../JsonArray.hpp"
+#include "../JsonObject.hpp"
+#include "ChunkedJsonSerializer.hpp"
+#include "JsonSerializer.hpp"
+
+inline ArduinoJson::ChunkedJsonSerializer::ChunkedJsonSerializer(
+    const JsonVariant &root)
+    : _root(root),
+      _pending(&_root),
+      _depth(0),
+      _tokenOffset(0),
+      _written(0),
+      _done(false),
+      _overflowed(false) {}
+
+inline size_t ArduinoJson::ChunkedJsonSerializer::next(char *buffer,
+                                                       size_t size) {
+  Internals::ChunkWindow window(buffer, size);
+  while (!_done && !window.full()) {
+    char *start = window.position();
+    window.skip(_tokenOffset);
+
+    // a token is rendered again when resumed, the bytes already sent are
+    // skipped by the window
+    Internals::JsonWriter<Internals::ChunkWindow> writer(window);
+    writeToken(writer);
+
+    size_t taken = size_t(window.position() - start);
+    if (_tokenOffset + taken < writer.bytesWritten()) {
+      _tokenOffset += taken;
+      break;
+    }
+    _tokenOffset = 0;
+    endToken();
+  }
+  size_t n = size_t(window.position() - buffer);
+  _written += n;
+  return n;
+}
+
+inline void ArduinoJson::ChunkedJsonSerializer::writeToken(
+    Internals::JsonWriter<Internals::ChunkWindow> &writer) {
+  using namespace Internals;
+  if (_pending) {
+    if (_pending->is<JsonArray>())
+      writer.beginArray();
+    else if (_pending->is<JsonObject>())
+      writer.beginObject();
+    else
+      JsonSerializer<JsonWriter<ChunkWindow> >::serialize(*_pending, writer);
+    return;
+  }
+
+  Frame &frame = _stack[_depth - 1];
+  switch (frame.stage) {
+    case COMMA:
+      writer.writeComma();
+      break;
+    case KEY:
+      writer.writeString(frame.member->key);
+      break;
+    case COLON:
+      writer.writeColon();
+      break;
+    case CLOSE:
+      if (frame.isObject)
+        writer.endObject();
+      else
+        writer.endArray();
+      break;
+  }
+}
+
+inline void ArduinoJson::ChunkedJsonSerializer::endToken() {
+  if (_pending) {
+    if (_pending->is<JsonArray>() || _pending->is<JsonObject>())
+      open();
+    else
+      endValue();
+    return;
+  }
+
+  Frame &frame = _stack[_depth - 1];
+  switch (frame.stage) {
+    case COMMA:
+      if (frame.isObject)
+        frame.stage = KEY;
+      else
+        _pending = &*frame.element;
+      break;
+    case KEY:
+      frame.stage = COLON;
+      break;
+    case COLON:
+      _pending = &frame.member->value;
+      break;
+    case CLOSE:
+      _depth--;
+      endValue();
+      break;
+  }
+}
+
+// Enters the array or object whose opening bracket was just written
+inline void ArduinoJson::ChunkedJsonSerializer::open() {
+  if (_depth == MAX_DEPTH) {
+    _overflowed = true;
+    _done = true;
+    return;
+  }
+
+  Frame &frame = _stack[_depth++];
+  frame.isObject = _pending->is<JsonObject>();
+  if (frame.isObject) {
+    const JsonObject &object = _pending->as<JsonObject>();
+    frame.member = object.begin();
+    frame.stage = frame.member == object.end() ? CLOSE : KEY;
+    _pending = NULL;
+  } else {
+    const JsonArray &array = _pending->as<JsonArray>();
+    frame.element = array.begin();
+    frame.stage = CLOSE;
+    _pending = frame.element == array.end() ? NULL : &*frame.element;
+  }
+}
+
+// Moves past the value that was just written
+inline void ArduinoJson::ChunkedJsonSerializer::endValue() {
+  _pending = NULL;
+  if (_depth == 0) {
+    _done = true;
+    return;
+  }
+
+  Frame &frame = _stack[_depth - 1];
+  bool last;
+  if (frame.isObject) {
+    ++frame.member;
+    last = frame.member == JsonObject::const_iterator();
+  } else {
+    ++frame.element;
+    last = frame.element == JsonArray::const_iterator();
+  }
+  frame.stage = last ? CLOSE : COMMA;
+}
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <string.h>  // for strlen
+
 namespace ArduinoJson {
 namespace Internals {
 
@@ -17,6 +20,10 @@ class DummyPrint {
   size_t print(const char* s) {
     return strlen(s);
   }
+
+  size_t write(const uint8_t*, size_t n) {
+    return n;
+  }
 };
 }
 }
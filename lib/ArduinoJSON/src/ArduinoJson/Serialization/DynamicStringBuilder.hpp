@@ -26,6 +26,12 @@ class DynamicStringBuilder {
     return _str.length() - initialLen;
   }
 
+  size_t write(const uint8_t *s, size_t n) {
+    size_t initialLen = _str.length();
+    StringTraits<TString>::append(_str, reinterpret_cast<const char *>(s), n);
+    return _str.length() - initialLen;
+  }
+
  private:
   DynamicStringBuilder &operator=(const DynamicStringBuilder &);
 
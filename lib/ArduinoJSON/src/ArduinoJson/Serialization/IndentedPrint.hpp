@@ -34,6 +34,12 @@ class IndentedPrint {
     return n;
   }
 
+  size_t write(const uint8_t *s, size_t n) {
+    size_t written = 0;
+    while (n--) written += print(char(*s++));
+    return written;
+  }
+
   // Adds one level of indentation
   void indent() {
     if (level < MAX_LEVEL) level++;
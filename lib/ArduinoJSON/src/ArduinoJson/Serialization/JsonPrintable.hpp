@@ -11,6 +11,8 @@
 #include "IndentedPrint.hpp"
 #include "JsonSerializer.hpp"
 #include "JsonWriter.hpp"
+#include "MsgPackSerializer.hpp"
+#include "MsgPackWriter.hpp"
 #include "Prettyfier.hpp"
 #include "StaticStringBuilder.hpp"
 
@@ -101,6 +103,42 @@ class JsonPrintable {
     return prettyPrintTo(dp);
   }
 
+  // Same as printTo() but produces MessagePack, a binary equivalent of JSON.
+  // The output may contain '\0', use the returned size.
+  template <typename Print>
+  typename EnableIf<!StringTraits<Print>::has_append, size_t>::type msgPackTo(
+      Print &print) const {
+    MsgPackWriter<Print> writer(print);
+    MsgPackSerializer<MsgPackWriter<Print> >::serialize(downcast(), writer);
+    return writer.bytesWritten();
+  }
+
+  size_t msgPackTo(char *buffer, size_t bufferSize) const {
+    StaticStringBuilder sb(buffer, bufferSize);
+    return msgPackTo(sb);
+  }
+
+  size_t msgPackTo(uint8_t *buffer, size_t bufferSize) const {
+    return msgPackTo(reinterpret_cast<char *>(buffer), bufferSize);
+  }
+
+  template <size_t N>
+  size_t msgPackTo(char (&buffer)[N]) const {
+    return msgPackTo(buffer, N);
+  }
+
+  template <typename TString>
+  typename EnableIf<StringTraits<TString>::has_append, size_t>::type msgPackTo(
+      TString &str) const {
+    DynamicStringBuilder<TString> sb(str);
+    return msgPackTo(sb);
+  }
+
+  size_t measureMsgPackLength() const {
+    DummyPrint dp;
+    return msgPackTo(dp);
+  }
+
  private:
   const T &downcast() const {
     return *static_cast<const T *>(this);
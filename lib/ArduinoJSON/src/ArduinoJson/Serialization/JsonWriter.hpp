@@ -9,6 +9,7 @@
 #include "../Data/JsonInteger.hpp"
 #include "../Polyfills/attributes.hpp"
 #include "../Serialization/FloatParts.hpp"
+#include "../Serialization/ShortestFloat.hpp"
 
 namespace ArduinoJson {
 namespace Internals {
@@ -62,7 +63,18 @@ class JsonWriter {
       writeRaw("null");
     } else {
       writeRaw('\"');
-      while (*value) writeChar(*value++);
+      // characters that need no escaping are sent in runs, with one call to
+      // the sink per run instead of one per character
+      const char *run = value;
+      for (; *value; value++) {
+        char specialChar = Encoding::escapeChar(*value);
+        if (!specialChar) continue;
+        writeRaw(run, size_t(value - run));
+        writeRaw('\\');
+        writeRaw(specialChar);
+        run = value + 1;
+      }
+      writeRaw(run, size_t(value - run));
       writeRaw('\"');
     }
   }
@@ -88,6 +100,22 @@ class JsonWriter {
 
     if (isInfinity(value)) return writeRaw("Infinity");
 
+    // integral values skip the floating point math below
+    if (value < TFloat(ARDUINOJSON_POSITIVE_EXPONENTIATION_THRESHOLD) &&
+        value == TFloat(uint32_t(value)))
+      return writeInteger(uint32_t(value));
+
+#if ARDUINOJSON_ENABLE_SHORTEST_FLOAT
+    writeShortestFloat(value);
+#else
+    writeFixedFloat(value);
+#endif
+  }
+
+  // Writes a positive finite value with up to 9 (double) or 6 (float)
+  // decimal places
+  template <typename TFloat>
+  void writeFixedFloat(TFloat value) {
     FloatParts<TFloat> parts(value);
 
     writeInteger(parts.integral);
@@ -104,6 +132,45 @@ class JsonWriter {
     }
   }
 
+  // Writes a positive finite value with the shortest digits that read back
+  // as the same value
+  template <typename TFloat>
+  void writeShortestFloat(TFloat value) {
+    if (value == 0) return writeRaw('0');
+
+    ShortestFloat<TFloat> number(value);
+    const char *digits = number.digits;
+    int length = number.length;
+    int point = length + number.exponent;  // digits before the decimal point
+
+    if (value >= TFloat(ARDUINOJSON_POSITIVE_EXPONENTIATION_THRESHOLD) ||
+        value <= TFloat(ARDUINOJSON_NEGATIVE_EXPONENTIATION_THRESHOLD)) {
+      writeRaw(digits[0]);
+      if (length > 1) {
+        writeRaw('.');
+        writeRaw(digits + 1, size_t(length - 1));
+      }
+      if (point < 1) {
+        writeRaw("e-");
+        writeInteger(1 - point);
+      } else {
+        writeRaw('e');
+        writeInteger(point - 1);
+      }
+    } else if (point <= 0) {
+      writeRaw("0.");
+      for (int i = point; i < 0; i++) writeRaw('0');
+      writeRaw(digits, size_t(length));
+    } else if (point >= length) {
+      writeRaw(digits, size_t(length));
+      for (int i = length; i < point; i++) writeRaw('0');
+    } else {
+      writeRaw(digits, size_t(point));
+      writeRaw('.');
+      writeRaw(digits + point, size_t(length - point));
+    }
+  }
+
   template <typename UInt>
   void writeInteger(UInt value) {
     char buffer[22];
@@ -143,6 +210,9 @@ class JsonWriter {
   void writeRaw(char c) {
     _length += _sink.print(c);
   }
+  void writeRaw(const char *s, size_t n) {
+    if (n) _length += _sink.write(reinterpret_cast<const uint8_t *>(s), n);
+  }
 
  protected:
   Print &_sink;
@@ -0,0 +1,117 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include "../JsonArray.hpp"
+#include "../JsonArraySubscript.hpp"
+#include "../JsonObject.hpp"
+#include "../JsonObjectSubscript.hpp"
+#include "../JsonVariant.hpp"
+#include "../Polyfills/isFloat.hpp"
+#include "../Polyfills/isInteger.hpp"
+#include "../Polyfills/parseFloat.hpp"
+#include "../Polyfills/parseInteger.hpp"
+#include "MsgPackSerializer.hpp"
+
+template <typename Writer>
+inline void ArduinoJson::Internals::MsgPackSerializer<Writer>::serialize(
+    const JsonArray& array, Writer& writer) {
+  writer.beginArray(array.size());
+
+  for (JsonArray::const_iterator it = array.begin(); it != array.end(); ++it) {
+    serialize(*it, writer);
+  }
+}
+
+template <typename Writer>
+inline void ArduinoJson::Internals::MsgPackSerializer<Writer>::serialize(
+    const JsonArraySubscript& arraySubscript, Writer& writer) {
+  serialize(arraySubscript.as<JsonVariant>(), writer);
+}
+
+template <typename Writer>
+inline void ArduinoJson::Internals::MsgPackSerializer<Writer>::serialize(
+    const JsonObject& object, Writer& writer) {
+  writer.beginObject(object.size());
+
+  for (JsonObject::const_iterator it = object.begin(); it != object.end();
+       ++it) {
+    writer.writeString(it->key);
+    serialize(it->value, writer);
+  }
+}
+
+template <typename Writer>
+template <typename TKey>
+inline void ArduinoJson::Internals::MsgPackSerializer<Writer>::serialize(
+    const JsonObjectSubscript<TKey>& objectSubscript, Writer& writer) {
+  serialize(objectSubscript.template as<JsonVariant>(), writer);
+}
+
+template <typename Writer>
+inline void ArduinoJson::Internals::MsgPackSerializer<Writer>::serialize(
+    const JsonVariant& variant, Writer& writer) {
+  switch (variant._type) {
+    case JSON_FLOAT:
+      writer.writeFloat(variant._content.asFloat);
+      return;
+
+    case JSON_ARRAY:
+      serialize(*variant._content.asArray, writer);
+      return;
+
+    case JSON_OBJECT:
+      serialize(*variant._content.asObject, writer);
+      return;
+
+    case JSON_STRING:
+      writer.writeString(variant._content.asString);
+      return;
+
+    case JSON_UNPARSED:
+      serializeUnparsed(variant._content.asString, writer);
+      return;
+
+    case JSON_NEGATIVE_INTEGER:
+      writer.writeNegativeInteger(variant._content.asInteger);
+      return;
+
+    case JSON_POSITIVE_INTEGER:
+      writer.writeInteger(variant._content.asInteger);
+      return;
+
+    case JSON_BOOLEAN:
+      writer.writeBoolean(variant._content.asInteger != 0);
+      return;
+
+    default:  // JSON_UNDEFINED, keeps the container count valid
+      writer.writeNil();
+      return;
+  }
+}
+
+template <typename Writer>
+inline void
+ArduinoJson::Internals::MsgPackSerializer<Writer>::serializeUnparsed(
+    const char* value, Writer& writer) {
+  if (!value || !strcmp(value, "null")) return writer.writeNil();
+  if (!strcmp(value, "true")) return writer.writeBoolean(true);
+  if (!strcmp(value, "false")) return writer.writeBoolean(false);
+
+  bool hasDigits = isdigit(value[0]) || (issign(value[0]) && isdigit(value[1]));
+  if (hasDigits && isInteger(value)) {
+    bool negative = value[0] == '-';
+    JsonUInt magnitude =
+        parseInteger<JsonUInt>(issign(value[0]) ? value + 1 : value);
+    if (negative && magnitude)
+      writer.writeNegativeInteger(magnitude);
+    else
+      writer.writeInteger(magnitude);
+  } else if (isFloat(value)) {
+    writer.writeFloat(parseFloat<JsonFloat>(value));
+  } else {
+    writer.writeString(value);
+  }
+}
@@ -0,0 +1,169 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>  // for strlen
+#include "../Data/JsonFloat.hpp"
+#include "../Data/JsonInteger.hpp"
+#include "../Polyfills/bigEndian.hpp"
+#include "../Polyfills/math.hpp"
+
+namespace ArduinoJson {
+namespace Internals {
+
+// Writes MessagePack tokens to a Print implementation
+// Each token uses the shortest encoding that holds the value, so small
+// integers take one byte and floats that survive a round trip through
+// float take five instead of nine.
+template <typename Print>
+class MsgPackWriter {
+ public:
+  explicit MsgPackWriter(Print &sink) : _sink(sink), _length(0) {}
+
+  // Returns the number of bytes sent to the Print implementation.
+  size_t bytesWritten() const {
+    return _length;
+  }
+
+  void beginArray(size_t size) {
+    if (size < 16) {
+      writeByte(uint8_t(0x90 + size));
+    } else if (size < 0x10000) {
+      writeByte(0xdc);
+      writeUInt16(uint16_t(size));
+    } else {
+      writeByte(0xdd);
+      writeUInt32(uint32_t(size));
+    }
+  }
+
+  void beginObject(size_t size) {
+    if (size < 16) {
+      writeByte(uint8_t(0x80 + size));
+    } else if (size < 0x10000) {
+      writeByte(0xde);
+      writeUInt16(uint16_t(size));
+    } else {
+      writeByte(0xdf);
+      writeUInt32(uint32_t(size));
+    }
+  }
+
+  void writeNil() {
+    writeByte(0xc0);
+  }
+
+  void writeBoolean(bool value) {
+    writeByte(value ? 0xc3 : 0xc2);
+  }
+
+  void writeString(const char *value) {
+    if (!value) return writeNil();
+
+    size_t size = strlen(value);
+    if (size < 32) {
+      writeByte(uint8_t(0xa0 + size));
+    } else if (size < 0x100) {
+      writeByte(0xd9);
+      writeByte(uint8_t(size));
+    } else if (size < 0x10000) {
+      writeByte(0xda);
+      writeUInt16(uint16_t(size));
+    } else {
+      writeByte(0xdb);
+      writeUInt32(uint32_t(size));
+    }
+    writeBytes(reinterpret_cast<const uint8_t *>(value), size);
+  }
+
+  void writeInteger(JsonUInt value) {
+    if (value < 0x80) {
+      writeByte(uint8_t(value));
+    } else if (value < 0x100) {
+      writeByte(0xcc);
+      writeByte(uint8_t(value));
+    } else if (value < 0x10000) {
+      writeByte(0xcd);
+      writeUInt16(uint16_t(value));
+    } else if ((value >> 16) >> 16 == 0) {
+      writeByte(0xce);
+      writeUInt32(uint32_t(value));
+    } else {
+      writeByte(0xcf);
+      writeUInt32(uint32_t((value >> 16) >> 16));
+      writeUInt32(uint32_t(value));
+    }
+  }
+
+  // Writes the negative integer whose absolute value is "magnitude"
+  void writeNegativeInteger(JsonUInt magnitude) {
+    if (magnitude <= 32) {
+      writeByte(uint8_t(0x100 - magnitude));
+    } else if (magnitude <= 0x80) {
+      writeByte(0xd0);
+      writeByte(uint8_t(0x100 - magnitude));
+    } else if (magnitude <= 0x8000) {
+      writeByte(0xd1);
+      writeUInt16(uint16_t(0x10000 - magnitude));
+    } else if (((magnitude - 1) >> 16) >> 15 == 0) {
+      writeByte(0xd2);
+      writeUInt32(uint32_t(~magnitude + 1));
+    } else {
+      JsonUInt value = ~magnitude + 1;
+      writeByte(0xd3);
+      // sign extension when JsonUInt is narrower than 64 bits
+      writeUInt32(sizeof(JsonUInt) > 4 ? uint32_t((value >> 16) >> 16)
+                                       : 0xffffffff);
+      writeUInt32(uint32_t(value));
+    }
+  }
+
+  void writeFloat(JsonFloat value) {
+    float single = static_cast<float>(value);
+    if (sizeof(JsonFloat) == sizeof(float) || isNaN(value) ||
+        static_cast<JsonFloat>(single) == value) {
+      uint8_t bytes[4];
+      copyBigEndian(bytes, &single, 4);
+      writeByte(0xca);
+      writeBytes(bytes, 4);
+    } else {
+      double precise = static_cast<double>(value);
+      uint8_t bytes[8];
+      copyBigEndian(bytes, &precise, 8);
+      writeByte(0xcb);
+      writeBytes(bytes, 8);
+    }
+  }
+
+ protected:
+  // Binary output, so bytes never go through print(char), which a String
+  // sink could treat as text
+  void writeByte(uint8_t c) {
+    _length += _sink.write(&c, 1);
+  }
+
+  void writeBytes(const uint8_t *bytes, size_t n) {
+    _length += _sink.write(bytes, n);
+  }
+
+  void writeUInt16(uint16_t value) {
+    writeByte(uint8_t(value >> 8));
+    writeByte(uint8_t(value));
+  }
+
+  void writeUInt32(uint32_t value) {
+    writeUInt16(uint16_t(value >> 16));
+    writeUInt16(uint16_t(value));
+  }
+
+  Print &_sink;
+  size_t _length;
+
+ private:
+  MsgPackWriter &operator=(const MsgPackWriter &);  // cannot be assigned
+};
+}
+}
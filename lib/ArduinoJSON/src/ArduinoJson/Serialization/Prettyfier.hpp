@@ -31,6 +31,12 @@ class Prettyfier {
     return n;
   }
 
+  size_t write(const uint8_t* s, size_t n) {
+    size_t written = 0;
+    while (n--) written += print(char(*s++));
+    return written;
+  }
+
  private:
   Prettyfier& operator=(const Prettyfier&);  // cannot be assigned
 
@@ -0,0 +1,273 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ArduinoJson {
+namespace Internals {
+
+template <typename TFloat, size_t = sizeof(TFloat)>
+struct FloatBits {};
+
+template <typename TFloat>
+struct FloatBits<TFloat, 8 /*64bits*/> {
+  typedef uint64_t bits_type;
+  static const int significand_bits = 52;
+  static const int exponent_bias = 0x3FF + significand_bits;
+};
+
+template <typename TFloat>
+struct FloatBits<TFloat, 4 /*32bits*/> {
+  typedef uint32_t bits_type;
+  static const int significand_bits = 23;
+  static const int exponent_bias = 0x7F + significand_bits;
+};
+
+// A float f * 2^e with a 64-bit significand
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  DiyFp(uint64_t fp, int ep) : f(fp), e(ep) {}
+
+  DiyFp operator-(const DiyFp& rhs) const {
+    return DiyFp(f - rhs.f, e);
+  }
+
+  // 64x64 multiplication keeping the upper half, rounded
+  DiyFp operator*(const DiyFp& rhs) const {
+    const uint64_t M32 = 0xFFFFFFFF;
+    uint64_t a = f >> 32, b = f & M32, c = rhs.f >> 32, d = rhs.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (uint64_t(1) << 31);
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+  }
+
+  DiyFp normalize() const {
+    DiyFp r = *this;
+    while (!(r.f & (uint64_t(1) << 63))) {
+      r.f <<= 1;
+      r.e--;
+    }
+    return r;
+  }
+};
+
+// Shortest decimal digits that read back as the same value, computed with
+// Florian Loitsch's Grisu2 in integer arithmetic only. The value is
+// digits * 10^exponent; it must be positive and finite.
+// Grisu2 finds the shortest digits for about 99.9 percent of the values and
+// one digit more for the others; the output always reads back exactly.
+template <typename TFloat>
+struct ShortestFloat {
+  char digits[20];  // not null-terminated
+  int8_t length;
+  int16_t exponent;
+
+  explicit ShortestFloat(TFloat value) {
+    typedef FloatBits<TFloat> traits;
+    typedef typename traits::bits_type bits_t;
+    const uint64_t hidden = uint64_t(1) << traits::significand_bits;
+    const int shift = 64 - traits::significand_bits - 2;
+
+    union {
+      TFloat floatBits;
+      bits_t integerBits;
+    };
+    floatBits = value;
+    uint64_t significand = integerBits & (hidden - 1);
+    int biased = int(integerBits >> traits::significand_bits);
+    DiyFp v = biased ? DiyFp(significand + hidden,
+                             biased - traits::exponent_bias)
+                     : DiyFp(significand, 1 - traits::exponent_bias);
+
+    // the boundaries are halfway to the neighbouring floats
+    DiyFp plus((v.f << 1) + 1, v.e - 1);
+    while (!(plus.f & (hidden << 1))) {
+      plus.f <<= 1;
+      plus.e--;
+    }
+    plus.f <<= shift;
+    plus.e -= shift;
+    DiyFp minus = v.f == hidden ? DiyFp((v.f << 2) - 1, v.e - 2)
+                                : DiyFp((v.f << 1) - 1, v.e - 1);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    int k;
+    DiyFp c = cachedPower(plus.e, k);
+    DiyFp w = v.normalize() * c;
+    DiyFp high = plus * c;
+    DiyFp low = minus * c;
+    low.f++;
+    high.f--;
+
+    length = 0;
+    exponent = int16_t(k);
+    generate(w, high, high.f - low.f);
+  }
+
+ private:
+  // Returns c ~= 10^-k such that the product of c and a float of binary
+  // exponent e has its exponent in [-60, -32]
+  static DiyFp cachedPower(int e, int& k) {
+    static const struct {
+      uint32_t msb, lsb;
+      int16_t e;
+    } powers[] = {
+        {0xFA8FD5A0, 0x081C0288, -1220},
+        {0xBAAEE17F, 0xA23EBF76, -1193},
+        {0x8B16FB20, 0x3055AC76, -1166},
+        {0xCF42894A, 0x5DCE35EA, -1140},
+        {0x9A6BB0AA, 0x55653B2D, -1113},
+        {0xE61ACF03, 0x3D1A45DF, -1087},
+        {0xAB70FE17, 0xC79AC6CA, -1060},
+        {0xFF77B1FC, 0xBEBCDC4F, -1034},
+        {0xBE5691EF, 0x416BD60C, -1007},
+        {0x8DD01FAD, 0x907FFC3C, -980},
+        {0xD3515C28, 0x31559A83, -954},
+        {0x9D71AC8F, 0xADA6C9B5, -927},
+        {0xEA9C2277, 0x23EE8BCB, -901},
+        {0xAECC4991, 0x4078536D, -874},
+        {0x823C1279, 0x5DB6CE57, -847},
+        {0xC2109436, 0x4DFB5637, -821},
+        {0x9096EA6F, 0x3848984F, -794},
+        {0xD77485CB, 0x25823AC7, -768},
+        {0xA086CFCD, 0x97BF97F4, -741},
+        {0xEF340A98, 0x172AACE5, -715},
+        {0xB23867FB, 0x2A35B28E, -688},
+        {0x84C8D4DF, 0xD2C63F3B, -661},
+        {0xC5DD4427, 0x1AD3CDBA, -635},
+        {0x936B9FCE, 0xBB25C996, -608},
+        {0xDBAC6C24, 0x7D62A584, -582},
+        {0xA3AB6658, 0x0D5FDAF6, -555},
+        {0xF3E2F893, 0xDEC3F126, -529},
+        {0xB5B5ADA8, 0xAAFF80B8, -502},
+        {0x87625F05, 0x6C7C4A8B, -475},
+        {0xC9BCFF60, 0x34C13053, -449},
+        {0x964E858C, 0x91BA2655, -422},
+        {0xDFF97724, 0x70297EBD, -396},
+        {0xA6DFBD9F, 0xB8E5B88F, -369},
+        {0xF8A95FCF, 0x88747D94, -343},
+        {0xB9447093, 0x8FA89BCF, -316},
+        {0x8A08F0F8, 0xBF0F156B, -289},
+        {0xCDB02555, 0x653131B6, -263},
+        {0x993FE2C6, 0xD07B7FAC, -236},
+        {0xE45C10C4, 0x2A2B3B06, -210},
+        {0xAA242499, 0x697392D3, -183},
+        {0xFD87B5F2, 0x8300CA0E, -157},
+        {0xBCE50864, 0x92111AEB, -130},
+        {0x8CBCCC09, 0x6F5088CC, -103},
+        {0xD1B71758, 0xE219652C, -77},
+        {0x9C400000, 0x00000000, -50},
+        {0xE8D4A510, 0x00000000, -24},
+        {0xAD78EBC5, 0xAC620000, 3},
+        {0x813F3978, 0xF8940984, 30},
+        {0xC097CE7B, 0xC90715B3, 56},
+        {0x8F7E32CE, 0x7BEA5C70, 83},
+        {0xD5D238A4, 0xABE98068, 109},
+        {0x9F4F2726, 0x179A2245, 136},
+        {0xED63A231, 0xD4C4FB27, 162},
+        {0xB0DE6538, 0x8CC8ADA8, 189},
+        {0x83C7088E, 0x1AAB65DB, 216},
+        {0xC45D1DF9, 0x42711D9A, 242},
+        {0x924D692C, 0xA61BE758, 269},
+        {0xDA01EE64, 0x1A708DEA, 295},
+        {0xA26DA399, 0x9AEF774A, 322},
+        {0xF209787B, 0xB47D6B85, 348},
+        {0xB454E4A1, 0x79DD1877, 375},
+        {0x865B8692, 0x5B9BC5C2, 402},
+        {0xC83553C5, 0xC8965D3D, 428},
+        {0x952AB45C, 0xFA97A0B3, 455},
+        {0xDE469FBD, 0x99A05FE3, 481},
+        {0xA59BC234, 0xDB398C25, 508},
+        {0xF6C69A72, 0xA3989F5C, 534},
+        {0xB7DCBF53, 0x54E9BECE, 561},
+        {0x88FCF317, 0xF22241E2, 588},
+        {0xCC20CE9B, 0xD35C78A5, 614},
+        {0x98165AF3, 0x7B2153DF, 641},
+        {0xE2A0B5DC, 0x971F303A, 667},
+        {0xA8D9D153, 0x5CE3B396, 694},
+        {0xFB9B7CD9, 0xA4A7443C, 720},
+        {0xBB764C4C, 0xA7A44410, 747},
+        {0x8BAB8EEF, 0xB6409C1A, 774},
+        {0xD01FEF10, 0xA657842C, 800},
+        {0x9B10A4E5, 0xE9913129, 827},
+        {0xE7109BFB, 0xA19C0C9D, 853},
+        {0xAC2820D9, 0x623BF429, 880},
+        {0x80444B5E, 0x7AA7CF85, 907},
+        {0xBF21E440, 0x03ACDD2D, 933},
+        {0x8E679C2F, 0x5E44FF8F, 960},
+        {0xD433179D, 0x9C8CB841, 986},
+        {0x9E19DB92, 0xB4E31BA9, 1013},
+        {0xEB96BF6E, 0xBADF77D9, 1039},
+        {0xAF87023B, 0x9BF0EE6B, 1066}};
+    // ceil((-61 - e) * log10(2)) with log10(2) ~= 78913 / 2^18
+    int32_t n = 61 + e;
+    int32_t ceiling =
+        n >= 0 ? -((n * 78913) >> 18) : ((-n * 78913) >> 18) + 1;
+    int index = int((ceiling + 347) >> 3) + 1;
+    k = 348 - index * 8;
+    return DiyFp((uint64_t(powers[index].msb) << 32) | powers[index].lsb,
+                 powers[index].e);
+  }
+
+  void generate(const DiyFp& w, const DiyFp& high, uint64_t delta) {
+    static const uint32_t powersOf10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+        1000000000};
+    const DiyFp one(uint64_t(1) << -high.e, high.e);
+    const uint64_t distance = (high - w).f;
+    uint32_t integral = uint32_t(high.f >> -one.e);
+    uint64_t fractional = high.f & (one.f - 1);
+
+    int kappa = 1;
+    while (kappa < 10 && integral >= powersOf10[kappa]) kappa++;
+
+    while (kappa > 0) {
+      kappa--;
+      uint32_t d = integral / powersOf10[kappa];
+      integral %= powersOf10[kappa];
+      if (d || length) digits[length++] = char('0' + d);
+      uint64_t rest = (uint64_t(integral) << -one.e) + fractional;
+      if (rest <= delta) {
+        exponent = int16_t(exponent + kappa);
+        round(delta, rest, uint64_t(powersOf10[kappa]) << -one.e, distance);
+        return;
+      }
+    }
+
+    uint64_t unit = 1;
+    for (;;) {
+      fractional *= 10;
+      delta *= 10;
+      unit *= 10;
+      kappa--;
+      char d = char(fractional >> -one.e);
+      if (d || length) digits[length++] = char('0' + d);
+      fractional &= one.f - 1;
+      if (fractional < delta) {
+        exponent = int16_t(exponent + kappa);
+        round(delta, fractional, one.f, distance * unit);
+        return;
+      }
+    }
+  }
+
+  // Moves the last digit towards w while it stays within the boundaries
+  void round(uint64_t delta, uint64_t rest, uint64_t tenKappa,
+             uint64_t distance) {
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance ||
+            distance - rest > rest + tenKappa - distance)) {
+      digits[length - 1]--;
+      rest += tenKappa;
+    }
+  }
+};
+}
+}
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 namespace ArduinoJson {
 namespace Internals {
 
@@ -28,6 +30,13 @@ class StaticStringBuilder {
     return size_t(p - begin);
   }
 
+  size_t write(const uint8_t *s, size_t n) {
+    char *begin = p;
+    while (p < end && n--) *p++ = char(*s++);
+    *p = '\0';
+    return size_t(p - begin);
+  }
+
  private:
   char *end;
   char *p;
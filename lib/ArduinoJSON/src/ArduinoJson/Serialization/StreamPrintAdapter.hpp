@@ -27,6 +27,12 @@ class StreamPrintAdapter {
     return strlen(s);
   }
 
+  size_t write(const uint8_t* s, size_t n) {
+    _os.write(reinterpret_cast<const char*>(s),
+              static_cast<std::streamsize>(n));
+    return n;
+  }
+
  private:
   // cannot be assigned
   StreamPrintAdapter& operator=(const StreamPrintAdapter&);
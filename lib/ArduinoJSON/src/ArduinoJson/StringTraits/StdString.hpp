@@ -51,6 +51,10 @@ struct StdStringTraits {
     str += s;
   }
 
+  static void append(TString& str, const char* s, size_t n) {
+    while (n--) str += *s++;
+  }
+
   static const bool has_append = true;
   static const bool has_equals = true;
   static const bool should_duplicate = true;
@@ -69,6 +69,16 @@ struct FloatTraits<T, 8 /*64bits*/> {
     return factors[index];
   }
 
+  // Powers of ten that a double holds exactly
+  static const int exact_power_max = 22;
+
+  static T exactPowerOfTen(int e) {
+    static T factors[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                          1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                          1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    return factors[e];
+  }
+
   static T nan() {
     return forge(0x7ff80000, 0x00000000);
   }
@@ -129,6 +139,15 @@ struct FloatTraits<T, 4 /*32bits*/> {
     return factors[index];
   }
 
+  // Powers of ten that a float holds exactly
+  static const int exact_power_max = 10;
+
+  static T exactPowerOfTen(int e) {
+    static T factors[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                          1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+    return factors[e];
+  }
+
   static T forge(uint32_t bits) {
     union {
       uint32_t integerBits;
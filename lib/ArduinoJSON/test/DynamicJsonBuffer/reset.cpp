@@ -0,0 +1,158 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <sstream>
+#include <string>
+
+using namespace ArduinoJson::Internals;
+
+static std::stringstream resetLog;
+
+struct LoggingAllocator : DefaultAllocator {
+  void* allocate(size_t n) {
+    resetLog << "A" << (n - DynamicJsonBuffer::EmptyBlockSize);
+    return DefaultAllocator::allocate(n);
+  }
+  void deallocate(void* p) {
+    resetLog << "F";
+    return DefaultAllocator::deallocate(p);
+  }
+};
+
+static size_t mallocs, frees;
+
+struct CountingAllocator : DefaultAllocator {
+  void* allocate(size_t n) {
+    mallocs++;
+    return DefaultAllocator::allocate(n);
+  }
+  void deallocate(void* p) {
+    if (p) frees++;
+    return DefaultAllocator::deallocate(p);
+  }
+};
+
+// THiNX registration response, parsed once per check-in on the device
+static const char response[] =
+    "{\"registration\":{\"success\":true,\"status\":\"OK\",\"alias\":"
+    "\"kitchen\",\"owner\":\"cedc16bb6bb06daaa3ff6d30666d91aacd6e3efbf9abbc1"
+    "51b4dcade59af7c12\",\"apikey\":\"8e1c2b4f0a3d5e6f7a8b9c0d1e2f3a4b5c6d7e8f"
+    "9a0b1c2d3e4f5a6b7c8d9e0f1a2b\",\"udid\":\"a4d3f2e0-9c1b-11e7-8c2d-"
+    "5f3d6a7b8c9d\",\"timestamp\":1514764800,\"next_checkin\":3600}}";
+
+static const int cycles = 10000;
+
+TEST_CASE("DynamicJsonBuffer::reset()") {
+  SECTION("Keeps the largest block") {
+    resetLog.str("");
+    {
+      DynamicJsonBufferBase<LoggingAllocator> buffer(1);
+      buffer.alloc(1);
+      buffer.alloc(1);
+      buffer.reset();
+      REQUIRE(resetLog.str() == "A1A2F");
+      buffer.alloc(2);
+    }
+    REQUIRE(resetLog.str() == "A1A2FF");
+  }
+
+  SECTION("Goes back to 0") {
+    DynamicJsonBuffer buffer;
+    buffer.alloc(1);
+    buffer.reset();
+    REQUIRE(0 == buffer.size());
+  }
+
+  SECTION("Does nothing when empty") {
+    DynamicJsonBuffer buffer;
+    buffer.reset();
+    REQUIRE(0 == buffer.size());
+    REQUIRE(buffer.alloc(1) != NULL);
+  }
+
+  SECTION("Stops allocating once grown") {
+    resetLog.str("");
+    DynamicJsonBufferBase<LoggingAllocator> buffer(16);
+    for (int i = 0; i < 10; i++) {
+      char json[] = "{\"hello\":\"world\",\"values\":[1,2,3,4,5,6,7,8]}";
+      REQUIRE(buffer.parseObject(json).success());
+      buffer.reset();
+    }
+    resetLog.str("");
+    char json[] = "{\"hello\":\"world\",\"values\":[1,2,3,4,5,6,7,8]}";
+    REQUIRE(buffer.parseObject(json).success());
+    REQUIRE(resetLog.str() == "");
+  }
+}
+
+TEST_CASE("DynamicJsonBuffer reuse over 10,000 parses") {
+  SECTION("New buffer per parse") {
+    mallocs = frees = 0;
+    for (int i = 0; i < cycles; i++) {
+      DynamicJsonBufferBase<CountingAllocator> buffer;
+      std::string copy(response);  // parseObject(char*) works in place
+      REQUIRE(buffer.parseObject(&copy[0]).success());
+    }
+    REQUIRE(mallocs >= static_cast<size_t>(cycles));
+    REQUIRE(frees == mallocs);
+  }
+
+  SECTION("reset() between parses") {
+    mallocs = frees = 0;
+    {
+      DynamicJsonBufferBase<CountingAllocator> buffer;
+      for (int i = 0; i < cycles; i++) {
+        std::string copy(response);
+        REQUIRE(buffer.parseObject(&copy[0]).success());
+        buffer.reset();
+      }
+    }
+    REQUIRE(mallocs < 8);  // only while growing to fit the document
+    REQUIRE(frees == mallocs);
+  }
+}
+
+TEST_CASE("PooledJsonBuffer never fails over 10,000 parses") {
+  PooledJsonBuffer<1024, 2> buffer;
+  for (int i = 0; i < cycles; i++) {
+    std::string copy(response);
+    REQUIRE(buffer.parseObject(&copy[0]).success());
+    buffer.reset();
+  }
+}
+
+TEST_CASE("PooledJsonBuffer") {
+  PooledJsonBuffer<128, 2> buffer;
+
+  SECTION("Allocates from the pool") {
+    REQUIRE(buffer.alloc(16) != NULL);
+  }
+
+  SECTION("Grows one slot at a time") {
+    REQUIRE(buffer.alloc(100) != NULL);
+    REQUIRE(buffer.alloc(50) != NULL);
+    REQUIRE(buffer.alloc(50) == NULL);  // both slots in use
+  }
+
+  SECTION("Fails on requests larger than a slot") {
+    REQUIRE(buffer.alloc(128) == NULL);
+  }
+
+  SECTION("Returns slots on reset()") {
+    buffer.alloc(100);
+    buffer.alloc(50);
+    buffer.reset();
+    REQUIRE(buffer.alloc(100) != NULL);
+    REQUIRE(buffer.alloc(50) != NULL);
+  }
+
+  SECTION("parseObject()") {
+    char json[] = "{\"hello\":\"world\"}";
+    JsonObject& root = buffer.parseObject(json);
+    REQUIRE(root.success());
+    REQUIRE(root["hello"] == std::string("world"));
+  }
+}
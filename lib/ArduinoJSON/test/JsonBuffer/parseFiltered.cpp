@@ -0,0 +1,111 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <sstream>
+
+TEST_CASE("JsonBuffer::parseObject() with filter") {
+  DynamicJsonBuffer jb;
+  DynamicJsonBuffer filterBuffer;
+  JsonObject& filter = filterBuffer.createObject();
+
+  SECTION("Keeps only selected keys") {
+    filter["a"] = true;
+    char json[] = "{\"a\":1,\"b\":{\"c\":[1,2,{\"d\":\"}\"}]},\"e\":\"x\"}";
+    JsonObject& obj = jb.parseObject(json, filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj.size() == 1);
+    REQUIRE(obj["a"] == 1);
+  }
+
+  SECTION("Keeps a whole subtree") {
+    filter["b"] = true;
+    JsonObject& obj = jb.parseObject("{\"a\":1,\"b\":{\"c\":[1,2]}}", filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj.size() == 1);
+    REQUIRE(obj["b"]["c"][1] == 2);
+  }
+
+  SECTION("Filters nested objects") {
+    filter.createNestedObject("configuration")["THINX_ENV_SSID"] = true;
+    JsonObject& obj = jb.parseObject(
+        "{\"configuration\":{\"THINX_ENV_SSID\":\"home\","
+        "\"THINX_ENV_PASS\":\"secret\"}}",
+        filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj["configuration"].as<JsonObject>().size() == 1);
+    REQUIRE(obj["configuration"]["THINX_ENV_SSID"] == std::string("home"));
+  }
+
+  SECTION("Applies the first array element to every element") {
+    filter.createNestedArray("list").createNestedObject()["id"] = true;
+    JsonObject& obj = jb.parseObject(
+        "{\"list\":[{\"id\":1,\"x\":[]},{\"id\":2,\"x\":{}}]}", filter);
+
+    REQUIRE(obj.success());
+    JsonArray& list = obj["list"];
+    REQUIRE(list.size() == 2);
+    REQUIRE(list[1].as<JsonObject>().size() == 1);
+    REQUIRE(list[1]["id"] == 2);
+  }
+
+  SECTION("Wildcard matches any key") {
+    filter.createNestedObject("*")["v"] = true;
+    JsonObject& obj =
+        jb.parseObject("{\"a\":{\"v\":1,\"w\":2},\"b\":{\"v\":3}}", filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj["a"].as<JsonObject>().size() == 1);
+    REQUIRE(obj["b"]["v"] == 3);
+  }
+
+  SECTION("Skips values whose type doesn't match the filter") {
+    filter.createNestedObject("a")["b"] = true;
+    JsonObject& obj = jb.parseObject("{\"a\":[1,2]}", filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj.size() == 0);
+  }
+
+  SECTION("Handles escaped keys and quotes in skipped strings") {
+    filter["k\"1"] = true;
+    JsonObject& obj =
+        jb.parseObject("{\"s\":\"a\\\"}b\",\"k\\\"1\":'v'}", filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj["k\"1"] == std::string("v"));
+  }
+
+  SECTION("Fails on invalid input in skipped values") {
+    filter["a"] = true;
+    REQUIRE_FALSE(jb.parseObject("{\"b\":[1,2,\"a\":1}", filter).success());
+    REQUIRE_FALSE(jb.parseObject("{\"b\":\"unterminated", filter).success());
+  }
+
+  SECTION("Respects nesting limit in skipped values") {
+    filter["a"] = true;
+    REQUIRE(jb.parseObject("{\"b\":[[1]]}", filter, 3).success());
+    REQUIRE_FALSE(jb.parseObject("{\"b\":[[1]]}", filter, 2).success());
+  }
+
+  SECTION("Reads a stream larger than the buffer") {
+    filter["THINX_ENV_SSID"] = true;
+    std::ostringstream payload;
+    payload << "{";
+    for (int i = 0; i < 1000; i++)
+      payload << "\"THINX_ENV_VAR" << i << "\":\"value" << i << "\",";
+    payload << "\"THINX_ENV_SSID\":\"home\"}";
+    std::istringstream stream(payload.str());
+
+    StaticJsonBuffer<JSON_OBJECT_SIZE(1) + 32> small;
+    JsonObject& obj = small.parseObject(stream, filter);
+
+    REQUIRE(obj.success());
+    REQUIRE(obj["THINX_ENV_SSID"] == std::string("home"));
+  }
+}
@@ -0,0 +1,90 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string keyName(int i) {
+  std::ostringstream s;
+  s << "THINX_ENV_" << i;
+  return s.str();
+}
+
+static void fill(JsonObject& obj, int count) {
+  for (int i = 0; i < count; i++) REQUIRE(obj.set(keyName(i), i));
+}
+
+TEST_CASE("JsonObject index") {
+  DynamicJsonBuffer jb;
+  JsonObject& obj = jb.createObject();
+  const int count = 3 * ARDUINOJSON_OBJECT_INDEX_THRESHOLD;
+
+  SECTION("Finds every key once indexed") {
+    fill(obj, count);
+    for (int i = 0; i < count; i++) {
+      REQUIRE(obj.containsKey(keyName(i)));
+      REQUIRE(obj[keyName(i)] == i);
+    }
+    REQUIRE_FALSE(obj.containsKey("THINX_ENV_X"));
+    REQUIRE(obj.size() == static_cast<size_t>(count));
+  }
+
+  SECTION("Works with every key type") {
+    fill(obj, count);
+    char key[] = "THINX_ENV_20";
+    const char* constKey = "THINX_ENV_21";
+    REQUIRE(obj[key] == 20);
+    REQUIRE(obj[constKey] == 21);
+    REQUIRE(obj[std::string("THINX_ENV_22")] == 22);
+  }
+
+  SECTION("Replaces existing values instead of adding keys") {
+    fill(obj, count);
+    fill(obj, count);
+    obj["THINX_ENV_1"] = 42;
+    REQUIRE(obj.size() == static_cast<size_t>(count));
+    REQUIRE(obj["THINX_ENV_1"] == 42);
+  }
+
+  SECTION("Keys added after indexing are found") {
+    fill(obj, count);
+    obj.containsKey("THINX_ENV_X");  // builds the index
+    for (int i = count; i < 4 * count; i++) obj[keyName(i)] = i;
+    for (int i = 0; i < 4 * count; i++) REQUIRE(obj[keyName(i)] == i);
+  }
+
+  SECTION("Removed keys are not found") {
+    fill(obj, count);
+    obj.containsKey("THINX_ENV_X");
+    obj.remove("THINX_ENV_7");
+    REQUIRE_FALSE(obj.containsKey("THINX_ENV_7"));
+    REQUIRE(obj["THINX_ENV_8"] == 8);
+    REQUIRE(obj.size() == static_cast<size_t>(count - 1));
+  }
+
+  SECTION("Parsed objects") {
+    std::ostringstream json;
+    json << "{";
+    for (int i = 0; i < count; i++)
+      json << (i ? "," : "") << "\"" << keyName(i) << "\":" << i;
+    json << "}";
+    JsonObject& parsed = jb.parseObject(json.str());
+    REQUIRE(parsed.success());
+    REQUIRE(parsed.size() == static_cast<size_t>(count));
+    REQUIRE(parsed[keyName(count - 1)] == count - 1);
+  }
+
+  SECTION("Falls back to scanning when the buffer is full") {
+    std::vector<std::string> keys;
+    for (int i = 0; i < count; i++) keys.push_back(keyName(i));
+    StaticJsonBuffer<JSON_OBJECT_SIZE(count)> small;
+    JsonObject& full = small.createObject();
+    for (int i = 0; i < count; i++) full[keys[i].c_str()] = i;  // no copy
+    REQUIRE(full.size() == static_cast<size_t>(count));
+    REQUIRE(full["THINX_ENV_40"] == 40);
+  }
+}
@@ -0,0 +1,86 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <string>
+#include <vector>
+
+// Records each chunk received
+struct ChunkRecorder {
+  std::vector<std::string> chunks;
+  size_t accepted;  // bytes taken per call, all when 0
+
+  ChunkRecorder() : accepted(0) {}
+
+  size_t write(const uint8_t* s, size_t n) {
+    chunks.push_back(std::string(reinterpret_cast<const char*>(s), n));
+    return accepted && accepted < n ? accepted : n;
+  }
+
+  std::string joined() const {
+    std::string result;
+    for (size_t i = 0; i < chunks.size(); i++) result += chunks[i];
+    return result;
+  }
+};
+
+TEST_CASE("BufferedPrint") {
+  ChunkRecorder destination;
+
+  SECTION("Keeps small writes until flush()") {
+    BufferedPrint<ChunkRecorder, 8> out(destination);
+    out.print('a');
+    out.print("bc");
+    REQUIRE(destination.chunks.size() == 0);
+    REQUIRE(out.pending() == 3);
+    REQUIRE(out.flush());
+    REQUIRE(destination.joined() == "abc");
+    REQUIRE(out.pending() == 0);
+  }
+
+  SECTION("Passes full chunks only") {
+    BufferedPrint<ChunkRecorder, 4> out(destination);
+    out.print("0123456789");
+    REQUIRE(destination.chunks.size() == 2);
+    REQUIRE(destination.chunks[0] == "0123");
+    REQUIRE(destination.chunks[1] == "4567");
+    out.flush();
+    REQUIRE(destination.chunks[2] == "89");
+  }
+
+  SECTION("Flushes on destruction") {
+    {
+      BufferedPrint<ChunkRecorder, 8> out(destination);
+      out.print("abc");
+    }
+    REQUIRE(destination.joined() == "abc");
+  }
+
+  SECTION("Reports a short write") {
+    destination.accepted = 2;
+    BufferedPrint<ChunkRecorder, 8> out(destination);
+    out.print("abc");
+    REQUIRE_FALSE(out.flush());
+    REQUIRE_FALSE(out.flush());  // sticky
+  }
+
+  SECTION("Serializes a JsonObject in chunks") {
+    DynamicJsonBuffer jb;
+    JsonObject& obj = jb.createObject();
+    obj["status"] = "OK";
+    obj["alias"] = "kitchen \"sink\"";
+    obj["count"] = 42;
+
+    std::string expected;
+    obj.printTo(expected);
+
+    BufferedPrint<ChunkRecorder, 16> out(destination);
+    REQUIRE(obj.printTo(out) == expected.size());
+    out.flush();
+    REQUIRE(destination.joined() == expected);
+    for (size_t i = 0; i + 1 < destination.chunks.size(); i++)
+      REQUIRE(destination.chunks[i].size() == 16);
+  }
+}
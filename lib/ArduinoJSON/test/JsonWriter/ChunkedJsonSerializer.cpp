@@ -0,0 +1,80 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <string>
+
+static std::string chunked(const JsonVariant& root, size_t window) {
+  ChunkedJsonSerializer serializer(root);
+  std::string output;
+  char buffer[64];
+  while (size_t n = serializer.next(buffer, window)) {
+    REQUIRE(n <= window);
+    output.append(buffer, n);
+  }
+  REQUIRE(serializer.done());
+  REQUIRE_FALSE(serializer.overflowed());
+  REQUIRE(serializer.bytesWritten() == output.size());
+  return output;
+}
+
+// Same output as printTo() whatever the window size
+static void check(const JsonVariant& root) {
+  std::string expected;
+  root.printTo(expected);
+  for (size_t window = 1; window <= 64; window++) {
+    REQUIRE(chunked(root, window) == expected);
+  }
+}
+
+TEST_CASE("ChunkedJsonSerializer") {
+  DynamicJsonBuffer jb;
+
+  SECTION("Empty object") {
+    check(jb.createObject());
+  }
+
+  SECTION("Empty array") {
+    check(jb.createArray());
+  }
+
+  SECTION("Scalars") {
+    check(JsonVariant(42));
+    check(JsonVariant(-42));
+    check(JsonVariant(3.14));
+    check(JsonVariant(true));
+    check(JsonVariant("hello \"world\""));
+  }
+
+  SECTION("Nested document") {
+    JsonObject& root = jb.parseObject(
+        "{\"registration\":{\"status\":\"OK\\n\",\"alias\":\"kitchen\","
+        "\"timestamp\":1514764800,\"lat\":50.0755,\"success\":true},"
+        "\"readings\":[1,-2,[],{},[3,[4,{\"deep\":null}]]],\"empty\":{}}");
+    REQUIRE(root.success());
+    check(root);
+  }
+
+  SECTION("Window of 0 bytes") {
+    ChunkedJsonSerializer serializer(jb.createArray());
+    char buffer[1];
+    REQUIRE(serializer.next(buffer, 0) == 0);
+    REQUIRE_FALSE(serializer.done());
+  }
+
+  SECTION("Too deep") {
+    JsonArray& root = jb.createArray();
+    JsonArray* array = &root;
+    for (int i = 0; i < ARDUINOJSON_DEFAULT_NESTING_LIMIT + 1; i++)
+      array = &array->createNestedArray();
+
+    ChunkedJsonSerializer serializer(root);
+    char buffer[256];
+    size_t n = serializer.next(buffer, sizeof(buffer));
+    REQUIRE(n == ARDUINOJSON_DEFAULT_NESTING_LIMIT + 2);
+    REQUIRE(serializer.done());
+    REQUIRE(serializer.overflowed());
+  }
+}
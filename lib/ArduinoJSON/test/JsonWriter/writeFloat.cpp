@@ -4,6 +4,7 @@
 
 #include <catch.hpp>
 #include <limits>
+#include <stdlib.h>
 #include <string>
 
 #include <ArduinoJson/Serialization/DynamicStringBuilder.hpp>
@@ -115,3 +116,93 @@ TEST_CASE("JsonWriter::writeFloat(float)") {
     check<float>(24.3f, "24.3");
   }
 }
+
+template <typename TFloat>
+void checkShortest(TFloat input, const std::string& expected) {
+  std::string output;
+  DynamicStringBuilder<std::string> sb(output);
+  JsonWriter<DynamicStringBuilder<std::string> > writer(sb);
+  writer.writeShortestFloat(input);
+  REQUIRE(writer.bytesWritten() == output.size());
+  CHECK(expected == output);
+}
+
+TEST_CASE("JsonWriter::writeShortestFloat(double)") {
+  SECTION("Pi") {
+    checkShortest<double>(3.14159265359, "3.14159265359");
+    checkShortest<double>(3.141592653589793, "3.141592653589793");
+  }
+
+  SECTION("Not representable exactly") {
+    checkShortest<double>(0.1, "0.1");
+    checkShortest<double>(0.3, "0.3");
+    checkShortest<double>(0.1 + 0.2, "0.30000000000000004");
+    checkShortest<double>(50.0755, "50.0755");
+  }
+
+  SECTION("Extremes") {
+    checkShortest<double>(2.2250738585072014E-308, "2.2250738585072014e-308");
+    checkShortest<double>(1.7976931348623157E+308, "1.7976931348623157e308");
+    checkShortest<double>(4.9406564584124654E-324, "5e-324");
+  }
+
+  SECTION("Exponentiation thresholds") {
+    checkShortest<double>(1e-4, "0.0001");
+    checkShortest<double>(1.5e-5, "0.000015");
+    checkShortest<double>(1.5e-6, "1.5e-6");
+    checkShortest<double>(9999999.999, "9999999.999");
+    checkShortest<double>(12345678.0, "1.2345678e7");
+    checkShortest<double>(1e22, "1e22");
+  }
+
+  SECTION("Integral values") {
+    checkShortest<double>(1234567.0, "1234567");
+    checkShortest<double>(1200.0, "1200");
+  }
+}
+
+TEST_CASE("JsonWriter::writeShortestFloat(float)") {
+  checkShortest<float>(3.14159265359f, "3.1415927");
+  checkShortest<float>(0.1f, "0.1");
+  checkShortest<float>(24.3f, "24.3");
+  checkShortest<float>(999.9f, "999.9");
+  checkShortest<float>(3.4028235e38f, "3.4028235e38");
+  checkShortest<float>(1e-45f, "1e-45");
+}
+
+// Every output must read back as the same value
+template <typename TFloat>
+static void checkRoundTrip(TFloat value) {
+  std::string output;
+  DynamicStringBuilder<std::string> sb(output);
+  JsonWriter<DynamicStringBuilder<std::string> > writer(sb);
+  writer.writeShortestFloat(value);
+  CAPTURE(output);
+  REQUIRE(static_cast<TFloat>(strtod(output.c_str(), NULL)) == value);
+}
+
+TEST_CASE("JsonWriter::writeShortestFloat() round trip") {
+  uint64_t seed = 88172645463325252u;
+  for (int i = 0; i < 100000; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    union {
+      uint64_t bits;
+      double d;
+    } u64;
+    u64.bits = seed & ~(uint64_t(1) << 63);  // positive
+    if (u64.d == u64.d && u64.d < std::numeric_limits<double>::infinity() &&
+        u64.d > 0)
+      checkRoundTrip(u64.d);
+
+    union {
+      uint32_t bits;
+      float f;
+    } u32;
+    u32.bits = uint32_t(seed >> 33);  // positive
+    if (u32.f == u32.f && u32.f < std::numeric_limits<float>::infinity() &&
+        u32.f > 0)
+      checkRoundTrip(u32.f);
+  }
+}
@@ -6,6 +6,7 @@
 
 #include <ArduinoJson/Serialization/JsonWriter.hpp>
 #include <ArduinoJson/Serialization/StaticStringBuilder.hpp>
+#include <string.h>
 
 using namespace ArduinoJson::Internals;
 
@@ -59,3 +60,51 @@ TEST_CASE("JsonWriter::writeString()") {
     check("\t", "\"\\t\"");
   }
 }
+
+// Counts the calls made to the sink
+struct CallCounter {
+  std::string output;
+  int calls;
+
+  CallCounter() : calls(0) {}
+
+  size_t print(char c) {
+    calls++;
+    output += c;
+    return 1;
+  }
+  size_t print(const char* s) {
+    calls++;
+    output += s;
+    return strlen(s);
+  }
+  size_t write(const uint8_t* s, size_t n) {
+    calls++;
+    output.append(reinterpret_cast<const char*>(s), n);
+    return n;
+  }
+};
+
+TEST_CASE("JsonWriter::writeString() writes runs in one call") {
+  CallCounter sink;
+  JsonWriter<CallCounter> writer(sink);
+
+  SECTION("Plain string") {
+    writer.writeString("hello world");
+    REQUIRE(sink.output == "\"hello world\"");
+    REQUIRE(sink.calls == 3);  // quote, run, quote
+  }
+
+  SECTION("Escaped characters in the middle") {
+    writer.writeString("one\ntwo\"three");
+    REQUIRE(sink.output == "\"one\\ntwo\\\"three\"");
+    REQUIRE(sink.calls == 9);
+    REQUIRE(writer.bytesWritten() == sink.output.size());
+  }
+
+  SECTION("Escaped characters only") {
+    writer.writeString("\t\t");
+    REQUIRE(sink.output == "\"\\t\\t\"");
+    REQUIRE(sink.calls == 6);  // no empty runs
+  }
+}
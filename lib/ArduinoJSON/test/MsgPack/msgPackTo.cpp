@@ -0,0 +1,166 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <string>
+
+// Sink without print(), binary output must go through write()
+struct WriteOnlyPrint {
+  std::string bytes;
+  size_t write(const uint8_t *s, size_t n) {
+    bytes.append(reinterpret_cast<const char *>(s), n);
+    return n;
+  }
+};
+
+static void check(const JsonVariant &variant, const char *expected,
+                  size_t expectedLen) {
+  std::string actual;
+  size_t actualLen = variant.msgPackTo(actual);
+  size_t measuredLen = variant.measureMsgPackLength();
+
+  REQUIRE(std::string(expected, expectedLen) == actual);
+  REQUIRE(expectedLen == actualLen);
+  REQUIRE(expectedLen == measuredLen);
+}
+
+#define CHECK_PACK(variant, expected) \
+  check(variant, expected, sizeof(expected) - 1)
+
+TEST_CASE("JsonVariant::msgPackTo()") {
+  SECTION("Literals") {
+    CHECK_PACK(JsonVariant(true), "\xc3");
+    CHECK_PACK(JsonVariant(false), "\xc2");
+    CHECK_PACK(JsonVariant(static_cast<char *>(0)), "\xc0");
+    CHECK_PACK(RawJson("null"), "\xc0");
+  }
+
+  SECTION("Positive integers") {
+    CHECK_PACK(JsonVariant(0), "\x00");
+    CHECK_PACK(JsonVariant(127), "\x7f");
+    CHECK_PACK(JsonVariant(128), "\xcc\x80");
+    CHECK_PACK(JsonVariant(255), "\xcc\xff");
+    CHECK_PACK(JsonVariant(256), "\xcd\x01\x00");
+    CHECK_PACK(JsonVariant(65535), "\xcd\xff\xff");
+    CHECK_PACK(JsonVariant(65536), "\xce\x00\x01\x00\x00");
+    CHECK_PACK(JsonVariant(4294967295UL), "\xce\xff\xff\xff\xff");
+  }
+
+  SECTION("Negative integers") {
+    CHECK_PACK(JsonVariant(-1), "\xff");
+    CHECK_PACK(JsonVariant(-32), "\xe0");
+    CHECK_PACK(JsonVariant(-33), "\xd0\xdf");
+    CHECK_PACK(JsonVariant(-128), "\xd0\x80");
+    CHECK_PACK(JsonVariant(-129), "\xd1\xff\x7f");
+    CHECK_PACK(JsonVariant(-32768), "\xd1\x80\x00");
+    CHECK_PACK(JsonVariant(-32769), "\xd2\xff\xff\x7f\xff");
+    CHECK_PACK(JsonVariant(-2147483647L - 1), "\xd2\x80\x00\x00\x00");
+  }
+
+  SECTION("Floats") {
+    CHECK_PACK(JsonVariant(1.5), "\xca\x3f\xc0\x00\x00");
+    CHECK_PACK(JsonVariant(-2.0f), "\xca\xc0\x00\x00\x00");
+    CHECK_PACK(JsonVariant(0.1), "\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a");
+  }
+
+  SECTION("Strings") {
+    CHECK_PACK(JsonVariant(""), "\xa0");
+    CHECK_PACK(JsonVariant("hello"), "\xa5hello");
+    CHECK_PACK(JsonVariant("0123456789012345678901234567890123"),
+               "\xd9\x22"
+               "0123456789012345678901234567890123");
+  }
+
+  SECTION("Unparsed values from JSON") {
+    CHECK_PACK(RawJson("42"), "\x2a");
+    CHECK_PACK(RawJson("-42"), "\xd0\xd6");
+    CHECK_PACK(RawJson("+1"), "\x01");
+    CHECK_PACK(RawJson("-0"), "\x00");
+    CHECK_PACK(RawJson("true"), "\xc3");
+    CHECK_PACK(RawJson("false"), "\xc2");
+    CHECK_PACK(RawJson("2.5"), "\xca\x40\x20\x00\x00");
+    CHECK_PACK(RawJson("abc"), "\xa3"
+                               "abc");
+    CHECK_PACK(RawJson("-"), "\xa1-");
+  }
+}
+
+TEST_CASE("JsonObject::msgPackTo()") {
+  DynamicJsonBuffer jb;
+
+  SECTION("Empty object") {
+    CHECK_PACK(jb.createObject(), "\x80");
+  }
+
+  SECTION("Nested containers") {
+    JsonObject &obj = jb.parseObject("{\"a\":[1,2,{\"b\":null}],\"c\":-1}");
+    REQUIRE(obj.success());
+    CHECK_PACK(obj, "\x82\xa1"
+                    "a\x93\x01\x02\x81\xa1"
+                    "b\xc0\xa1"
+                    "c\xff");
+  }
+
+  SECTION("16 keys use map 16") {
+    JsonObject &obj = jb.createObject();
+    const char *keys[] = {"a", "b", "c", "d", "e", "f", "g", "h",
+                          "i", "j", "k", "l", "m", "n", "o", "p"};
+    for (int i = 0; i < 16; i++) obj[keys[i]] = 0;
+    std::string packed;
+    obj.msgPackTo(packed);
+    REQUIRE(packed.size() == 3 + 16 * 3);
+    REQUIRE(packed.substr(0, 3) == std::string("\xde\x00\x10", 3));
+  }
+
+  SECTION("0x00 bytes in a String") {
+    JsonObject &obj = jb.createObject();
+    obj["a"] = 0;
+    obj["b"] = 256;
+    std::string packed;
+    size_t n = obj.msgPackTo(packed);
+    REQUIRE(n == 9);
+    REQUIRE(packed == std::string("\x82\xa1" "a\x00\xa1" "b\xcd\x01\x00", 9));
+
+    WriteOnlyPrint sink;
+    REQUIRE(obj.msgPackTo(sink) == 9);
+    REQUIRE(sink.bytes == packed);
+  }
+
+  SECTION("Fixed buffer") {
+    JsonObject &obj = jb.createObject();
+    obj["n"] = 0;
+    char buffer[16];
+    size_t n = obj.msgPackTo(buffer);
+    REQUIRE(n == 4);
+    REQUIRE(std::string(buffer, n) == std::string("\x81\xa1n\x00", 4));
+  }
+}
+
+// Hand-written THiNX registration request and numeric configuration push
+static const char registration[] =
+    "{\"registration\":{\"mac\":\"5CCF7F0A1B2C\",\"firmware\":\"thinx-lib-"
+    "esp8266-arduino:2.3.186\",\"version\":\"2.3.186\",\"commit\":"
+    "\"0c48a9ab0c4f89c4b8fb72173553d3e74986632d0\",\"owner\":"
+    "\"cedc16bb6bb06daaa3ff6d30666d91aacd6e3efbf9abbc151b4dcade59af7c12\","
+    "\"alias\":\"kitchen\",\"status\":\"Registered\",\"lat\":50.0833,\"lon\":"
+    "14.4167,\"rssi\":-67,\"platform\":\"platformio\"}}";
+
+static const char configuration[] =
+    "{\"configuration\":{\"THINX_ENV_INTERVAL\":300,\"THINX_ENV_THRESHOLD\":"
+    "21.5,\"THINX_ENV_HYSTERESIS\":0.25,\"THINX_ENV_OFFSET\":-1.75,"
+    "\"THINX_ENV_SAMPLES\":[12,24,48,96,192,384,768,1536],\"THINX_ENV_GAIN\":"
+    "[0.5,1.0,1.5,2.0,2.5,3.0,3.5,4.0],\"THINX_ENV_ENABLED\":true}}";
+
+static std::string pack(const char *json) {
+  DynamicJsonBuffer jb;
+  std::string packed;
+  jb.parseObject(json).msgPackTo(packed);
+  return packed;
+}
+
+TEST_CASE("MsgPack is smaller than JSON for THiNX payloads") {
+  REQUIRE(pack(registration).size() < strlen(registration));
+  REQUIRE(pack(configuration).size() < strlen(configuration));
+}
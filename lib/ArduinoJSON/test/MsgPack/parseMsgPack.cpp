@@ -0,0 +1,120 @@
+// ArduinoJson - arduinojson.org
+// Copyright Benoit Blanchon 2014-2018
+// MIT License
+
+#include <ArduinoJson.h>
+#include <catch.hpp>
+#include <string>
+
+#define MSGPACK(bytes) bytes, sizeof(bytes) - 1
+
+TEST_CASE("JsonBuffer::parseMsgPack()") {
+  DynamicJsonBuffer jb;
+
+  SECTION("Integers") {
+    REQUIRE(jb.parseMsgPack(MSGPACK("\x00")).as<int>() == 0);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\x7f")).as<int>() == 127);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xff")).as<int>() == -1);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xcc\xff")).as<int>() == 255);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xcd\x01\x00")).as<int>() == 256);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xce\x00\x01\x00\x00")).as<long>() ==
+            65536);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xd0\x80")).as<int>() == -128);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xd1\xff\x7f")).as<int>() == -129);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xd2\xff\xff\x7f\xff")).as<long>() ==
+            -32769);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xd0\x05")).as<int>() == 5);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xd3\xff\xff\xff\xff\xff\xff\xff\xfe"))
+                .as<long>() == -2);
+  }
+
+  SECTION("Floats") {
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xca\x3f\xc0\x00\x00")).as<double>() ==
+            1.5);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a"))
+                .as<double>() == 0.1);
+  }
+
+  SECTION("Literals") {
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xc3")).as<bool>() == true);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xc2")).as<bool>() == false);
+    REQUIRE(jb.parseMsgPack(MSGPACK("\xc0")).as<char *>() == 0);
+  }
+
+  SECTION("Strings") {
+    REQUIRE(std::string("hello") ==
+            jb.parseMsgPack(MSGPACK("\xa5hello")).as<char *>());
+    REQUIRE(std::string("abc") ==
+            jb.parseMsgPack(MSGPACK("\xd9\x03"
+                                    "abc"))
+                .as<char *>());
+    REQUIRE(std::string("") == jb.parseMsgPack(MSGPACK("\xa0")).as<char *>());
+  }
+
+  SECTION("Truncated input fails") {
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("\xa5hel")).success());
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("\xcd\x01")).success());
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("\x92\x01")).success());
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("")).success());
+  }
+
+  SECTION("Absurd container size fails fast") {
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("\xdd\xff\xff\xff\xff")).success());
+  }
+
+  SECTION("Extension types are not supported") {
+    REQUIRE_FALSE(jb.parseMsgPack(MSGPACK("\xd4\x01\x01")).success());
+  }
+}
+
+TEST_CASE("JsonBuffer::parseMsgPackObject()") {
+  DynamicJsonBuffer jb;
+
+  SECTION("Nested") {
+    const unsigned char input[] = {0x82, 0xa1, 'a',  0x93, 0x01, 0x02,
+                                   0x81, 0xa1, 'b',  0xc0, 0xa1, 'c',
+                                   0xcb, 0x40, 0x49, 0x0f, 0xdb, 0x00,
+                                   0x00, 0x00, 0x00};
+    JsonObject &obj = jb.parseMsgPackObject(input, sizeof(input));
+    REQUIRE(obj.success());
+    REQUIRE(obj["a"][0] == 1);
+    REQUIRE(obj["a"][1] == 2);
+    REQUIRE(obj["a"][2]["b"].as<char *>() == 0);
+    REQUIRE(obj["c"].as<double>() > 3.14);
+  }
+
+  SECTION("Root must be a map") {
+    REQUIRE_FALSE(jb.parseMsgPackObject(MSGPACK("\x90")).success());
+    REQUIRE(jb.parseMsgPackArray(MSGPACK("\x90")).success());
+  }
+
+  SECTION("Keys must be strings") {
+    REQUIRE_FALSE(jb.parseMsgPackObject(MSGPACK("\x81\x01\x01")).success());
+  }
+
+  SECTION("Nesting limit") {
+    REQUIRE(jb.parseMsgPackObject(MSGPACK("\x81\xa1x\x80"), 2).success());
+    REQUIRE_FALSE(
+        jb.parseMsgPackObject(MSGPACK("\x81\xa1x\x80"), 1).success());
+  }
+
+  SECTION("Round trip through JSON") {
+    const char json[] =
+        "{\"registration\":{\"status\":\"OK\",\"alias\":\"kitchen\","
+        "\"auto_update\":true,\"timestamp\":1534150000,\"lat\":50.08,"
+        "\"lon\":-14.42,\"files\":[]}}";
+    JsonObject &original = jb.parseObject(json);
+    REQUIRE(original.success());
+
+    std::string packed;
+    original.msgPackTo(packed);
+    REQUIRE(packed.size() < strlen(json));
+
+    JsonObject &copy = jb.parseMsgPackObject(packed.data(), packed.size());
+    REQUIRE(copy.success());
+
+    std::string roundTrip;
+    copy.printTo(roundTrip);
+    REQUIRE(roundTrip == json);
+  }
+}
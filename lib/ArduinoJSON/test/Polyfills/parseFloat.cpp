@@ -32,6 +32,46 @@ void checkInf(const char* input, bool negative) {
   REQUIRE(x * 2 == x);  // a property of infinity
 }
 
+TEST_CASE("parseDigits()") {
+  typedef FloatTraits<float>::mantissa_type float_mantissa;
+  typedef FloatTraits<double>::mantissa_type double_mantissa;
+  int dropped = 0;
+
+  SECTION("float gathers four digits at a time") {
+    REQUIRE(int(DigitChunk<sizeof(float_mantissa)>::digits) == 4);
+    const char* s = "123456789";
+    float_mantissa mantissa = 0;
+    int kept = parseDigits(s, mantissa, FloatTraits<float>::mantissa_max, dropped);
+    REQUIRE(mantissa == 1234567);
+    REQUIRE(kept == 7);
+    REQUIRE(dropped == 2);
+    REQUIRE(*s == '\0');
+  }
+
+  SECTION("float chunk ends at the dot") {
+    const char* s = "12.5";
+    float_mantissa mantissa = 0;
+    int kept = parseDigits(s, mantissa, FloatTraits<float>::mantissa_max, dropped);
+    REQUIRE(mantissa == 12);
+    REQUIRE(kept == 2);
+    REQUIRE(*s == '.');
+    kept = parseDigits(++s, mantissa, FloatTraits<float>::mantissa_max, dropped);
+    REQUIRE(mantissa == 125);
+    REQUIRE(kept == 1);
+    REQUIRE(dropped == 0);
+  }
+
+  SECTION("double gathers nine digits at a time") {
+    REQUIRE(int(DigitChunk<sizeof(double_mantissa)>::digits) == 9);
+    const char* s = "12345678901234567890";
+    double_mantissa mantissa = 0;
+    int kept = parseDigits(s, mantissa, FloatTraits<double>::mantissa_max, dropped);
+    REQUIRE(mantissa == double_mantissa(1234567890) * 1000000 + 123456);
+    REQUIRE(kept == 16);
+    REQUIRE(dropped == 4);
+  }
+}
+
 TEST_CASE("parseFloat<float>()") {
   SECTION("Null") {
     check<float>(NULL, 0);
@@ -39,6 +79,8 @@ TEST_CASE("parseFloat<float>()") {
 
   SECTION("Float_Short_NoExponent") {
     check<float>("3.14", 3.14f);
+    check<float>("1234.5678", 1234.5678f);
+    check<float>("0.000123456", 0.000123456f);
     check<float>("-3.14", -3.14f);
     check<float>("+3.14", +3.14f);
   }
@@ -103,6 +145,12 @@ TEST_CASE("parseFloat<float>()") {
     check<float>("false", 0.0f);
     check<float>("true", 1.0f);
   }
+
+  SECTION("Exact when mantissa and power of ten are") {
+    REQUIRE(parseFloat<float>("123.456") == 123.456f);
+    REQUIRE(parseFloat<float>("50.0755") == 50.0755f);
+    REQUIRE(parseFloat<float>("1e10") == 1e10f);
+  }
 }
 
 TEST_CASE("parseFloat<double>()") {
@@ -174,4 +222,13 @@ TEST_CASE("parseFloat<double>()") {
     check<double>("false", 0.0);
     check<double>("true", 1.0);
   }
+
+  SECTION("Exact when mantissa and power of ten are") {
+    REQUIRE(parseFloat<double>("123.456") == 123.456);
+    REQUIRE(parseFloat<double>("50.0755") == 50.0755);
+    REQUIRE(parseFloat<double>("-14.4378") == -14.4378);
+    REQUIRE(parseFloat<double>("123456789012345") == 123456789012345.0);
+    REQUIRE(parseFloat<double>("1e22") == 1e22);
+    REQUIRE(parseFloat<double>("4.35e-20") == 4.35e-20);
+  }
 }
@@ -77,3 +77,12 @@ TEST_CASE("parseInteger<uint16_t>()") {
   check<uint16_t>("true", 1);
   check<uint16_t>("false", 0);
 }
+
+TEST_CASE("parseInteger<uint64_t>()") {
+  check<uint64_t>("0", 0);
+  check<uint64_t>("4294967296", uint64_t(1) << 32);
+  check<uint64_t>("1514764800123", uint64_t(1514764) * 1000000 + 800123);
+  check<uint64_t>("18446744073709551615", ~uint64_t(0));
+  check<uint64_t>("18446744073709551616", 0);
+  check<uint64_t>("-1", ~uint64_t(0));
+}
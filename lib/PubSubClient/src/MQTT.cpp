@@ -52,6 +52,35 @@ namespace MQTT {
     bufpos += dlen;
   }
 
+  //! Write a 32-bit value, big-endian order
+  void write32(uint8_t *buf, uint32_t& bufpos, uint32_t data) {
+    write(buf, bufpos, (uint16_t)(data >> 16));
+    write(buf, bufpos, (uint16_t)(data & 0xffff));
+  }
+
+  //! Length of a variable byte integer (remaining length, property length)
+  uint8_t varint_length(uint32_t val) {
+    if (val < 128)
+      return 1;
+    else if (val < 16384)
+      return 2;
+    else if (val < 2097152)
+      return 3;
+    else
+      return 4;
+  }
+
+  //! Write a variable byte integer
+  void write_varint(uint8_t *buf, uint32_t& bufpos, uint32_t val) {
+    do {
+      uint8_t digit = val & 0x7f;
+      val >>= 7;
+      if (val)
+	digit |= 0x80;
+      buf[bufpos++] = digit;
+    } while (val);
+  }
+
   //! Template function to read from a buffer
   template <typename T>
   T read(uint8_t *buf, uint32_t& pos);
@@ -68,6 +97,13 @@ namespace MQTT {
     return val;
   }
 
+  template <>
+  uint32_t read<uint32_t>(uint8_t *buf, uint32_t& pos) {
+    uint32_t val = (uint32_t)read<uint16_t>(buf, pos) << 16;
+    val |= read<uint16_t>(buf, pos);
+    return val;
+  }
+
   template <>
   String read<String>(uint8_t *buf, uint32_t& pos) {
     uint16_t len = read<uint16_t>(buf, pos);
@@ -107,17 +143,91 @@ namespace MQTT {
     return val;
   }
 
+  //! Read a variable byte integer
+  uint32_t read_varint(uint8_t *buf, uint32_t& pos) {
+    uint32_t val = 0;
+    uint8_t shift = 0, digit;
+    do {
+      digit = read<uint8_t>(buf, pos);
+      val |= (uint32_t)(digit & 0x7f) << shift;
+      shift += 7;
+    } while ((digit & 0x80) && (shift < 28));
+    return val;
+  }
+
+  //! Read one MQTT 5 property value
+  /*!
+    \return The value of numeric properties, strings and binary data are skipped and return 0
+  */
+  uint32_t read_property(uint8_t id, uint8_t *buf, uint32_t& pos) {
+    switch (id) {
+    case PAYLOAD_FORMAT:
+    case REQUEST_PROBLEM_INFO:
+    case REQUEST_RESPONSE_INFO:
+    case MAXIMUM_QOS:
+    case RETAIN_AVAILABLE:
+    case WILDCARD_SUB_AVAILABLE:
+    case SUB_ID_AVAILABLE:
+    case SHARED_SUB_AVAILABLE:
+      return read<uint8_t>(buf, pos);
+
+    case SERVER_KEEP_ALIVE:
+    case RECEIVE_MAXIMUM:
+    case TOPIC_ALIAS_MAXIMUM:
+    case TOPIC_ALIAS:
+      return read<uint16_t>(buf, pos);
+
+    case MESSAGE_EXPIRY:
+    case SESSION_EXPIRY:
+    case WILL_DELAY:
+    case MAXIMUM_PACKET_SIZE:
+      return read<uint32_t>(buf, pos);
+
+    case SUBSCRIPTION_ID:
+      return read_varint(buf, pos);
+
+    case USER_PROPERTY:
+      {
+	uint16_t len = read<uint16_t>(buf, pos);	// key
+	pos += len;
+	len = read<uint16_t>(buf, pos);			// value
+	pos += len;
+      }
+      return 0;
+
+    default:
+      {
+	uint16_t len = read<uint16_t>(buf, pos);
+	pos += len;
+      }
+      return 0;
+    }
+  }
+
+  //! Skip the MQTT 5 properties on a network stream
+  /*!
+    \return Number of bytes consumed, including the property length
+  */
+  uint32_t skip_properties(Client& client) {
+    uint32_t length = 0, consumed = 0;
+    uint8_t shift = 0, digit;
+    do {
+      digit = read<uint8_t>(client);
+      consumed++;
+      length |= (uint32_t)(digit & 0x7f) << shift;
+      shift += 7;
+    } while ((digit & 0x80) && (shift < 28));
+
+    for (uint32_t i = 0; i < length; i++)
+      read<uint8_t>(client);
+
+    return consumed + length;
+  }
+
 
   // Message class
   uint8_t Message::fixed_header_length(uint32_t rlength) const {
-    if (rlength < 128)
-      return 2;
-    else if (rlength < 16384)
-      return 3;
-    else if (rlength < 2097152)
-      return 4;
-    else
-      return 5;
+    return 1 + varint_length(rlength);
   }
 
   void Message::write_fixed_header(uint8_t *buf, uint32_t& bufpos, uint32_t rlength) const {
@@ -135,13 +245,7 @@ namespace MQTT {
     bufpos++;
 
     // Remaining length
-    do {
-      uint8_t digit = rlength & 0x7f;
-      rlength >>= 7;
-      if (rlength)
-	digit |= 0x80;
-      buf[bufpos++] = digit;
-    } while (rlength);
+    write_varint(buf, bufpos, rlength);
   }
 
   void Message::write_packet_id(uint8_t *buf, uint32_t& bufpos) const {
@@ -181,6 +285,7 @@ namespace MQTT {
   PacketParser::PacketParser(Client& client) :
     _client(client),
     _state(State::Start),
+    _protocol(MQTT311),
     _msg(nullptr)
   {}
 
@@ -251,14 +356,16 @@ namespace MQTT {
   }
 
   bool PacketParser::_construct_object(void) {
+    _msg = nullptr;	// Unknown packet types are dropped
+
     if (_remaining_length > MQTT_TOO_BIG) {
       switch (_type) {
       case PUBLISH:
-	_msg = new Publish(_flags, _client, _remaining_length);
+	_msg = new Publish(_flags, _client, _remaining_length, _protocol);
 	break;
 
       case SUBACK:
-	_msg = new SubscribeAck(_client, _remaining_length);
+	_msg = new SubscribeAck(_client, _remaining_length, _protocol);
 	break;
 
       default:
@@ -274,7 +381,7 @@ namespace MQTT {
       break;
 
     case PUBLISH:
-      _msg = new Publish(_flags, _remaining_data, _remaining_length);
+      _msg = new Publish(_flags, _remaining_data, _remaining_length, _protocol);
       break;
 
     case PUBACK:
@@ -294,7 +401,7 @@ namespace MQTT {
       break;
 
     case SUBACK:
-      _msg = new SubscribeAck(_remaining_data, _remaining_length);
+      _msg = new SubscribeAck(_remaining_data, _remaining_length, _protocol);
       break;
 
     case UNSUBACK:
@@ -309,6 +416,10 @@ namespace MQTT {
       _msg = new PingResp;
       break;
 
+    case DISCONNECT:
+      _msg = new Disconnect(_remaining_data, _remaining_length);
+      break;
+
     }
     if (_remaining_data != nullptr)
       delete [] _remaining_data;
@@ -357,7 +468,8 @@ namespace MQTT {
     _clean_session(true),
     _clientid(cid),
     _will_message(nullptr), _will_message_len(0),
-    _keepalive(MQTT_KEEPALIVE)
+    _keepalive(MQTT_KEEPALIVE),
+    _session_expiry(0), _receive_maximum(0)
   {}
 
   Connect& Connect::set_will(String willTopic, String willMessage, uint8_t willQos, bool willRetain) {
@@ -395,13 +507,25 @@ namespace MQTT {
       delete [] _will_message;
   }
 
+  uint32_t Connect::properties_length(void) const {
+    uint32_t len = 0;
+    if (_session_expiry)
+      len += 5;
+    if (_receive_maximum)
+      len += 3;
+    return len;
+  }
+
   uint32_t Connect::variable_header_length(void) const {
+    if (_protocol >= MQTT5)
+      return 10 + varint_length(properties_length()) + properties_length();
+
     return 10;
   }
 
   void Connect::write_variable_header(uint8_t *buf, uint32_t& bufpos) const {
     write(buf, bufpos, "MQTT");	// Protocol name
-    buf[bufpos++] = 4;		// Protocol level
+    buf[bufpos++] = _protocol;	// Protocol level
 
     buf[bufpos] = 0;		// Connect flags
     if (_clean_session)
@@ -425,11 +549,25 @@ namespace MQTT {
     bufpos++;
 
     write(buf, bufpos, _keepalive);	// Keepalive period
+
+    if (_protocol >= MQTT5) {
+      write_varint(buf, bufpos, properties_length());
+      if (_session_expiry) {
+	buf[bufpos++] = SESSION_EXPIRY;
+	write32(buf, bufpos, _session_expiry);
+      }
+      if (_receive_maximum) {
+	buf[bufpos++] = RECEIVE_MAXIMUM;
+	write(buf, bufpos, _receive_maximum);
+      }
+    }
   }
 
   uint32_t Connect::payload_length(void) const {
     uint32_t len = 2 + _clientid.length();
     if (_will_topic.length()) {
+      if (_protocol >= MQTT5)
+	len += 1;	// Empty will properties
       len += 2 + _will_topic.length();
       len += 2 + _will_message_len;
     }
@@ -445,6 +583,8 @@ namespace MQTT {
     write(buf, bufpos, _clientid);
 
     if (_will_topic.length()) {
+      if (_protocol >= MQTT5)
+	buf[bufpos++] = 0;	// Empty will properties
       write(buf, bufpos, _will_topic);
       write(buf, bufpos, _will_message, _will_message_len);
     }
@@ -459,12 +599,50 @@ namespace MQTT {
 
   // ConnectAck class
   ConnectAck::ConnectAck(uint8_t* data, uint32_t length) :
-    Message(CONNACK)
+    Message(CONNACK),
+    _session_expiry(0), _receive_maximum(65535),
+    _topic_alias_maximum(0), _server_keepalive(0),
+    _maximum_packet_size(0), _maximum_qos(2)
   {
     uint32_t pos = 0;
     uint8_t reserved = read<uint8_t>(data, pos);
     _session_present = reserved & 0x01;
     _rc = read<uint8_t>(data, pos);
+    _reason_code = _rc;
+
+    // MQTT 3.1.1 acknowledgements end here, MQTT 5 ones always carry properties
+    if (length <= pos)
+      return;
+
+    _protocol = MQTT5;
+    uint32_t end = read_varint(data, pos);
+    end += pos;
+    if (end > length)
+      end = length;
+    while (pos < end) {
+      uint8_t id = read<uint8_t>(data, pos);
+      uint32_t val = read_property(id, data, pos);
+      switch (id) {
+      case SESSION_EXPIRY:
+	_session_expiry = val;
+	break;
+      case RECEIVE_MAXIMUM:
+	_receive_maximum = val;
+	break;
+      case TOPIC_ALIAS_MAXIMUM:
+	_topic_alias_maximum = val;
+	break;
+      case SERVER_KEEP_ALIVE:
+	_server_keepalive = val;
+	break;
+      case MAXIMUM_PACKET_SIZE:
+	_maximum_packet_size = val;
+	break;
+      case MAXIMUM_QOS:
+	_maximum_qos = val;
+	break;
+      }
+    }
   }
 
 
@@ -473,7 +651,8 @@ namespace MQTT {
     Message(PUBLISH),
     _topic(topic),
     _payload(nullptr), _payload_len(0),
-    _payload_mine(false)
+    _payload_mine(false),
+    _topic_alias(0), _send_topic(true)
   {
     if (payload.length() > 0) {
       _payload = new uint8_t[payload.length()];
@@ -487,7 +666,8 @@ namespace MQTT {
     Message(PUBLISH),
     _topic(topic),
     _payload_len(strlen_P((PGM_P)payload)), _payload(new uint8_t[_payload_len + 1]),
-    _payload_mine(true)
+    _payload_mine(true),
+    _topic_alias(0), _send_topic(true)
   {
     strncpy_P((char*)_payload, (PGM_P)payload, _payload_len);
   }
@@ -498,16 +678,51 @@ namespace MQTT {
     return Publish(topic, p, length, true);
   }
 
-  Publish::Publish(uint8_t flags, uint8_t* data, uint32_t length) :
+  uint8_t write_publish_properties(uint8_t *buf, uint16_t topic_alias) {
+    uint32_t pos = 0;
+    if (topic_alias) {
+      buf[pos++] = 3;
+      buf[pos++] = TOPIC_ALIAS;
+      write(buf, pos, topic_alias);
+    } else {
+      buf[pos++] = 0;
+    }
+    return pos;
+  }
+
+  uint8_t write_publish_header(uint8_t *buf, uint16_t topic_len, uint32_t payload_len, bool retain) {
+    uint32_t pos = 0;
+    buf[pos++] = (PUBLISH << 4) | (retain ? 0x01 : 0x00);
+    write_varint(buf, pos, 2 + topic_len + payload_len);
+    write(buf, pos, topic_len);
+    return pos;
+  }
+
+  Publish::Publish(uint8_t flags, uint8_t* data, uint32_t length, uint8_t protocol) :
     Message(PUBLISH, flags),
     _payload(nullptr), _payload_len(0),
-    _payload_mine(false)
+    _payload_mine(false),
+    _topic_alias(0), _send_topic(true)
   {
+    _protocol = protocol;
     uint32_t pos = 0;
     _topic = read<String>(data, pos);
     if (qos() > 0)
       _packet_id = read<uint16_t>(data, pos);
 
+    if (_protocol >= MQTT5) {
+      uint32_t end = read_varint(data, pos);
+      end += pos;
+      if (end > length)
+	end = length;
+      while (pos < end) {
+	uint8_t id = read<uint8_t>(data, pos);
+	uint32_t val = read_property(id, data, pos);
+	if (id == TOPIC_ALIAS)
+	  _topic_alias = val;
+      }
+    }
+
     _payload_len = length - pos;
     if (_payload_len > 0) {
       _payload = new uint8_t[_payload_len];
@@ -520,16 +735,19 @@ namespace MQTT {
     Message(PUBLISH),
     _topic(topic),
     _payload_len(length),
-    _payload(nullptr), _payload_mine(false)
+    _payload(nullptr), _payload_mine(false),
+    _topic_alias(0), _send_topic(true)
   {
     _payload_callback = pcb;
   }
 
-  Publish::Publish(uint8_t flags, Client& client, uint32_t remaining_length) :
+  Publish::Publish(uint8_t flags, Client& client, uint32_t remaining_length, uint8_t protocol) :
     Message(PUBLISH, flags),
     _payload(nullptr), _payload_len(remaining_length),
-    _payload_mine(false)
+    _payload_mine(false),
+    _topic_alias(0), _send_topic(true)
   {
+    _protocol = protocol;
     _stream_client = &client;
 
     // Read the topic
@@ -542,6 +760,10 @@ namespace MQTT {
       _payload_len -= 2;
     }
 
+    // No topic aliases are accepted from the broker, so properties are only skipped
+    if (_protocol >= MQTT5)
+      _payload_len -= skip_properties(client);
+
     // Client stream is now at the start of the payload
   }
 
@@ -571,14 +793,31 @@ namespace MQTT {
     return str;
   }
 
+  uint32_t Publish::properties_length(void) const {
+    return _topic_alias ? 3 : 0;
+  }
+
   uint32_t Publish::variable_header_length(void) const {
-    return 2 + _topic.length() + (qos() ? 2 : 0);
+    uint32_t len = 2 + (_send_topic ? _topic.length() : 0) + (qos() ? 2 : 0);
+    if (_protocol >= MQTT5)
+      len += varint_length(properties_length()) + properties_length();
+    return len;
   }
 
   void Publish::write_variable_header(uint8_t *buf, uint32_t& bufpos) const {
-    write(buf, bufpos, _topic);
+    if (_send_topic)
+      write(buf, bufpos, _topic);
+    else
+      write(buf, bufpos, (uint16_t)0);	// Topic given by the alias
     if (qos())
       write_packet_id(buf, bufpos);
+    if (_protocol >= MQTT5) {
+      write_varint(buf, bufpos, properties_length());
+      if (_topic_alias) {
+	buf[bufpos++] = TOPIC_ALIAS;
+	write(buf, bufpos, _topic_alias);
+      }
+    }
   }
 
   uint32_t Publish::payload_length(void) const {
@@ -614,6 +853,8 @@ namespace MQTT {
   {
     uint32_t pos = 0;
     _packet_id = read<uint16_t>(data, pos);
+    if (length > pos)
+      _reason_code = read<uint8_t>(data, pos);	// MQTT 5, success when left out
   }
 
 
@@ -629,6 +870,8 @@ namespace MQTT {
   {
     uint32_t pos = 0;
     _packet_id = read<uint16_t>(data, pos);
+    if (length > pos)
+      _reason_code = read<uint8_t>(data, pos);	// MQTT 5, success when left out
   }
 
   uint32_t PublishRec::variable_header_length(void) const {
@@ -652,6 +895,8 @@ namespace MQTT {
   {
     uint32_t pos = 0;
     _packet_id = read<uint16_t>(data, pos);
+    if (length > pos)
+      _reason_code = read<uint8_t>(data, pos);	// MQTT 5, success when left out
   }
 
   uint32_t PublishRel::variable_header_length(void) const {
@@ -675,6 +920,8 @@ namespace MQTT {
   {
     uint32_t pos = 0;
     _packet_id = read<uint16_t>(data, pos);
+    if (length > pos)
+      _reason_code = read<uint8_t>(data, pos);	// MQTT 5, success when left out
   }
 
   uint32_t PublishComp::variable_header_length(void) const {
@@ -716,11 +963,13 @@ namespace MQTT {
   }
 
   uint32_t Subscribe::variable_header_length(void) const {
-    return 2;
+    return _protocol >= MQTT5 ? 3 : 2;
   }
 
   void Subscribe::write_variable_header(uint8_t *buf, uint32_t& bufpos) const {
     write_packet_id(buf, bufpos);
+    if (_protocol >= MQTT5)
+      buf[bufpos++] = 0;	// No properties
   }
 
   uint32_t Subscribe::payload_length(void) const {
@@ -734,12 +983,19 @@ namespace MQTT {
 
 
   // SubscribeAck class
-  SubscribeAck::SubscribeAck(uint8_t* data, uint32_t length) :
+  SubscribeAck::SubscribeAck(uint8_t* data, uint32_t length, uint8_t protocol) :
     Message(SUBACK),
     _rcs(nullptr)
   {
+    _protocol = protocol;
     uint32_t pos = 0;
     _packet_id = read<uint16_t>(data, pos);
+    if (_protocol >= MQTT5) {
+      uint32_t props = read_varint(data, pos);
+      pos += props;
+      if (pos > length)
+	pos = length;
+    }
 
     _num_rcs = length - pos;
     if (_num_rcs > 0) {
@@ -749,16 +1005,20 @@ namespace MQTT {
     }
   }
 
-  SubscribeAck::SubscribeAck(Client& client, uint32_t remaining_length) :
+  SubscribeAck::SubscribeAck(Client& client, uint32_t remaining_length, uint8_t protocol) :
     Message(SUBACK),
     _rcs(nullptr),
     _num_rcs(remaining_length - 2)
   {
+    _protocol = protocol;
     _stream_client = &client;
 
     // Read packet id
     _packet_id = read<uint16_t>(client);
 
+    if (_protocol >= MQTT5)
+      _num_rcs -= skip_properties(client);
+
     // Client stream is now at the start of the list of rcs
   }
 
@@ -801,11 +1061,13 @@ namespace MQTT {
   }
 
   uint32_t Unsubscribe::variable_header_length(void) const {
-    return 2;
+    return _protocol >= MQTT5 ? 3 : 2;
   }
 
   void Unsubscribe::write_variable_header(uint8_t *buf, uint32_t& bufpos) const {
     write_packet_id(buf, bufpos);
+    if (_protocol >= MQTT5)
+      buf[bufpos++] = 0;	// No properties
   }
 
   uint32_t Unsubscribe::payload_length(void) const {
@@ -827,4 +1089,14 @@ namespace MQTT {
   }
 
 
+  // Disconnect class
+  Disconnect::Disconnect(uint8_t* data, uint32_t length) :
+    Message(DISCONNECT)
+  {
+    uint32_t pos = 0;
+    if (length > pos)
+      _reason_code = read<uint8_t>(data, pos);	// MQTT 5, normal disconnection when left out
+  }
+
+
 } // namespace MQTT
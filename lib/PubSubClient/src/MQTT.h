@@ -29,11 +29,29 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 // MQTT_KEEPALIVE : keepAlive interval in Seconds
 #define MQTT_KEEPALIVE 15
 
+// MQTT_CONNECT_TIMEOUT : milliseconds connect_poll() waits for CONNACK, subscribe_poll() for SUBACK
+#ifndef MQTT_CONNECT_TIMEOUT
+#define MQTT_CONNECT_TIMEOUT 10000UL
+#endif
+
 // Packets larger than this can only be streamed
 #ifndef MQTT_TOO_BIG
 #define MQTT_TOO_BIG 4096
 #endif
 
+// Publish by topic pointer assembles packets up to this size on the stack
+#ifndef MQTT_PUBLISH_STACK_SIZE
+#define MQTT_PUBLISH_STACK_SIZE 128
+#endif
+
+// Fixed header (at most 5 bytes) and topic length
+#define MQTT_PUBLISH_HEADER_MAX 7
+
+// Outgoing topic aliases remembered per connection in MQTT 5 mode
+#ifndef MQTT_TOPIC_ALIASES
+#define MQTT_TOPIC_ALIASES 8
+#endif
+
 class PubSubClient;
 
 //! namespace for classes representing MQTT messages
@@ -58,6 +76,43 @@ namespace MQTT {
     Reserved,		// Reserved
   };
 
+  //! Protocol level sent in CONNECT, used by every packet of that connection
+  enum protocol_level {
+    MQTT311 = 4,	// MQTT 3.1.1
+    MQTT5 = 5,		// MQTT 5.0: properties, topic aliases, reason codes
+  };
+
+  //! MQTT 5 property identifiers
+  enum property_id {
+    PAYLOAD_FORMAT = 0x01,		// byte
+    MESSAGE_EXPIRY = 0x02,		// four byte integer
+    CONTENT_TYPE = 0x03,		// string
+    RESPONSE_TOPIC = 0x08,		// string
+    CORRELATION_DATA = 0x09,		// binary data
+    SUBSCRIPTION_ID = 0x0B,		// variable byte integer
+    SESSION_EXPIRY = 0x11,		// four byte integer
+    ASSIGNED_CLIENT_ID = 0x12,		// string
+    SERVER_KEEP_ALIVE = 0x13,		// two byte integer
+    AUTH_METHOD = 0x15,			// string
+    AUTH_DATA = 0x16,			// binary data
+    REQUEST_PROBLEM_INFO = 0x17,	// byte
+    WILL_DELAY = 0x18,			// four byte integer
+    REQUEST_RESPONSE_INFO = 0x19,	// byte
+    RESPONSE_INFO = 0x1A,		// string
+    SERVER_REFERENCE = 0x1C,		// string
+    REASON_STRING = 0x1F,		// string
+    RECEIVE_MAXIMUM = 0x21,		// two byte integer
+    TOPIC_ALIAS_MAXIMUM = 0x22,		// two byte integer
+    TOPIC_ALIAS = 0x23,			// two byte integer
+    MAXIMUM_QOS = 0x24,			// byte
+    RETAIN_AVAILABLE = 0x25,		// byte
+    USER_PROPERTY = 0x26,		// string pair
+    MAXIMUM_PACKET_SIZE = 0x27,		// four byte integer
+    WILDCARD_SUB_AVAILABLE = 0x28,	// byte
+    SUB_ID_AVAILABLE = 0x29,		// byte
+    SHARED_SUB_AVAILABLE = 0x2A,	// byte
+  };
+
   //! The Quality of Service (QoS) level is an agreement between sender and receiver of a message regarding the guarantees of delivering a message.  
   enum Qos {
       QOS0 = 0,  //! At most once
@@ -78,6 +133,8 @@ namespace MQTT {
     uint8_t _flags;
     uint16_t _packet_id;	//! Not all message types use a packet id, but most do
     bool _need_packet_id;
+    uint8_t _protocol;		//! Protocol level of the connection
+    uint8_t _reason_code;	//! MQTT 5 reason code of a received acknowledgement or disconnect
     Client* _stream_client;
     payload_callback_t _payload_callback;
 
@@ -85,6 +142,7 @@ namespace MQTT {
     Message(message_type t, uint8_t f = 0) :
       _type(t), _flags(f),
       _packet_id(0), _need_packet_id(false),
+      _protocol(MQTT311), _reason_code(0),
       _stream_client(nullptr),
       _payload_callback(nullptr)
     {}
@@ -112,6 +170,9 @@ namespace MQTT {
     //! Set the packet id
     void set_packet_id(uint16_t pid) { _packet_id = pid; }
 
+    //! Set the protocol level of the connection this message is sent on
+    void use_protocol(uint8_t p) { _protocol = p; }
+
     //! Write the packet id to a buffer
     /*!
       \param buf Pointer to start of buffer (never advances)
@@ -154,6 +215,12 @@ namespace MQTT {
     //! Get the packet id
     uint16_t packet_id(void) const { return _packet_id; }
 
+    //! Get the protocol level
+    uint8_t protocol(void) const { return _protocol; }
+
+    //! Get the reason code, 0 is success and 0x80 or above is failure (MQTT 5)
+    uint8_t reason_code(void) const { return _reason_code; }
+
     //! Does this message have a network stream for reading the (large) payload?
     bool has_stream(void) const { return _stream_client != nullptr; }
 
@@ -173,6 +240,7 @@ namespace MQTT {
 
     Client &_client;
     State _state;
+    uint8_t _protocol;
     uint8_t _flags, _type, _length_shifter;
     uint32_t _remaining_length, _to_read;
     uint8_t *_remaining_data, *_read_point;
@@ -186,6 +254,9 @@ namespace MQTT {
   public:
     PacketParser(Client& client);
 
+    //! Set the protocol level packets are parsed with
+    void set_protocol(uint8_t p) { _protocol = p; }
+
   /*!
     remember to free the object once you're finished with it
     \return A pointer to an object derived from the Message class, representing the packet. If no complete packet was available, nullptr is returned.
@@ -209,6 +280,12 @@ namespace MQTT {
 
     uint16_t _keepalive;
 
+    uint32_t _session_expiry;
+    uint16_t _receive_maximum;
+
+    //! Length of the MQTT 5 properties, without their length
+    uint32_t properties_length(void) const;
+
     uint32_t variable_header_length(void) const;
     void write_variable_header(uint8_t *buf, uint32_t& bufpos) const;
     uint32_t payload_length(void) const;
@@ -242,6 +319,18 @@ namespace MQTT {
     //! Set the keepalive period
     Connect& set_keepalive(uint16_t k)	{ _keepalive = k; return *this; }
 
+    //! Set the protocol level, MQTT311 by default
+    Connect& set_protocol(protocol_level p)	{ _protocol = p; return *this; }
+
+    //! Set how long the broker keeps the session after disconnecting, in seconds (MQTT 5)
+    /*!
+      0 ends the session with the connection, 0xFFFFFFFF never expires it.
+     */
+    Connect& set_session_expiry(uint32_t s)	{ _session_expiry = s; return *this; }
+
+    //! Set how many QoS 1 and 2 publishes the broker may send before they are acknowledged (MQTT 5)
+    Connect& set_receive_maximum(uint16_t r)	{ _receive_maximum = r; return *this; }
+
     ~Connect();
 
   };
@@ -253,14 +342,38 @@ namespace MQTT {
     bool _session_present;
     uint8_t _rc;
 
+    uint32_t _session_expiry;
+    uint16_t _receive_maximum;
+    uint16_t _topic_alias_maximum;
+    uint16_t _server_keepalive;
+    uint32_t _maximum_packet_size;
+    uint8_t _maximum_qos;
+
     //! Private constructor from a network buffer
     ConnectAck(uint8_t* data, uint32_t length);
 
     friend PacketParser;
 
   public:
+    //! Return code, or reason code in MQTT 5
     uint8_t rc(void) const { return _rc; }
 
+    //! Did the broker resume a previous session?
+    bool session_present(void) const { return _session_present; }
+
+    //! Session expiry the broker settled on, in seconds (MQTT 5)
+    uint32_t session_expiry(void) const { return _session_expiry; }
+    //! QoS 1 and 2 publishes the broker accepts before acknowledging them (MQTT 5)
+    uint16_t receive_maximum(void) const { return _receive_maximum; }
+    //! Highest topic alias the broker accepts, 0 for none (MQTT 5)
+    uint16_t topic_alias_maximum(void) const { return _topic_alias_maximum; }
+    //! Keepalive the client must use instead of its own, 0 if not set (MQTT 5)
+    uint16_t server_keepalive(void) const { return _server_keepalive; }
+    //! Largest packet the broker accepts, 0 if not limited (MQTT 5)
+    uint32_t maximum_packet_size(void) const { return _maximum_packet_size; }
+    //! Highest QoS the broker supports (MQTT 5)
+    uint8_t maximum_qos(void) const { return _maximum_qos; }
+
   };
 
 
@@ -271,6 +384,11 @@ namespace MQTT {
     uint8_t *_payload;
     uint32_t _payload_len;
     bool _payload_mine;
+    uint16_t _topic_alias;	//! MQTT 5 topic alias, 0 for none
+    bool _send_topic;		//! False once the broker knows the alias
+
+    //! Length of the MQTT 5 properties, without their length
+    uint32_t properties_length(void) const;
 
     uint32_t variable_header_length(void) const;
     void write_variable_header(uint8_t *buf, uint32_t& bufpos) const;
@@ -284,16 +402,21 @@ namespace MQTT {
       Message(PUBLISH),
       _topic(topic),
       _payload(payload), _payload_len(length),
-      _payload_mine(mine)
+      _payload_mine(mine),
+      _topic_alias(0), _send_topic(true)
     {}
 
     //! Private constructor from a network buffer
-    Publish(uint8_t flags, uint8_t* data, uint32_t length);
+    Publish(uint8_t flags, uint8_t* data, uint32_t length, uint8_t protocol);
 
     //! Private constructor from a network stream
-    Publish(uint8_t flags, Client& client, uint32_t remaining_length);
+    Publish(uint8_t flags, Client& client, uint32_t remaining_length, uint8_t protocol);
+
+    //! Send the topic alias instead of, or together with, the topic
+    void set_topic_alias(uint16_t alias, bool send_topic) { _topic_alias = alias; _send_topic = send_topic; }
 
     friend PacketParser;
+    friend PubSubClient;	// Assigns topic aliases
 
   public:
     //! Constructor from string payload
@@ -352,6 +475,9 @@ namespace MQTT {
     //! Get the topic string
     String topic(void) const { return _topic; }
 
+    //! Get the MQTT 5 topic alias, 0 for none
+    uint16_t topic_alias(void) const { return _topic_alias; }
+
     //! Get the payload as a string
     String payload_string(void) const;
 
@@ -367,6 +493,24 @@ namespace MQTT {
   //! A function made to look like a constructor, reading the payload from flash
   Publish Publish_P(String topic, PGM_P payload, uint32_t length);
 
+  //! Write the MQTT 5 properties of a QoS 0 publish
+  /*!
+    \param buf At least 4 bytes
+    \param topic_alias Topic alias, 0 for none
+    \return Number of bytes written
+   */
+  uint8_t write_publish_properties(uint8_t *buf, uint16_t topic_alias);
+
+  //! Write the fixed header and topic length of a QoS 0 publish
+  /*!
+    \param buf At least MQTT_PUBLISH_HEADER_MAX bytes
+    \param topic_len Length of the topic that follows
+    \param payload_len Length of the payload that follows the topic
+    \param retain Retain flag
+    \return Number of bytes written
+   */
+  uint8_t write_publish_header(uint8_t *buf, uint16_t topic_len, uint32_t payload_len, bool retain);
+
 
   //! Response to Publish when qos == 1
   class PublishAck : public Message {
@@ -479,10 +623,10 @@ namespace MQTT {
     uint32_t _num_rcs;
 
     //! Private constructor from a network buffer
-    SubscribeAck(uint8_t* data, uint32_t length);
+    SubscribeAck(uint8_t* data, uint32_t length, uint8_t protocol);
 
     //! Private constructor from a network stream
-    SubscribeAck(Client& client, uint32_t remaining_length);
+    SubscribeAck(Client& client, uint32_t remaining_length, uint8_t protocol);
 
     friend PacketParser;
 
@@ -565,8 +709,14 @@ namespace MQTT {
   };
 
 
-  //! Disconnect from the broker
+  //! Disconnect from the broker, or from the client with a reason code (MQTT 5)
   class Disconnect : public Message {
+  private:
+    //! Private constructor from a network buffer
+    Disconnect(uint8_t* data, uint32_t length);
+
+    friend PacketParser;
+
   public:
     //! Constructor
     Disconnect() :
@@ -12,27 +12,48 @@ PubSubClient::PubSubClient(Client& c) :
   _client(c),
   _parser(c),
   _max_retries(10),
-  isSubAckFound(false)
+  isSubAckFound(false),
+  _connecting(false),
+  _session_present(false),
+  _protocol(MQTT::MQTT311),
+  _receive_maximum(65535),
+  _topic_alias_maximum(0), _topic_alias_count(0),
+  _disconnect_reason(0),
+  _suback_pid(0)
 {}
 
 PubSubClient::PubSubClient(Client& c, IPAddress &ip, uint16_t port) :
+  server_ip(ip),
+  server_port(port),
   _callback(nullptr),
   _client(c),
   _parser(c),
   _max_retries(10),
   isSubAckFound(false),
-  server_ip(ip),
-  server_port(port)
+  _connecting(false),
+  _session_present(false),
+  _protocol(MQTT::MQTT311),
+  _receive_maximum(65535),
+  _topic_alias_maximum(0), _topic_alias_count(0),
+  _disconnect_reason(0),
+  _suback_pid(0)
 {}
 
 PubSubClient::PubSubClient(Client& c, String hostname, uint16_t port) :
+  server_hostname(hostname),
+  server_port(port),
   _callback(nullptr),
   _client(c),
   _parser(c),
   _max_retries(10),
   isSubAckFound(false),
-  server_port(port),
-  server_hostname(hostname)
+  _connecting(false),
+  _session_present(false),
+  _protocol(MQTT::MQTT311),
+  _receive_maximum(65535),
+  _topic_alias_maximum(0), _topic_alias_count(0),
+  _disconnect_reason(0),
+  _suback_pid(0)
 {}
 
 PubSubClient& PubSubClient::set_server(IPAddress &ip, uint16_t port) {
@@ -56,6 +77,7 @@ MQTT::Message* PubSubClient::_recv_message(void) {
 }
 
 bool PubSubClient::_send_message(MQTT::Message& msg) {
+  msg.use_protocol(_protocol);
   if (msg.need_packet_id())
     msg.set_packet_id(_next_packet_id());
 
@@ -74,6 +96,7 @@ bool PubSubClient::_send_message(MQTT::Message& msg) {
 }
 
 MQTT::Message* PubSubClient::_send_message_with_response(MQTT::Message& msg) {
+  msg.use_protocol(_protocol);
   if (msg.need_packet_id())
     msg.set_packet_id(_next_packet_id());
 
@@ -140,9 +163,39 @@ void PubSubClient::_process_message(MQTT::Message* msg) {
 
   case MQTT::PINGRESP:
     pingOutstanding = false;
+    break;
+
+  case MQTT::DISCONNECT:
+    _disconnect_reason = msg->reason_code();
+    _client.stop();
   }
 }
 
+uint16_t PubSubClient::_topic_alias(const char *topic, uint16_t topic_len, bool& send_topic) {
+  send_topic = true;
+  if ((_protocol < MQTT::MQTT5) || (topic_len == 0))
+    return 0;
+
+  for (uint16_t i = 0; i < _topic_alias_count; i++) {
+    const String &known = _topic_aliases[i];
+    if ((known.length() == topic_len) && (memcmp(known.c_str(), topic, topic_len) == 0)) {
+      send_topic = false;
+      return i + 1;
+    }
+  }
+
+  if (_topic_alias_count >= _topic_alias_maximum)
+    return 0;
+
+  // Sent together with the topic once, the broker remembers it from then on
+  String &alias = _topic_aliases[_topic_alias_count];
+  alias = "";
+  alias.reserve(topic_len);
+  for (uint16_t i = 0; i < topic_len; i++)
+    alias += topic[i];
+  return ++_topic_alias_count;
+}
+
 MQTT::Message* PubSubClient::_wait_for(MQTT::message_type wait_type, uint16_t wait_pid) {
   while (!_client.available()) {
     if (millis() - lastInActivity > keepalive * 1000UL)
@@ -195,10 +248,7 @@ bool PubSubClient::connect(String id, String willTopic, uint8_t willQos, bool wi
   return connect(conn);
 }
 
-bool PubSubClient::connect(MQTT::Connect &conn) {
-  if (connected())
-    return false;
-
+bool PubSubClient::_open(MQTT::Connect &conn) {
   int result = 0;
 
   if (server_hostname.length() > 0)
@@ -213,8 +263,42 @@ bool PubSubClient::connect(MQTT::Connect &conn) {
 
   pingOutstanding = false;
   nextMsgId = 1;		// Init the next packet id
+  _protocol = conn.protocol();	// Every packet of this connection uses it
+  _parser.set_protocol(_protocol);
+  _receive_maximum = 65535;
+  _topic_alias_maximum = 0;	// Aliases do not survive the connection
+  _topic_alias_count = 0;
+  _disconnect_reason = 0;
+  _session_present = false;
   lastInActivity = millis();	// Init this so that _wait_for() doesn't think we've already timed-out
   keepalive = conn.keepalive();	// Store the keepalive period from this connection
+  return true;
+}
+
+bool PubSubClient::_accept(MQTT::ConnectAck &ack) {
+  if (ack.rc() > 0) {
+    _client.stop();
+    return false;
+  }
+
+  _session_present = ack.session_present();
+  if (_protocol >= MQTT::MQTT5) {
+    _receive_maximum = ack.receive_maximum();
+    _topic_alias_maximum = ack.topic_alias_maximum();
+    if (_topic_alias_maximum > MQTT_TOPIC_ALIASES)
+      _topic_alias_maximum = MQTT_TOPIC_ALIASES;
+    if (ack.server_keepalive() > 0)
+      keepalive = ack.server_keepalive();	// The broker's keepalive wins
+  }
+  return true;
+}
+
+bool PubSubClient::connect(MQTT::Connect &conn) {
+  if (connected())
+    return false;
+
+  if (!_open(conn))
+    return false;
 
   MQTT::Message *response = _send_message_with_response(conn);
   if (response == nullptr) {
@@ -223,19 +307,67 @@ bool PubSubClient::connect(MQTT::Connect &conn) {
   }
 
   bool ret = true;
-  if (response->type() == MQTT::CONNACK) {
-    MQTT::ConnectAck *ack = static_cast<MQTT::ConnectAck*>(response);
-    if (ack->rc() > 0) {
-      _client.stop();
-      ret = false;
-    }
-  }
+  if (response->type() == MQTT::CONNACK)
+    ret = _accept(*static_cast<MQTT::ConnectAck*>(response));
   delete response;
 
   return ret;
 }
 
+bool PubSubClient::connect_start(MQTT::Connect &conn) {
+  _connecting = false;
+  if (connected())
+    return false;
+
+  if (!_open(conn))
+    return false;
+
+  if (!_send_message(conn)) {
+    _client.stop();
+    return false;
+  }
+
+  _connecting = true;
+  _connect_started = millis();
+  return true;
+}
+
+PubSubClient::connect_result PubSubClient::connect_poll(void) {
+  if (!_connecting)
+    return connected() ? CONNECT_DONE : CONNECT_FAILED;
+
+  if (!_client.connected()) {
+    _connecting = false;
+    _client.stop();
+    return CONNECT_FAILED;
+  }
+
+  while (_client.available()) {
+    MQTT::Message *msg = _recv_message();
+    if (msg == nullptr)
+      break;	// Rest of the packet comes later
+
+    if (msg->type() == MQTT::CONNACK) {
+      _connecting = false;
+      bool ok = _accept(*static_cast<MQTT::ConnectAck*>(msg));
+      delete msg;
+      return ok ? CONNECT_DONE : CONNECT_FAILED;
+    }
+    delete msg;	// Nothing else is valid before CONNACK
+  }
+
+  if (millis() - _connect_started > MQTT_CONNECT_TIMEOUT) {
+    _connecting = false;
+    _client.stop();
+    return CONNECT_FAILED;
+  }
+  return CONNECT_PENDING;
+}
+
 bool PubSubClient::loop() {
+  if (_connecting)
+    return connect_poll() == CONNECT_DONE;
+
   if (!connected())
     return false;
 
@@ -299,11 +431,57 @@ bool PubSubClient::publish_P(String topic, PGM_P payload, uint32_t plength, bool
   return publish(pub);
 }
 
+bool PubSubClient::publish(const char *topic, uint16_t topic_len, const uint8_t *payload, uint32_t plength, bool retained) {
+  if (!connected())
+    return false;
+
+  bool send_topic;
+  uint16_t alias = _topic_alias(topic, topic_len, send_topic);
+  if (!send_topic)
+    topic_len = 0;	// The broker knows the topic by its alias
+
+  uint8_t props[4];
+  uint32_t props_len = 0;
+  if (_protocol >= MQTT::MQTT5)
+    props_len = MQTT::write_publish_properties(props, alias);
+
+  uint8_t packet[MQTT_PUBLISH_STACK_SIZE];
+  uint32_t pos = MQTT::write_publish_header(packet, topic_len, props_len + plength, retained);
+  uint32_t total = pos + topic_len + props_len + plength;
+  bool ok;
+  if (total <= sizeof(packet)) {
+    memcpy(packet + pos, topic, topic_len);
+    memcpy(packet + pos + topic_len, props, props_len);
+    memcpy(packet + pos + topic_len + props_len, payload, plength);
+    ok = _client.write(packet, total) == total;
+  } else {
+    memcpy(packet + pos, props, props_len);
+    ok = (_client.write(packet, pos) == pos)
+      && (_client.write((const uint8_t*)topic, topic_len) == topic_len)
+      && (_client.write(packet + pos, props_len) == props_len)
+      && (_client.write(payload, plength) == plength);
+  }
+  if (!ok)
+    return false;
+
+  lastOutActivity = millis();
+  return true;
+}
+
 bool PubSubClient::publish(MQTT::Publish &pub) {
   if (!connected())
     return false;
 
+  if ((_protocol >= MQTT::MQTT5) || (pub.topic_alias() > 0)) {
+    // Aliases belong to the connection, a reused object gets them again
+    bool send_topic;
+    String topic = pub.topic();
+    uint16_t alias = _topic_alias(topic.c_str(), topic.length(), send_topic);
+    pub.set_topic_alias(alias, send_topic);
+  }
+
   MQTT::Message *response;
+  bool ok;
   switch (pub.qos()) {
   case 0:
     return _send_message(pub);
@@ -313,8 +491,9 @@ bool PubSubClient::publish(MQTT::Publish &pub) {
     if (response == nullptr)
       return false;
 
+    ok = response->reason_code() < 0x80;
     delete response;
-    return true;
+    return ok;
 
   case 2:
     {
@@ -322,7 +501,10 @@ bool PubSubClient::publish(MQTT::Publish &pub) {
       if (response == nullptr)
 	return false;
 
+      ok = response->reason_code() < 0x80;
       delete response;
+      if (!ok)
+	return false;	// No PUBREL after a failed PUBREC
 
       MQTT::PublishRel pubrel(pub.packet_id());
       response = _send_message_with_response(pubrel);
@@ -359,6 +541,53 @@ bool PubSubClient::subscribe(MQTT::Subscribe &sub) {
   return true;
 }
 
+bool PubSubClient::subscribe_start(String topic, uint8_t qos) {
+  _suback_pid = 0;
+  if (!connected())
+    return false;
+
+  if (qos > 2)
+    return false;
+
+  MQTT::Subscribe sub(topic, qos);
+  if (!_send_message(sub))
+    return false;
+
+  _suback_pid = sub.packet_id();
+  _subscribe_started = millis();
+  return true;
+}
+
+PubSubClient::subscribe_result PubSubClient::subscribe_poll(void) {
+  if (_suback_pid == 0)
+    return connected() ? SUBSCRIBE_DONE : SUBSCRIBE_FAILED;
+
+  if (!connected()) {
+    _suback_pid = 0;
+    return SUBSCRIBE_FAILED;
+  }
+
+  while (_client.available()) {
+    MQTT::Message *msg = _recv_message();
+    if (msg == nullptr)
+      break;	// Rest of the packet comes later
+
+    if ((msg->type() == MQTT::SUBACK) && (msg->packet_id() == _suback_pid)) {
+      _suback_pid = 0;
+      delete msg;
+      return SUBSCRIBE_DONE;
+    }
+    _process_message(msg);	// e.g. messages queued in a resumed session
+    delete msg;
+  }
+
+  if (millis() - _subscribe_started > MQTT_CONNECT_TIMEOUT) {
+    _suback_pid = 0;
+    return SUBSCRIBE_FAILED;
+  }
+  return SUBSCRIBE_PENDING;
+}
+
 bool PubSubClient::unsubscribe(String topic) {
   if (!connected())
     return false;
@@ -380,6 +609,12 @@ bool PubSubClient::unsubscribe(MQTT::Unsubscribe &unsub) {
 }
 
 void PubSubClient::disconnect() {
+   if (_connecting) {
+     _connecting = false;	// Nothing to say before CONNACK
+     _client.stop();
+     return;
+   }
+
    if (!connected())
      return;
 
@@ -391,8 +626,10 @@ void PubSubClient::disconnect() {
 
 bool PubSubClient::connected() {
    bool rc = _client.connected();
-   if (!rc)
+   if (!rc) {
+     _connecting = false;
      _client.stop();
+   }
 
-   return rc;
+   return rc && !_connecting;
 }
@@ -25,6 +25,20 @@ public:
   typedef void(*callback_t)(const MQTT::Publish&);
 #endif
 
+  //! State of a connect started by connect_start()
+  enum connect_result {
+    CONNECT_FAILED = -1,	// Refused, timed out or connection lost
+    CONNECT_PENDING = 0,	// CONNACK not received yet
+    CONNECT_DONE = 1,		// Connected
+  };
+
+  //! State of a subscribe started by subscribe_start()
+  enum subscribe_result {
+    SUBSCRIBE_FAILED = -1,	// Connection lost or no SUBACK in time
+    SUBSCRIBE_PENDING = 0,	// SUBACK not received yet
+    SUBSCRIBE_DONE = 1,		// Subscribed
+  };
+
 private:
    IPAddress server_ip;
    String server_hostname;
@@ -39,6 +53,38 @@ private:
    unsigned long lastInActivity;
    bool pingOutstanding;
    bool isSubAckFound;
+   bool _connecting;			// connect_start() waiting for CONNACK
+   unsigned long _connect_started;
+   bool _session_present;		// Broker kept the session of a previous connection
+
+   uint8_t _protocol;			// Protocol level of the current connection
+   uint16_t _receive_maximum;		// Broker's Receive Maximum (MQTT 5)
+   uint16_t _topic_alias_maximum;	// Aliases usable on this connection (MQTT 5)
+   uint16_t _topic_alias_count;
+   String _topic_aliases[MQTT_TOPIC_ALIASES];	// Topic of alias i + 1
+   uint8_t _disconnect_reason;
+   uint16_t _suback_pid;		// subscribe_start() waiting for this SUBACK
+   unsigned long _subscribe_started;
+
+   //! Find or assign the topic alias of a topic (MQTT 5)
+   /*!
+     Aliases are assigned on first use until the broker's Topic Alias Maximum
+     or MQTT_TOPIC_ALIASES is reached; later topics are sent in full.
+     \param topic Topic, need not be null-terminated
+     \param topic_len Length of the topic in bytes
+     \param send_topic Set to false when the broker already knows the alias
+     \return The alias, 0 for none
+    */
+   uint16_t _topic_alias(const char *topic, uint16_t topic_len, bool& send_topic);
+
+   //! Open the network connection and reset the per-connection state
+   bool _open(MQTT::Connect &conn);
+
+   //! Check the broker's CONNACK and apply what it settled on
+   /*!
+     \return Was the connection accepted?
+    */
+   bool _accept(MQTT::ConnectAck &ack);
 
    //! Receive a message from the client
    /*!
@@ -130,6 +176,22 @@ public:
     */
    bool connect(String id, String willTopic, uint8_t willQos, bool willRetain, String willMessage);
 
+   //! Start connecting without waiting for the broker
+   /*!
+     Opens the network connection and sends CONNECT, then returns. Call
+     connect_poll() (or loop()) until it stops returning CONNECT_PENDING.
+     The same object can be started again after the connection is lost.
+     \return Was CONNECT sent?
+    */
+   bool connect_start(MQTT::Connect &conn);
+
+   //! Check for the CONNACK of connect_start() without blocking
+   /*!
+     Fails when the broker refuses, closes the connection or does not
+     answer within MQTT_CONNECT_TIMEOUT.
+    */
+   connect_result connect_poll(void);
+
    //! Disconnect from the server
    void disconnect(void);
 
@@ -170,6 +232,18 @@ public:
    */
    bool publish_P(String topic, PGM_P payload, uint32_t plength, bool retained = false);
 
+   //! Publish to a topic kept by the caller, without allocating
+   /*!
+     QoS 0 only. Small packets are assembled on the stack and written at
+     once, larger ones are written as header, topic and payload.
+     \param topic Topic of the message, need not be null-terminated
+     \param topic_len Length of the topic in bytes
+     \param payload Pointer to contents of the message
+     \param plength Length of the message (pointed to by payload) in bytes
+     \param retained If true, this message will be stored on the server
+   */
+   bool publish(const char *topic, uint16_t topic_len, const uint8_t *payload, uint32_t plength, bool retained = false);
+
    //! Subscribe to a topic
    /*!
      \param topic Topic filter
@@ -177,6 +251,22 @@ public:
     */
    bool subscribe(String topic, uint8_t qos = 0);
 
+   //! Start subscribing without waiting for the broker
+   /*!
+     Sends SUBSCRIBE and returns. Call subscribe_poll() until it stops
+     returning SUBSCRIBE_PENDING.
+     \return Was SUBSCRIBE sent?
+    */
+   bool subscribe_start(String topic, uint8_t qos = 0);
+
+   //! Check for the SUBACK of subscribe_start() without blocking
+   /*!
+     Messages arriving before the SUBACK go to the callback. Fails when the
+     connection is lost or the broker does not answer within
+     MQTT_CONNECT_TIMEOUT.
+    */
+   subscribe_result subscribe_poll(void);
+
    //! Unsubscribe from a topic
    bool unsubscribe(String topic);
 
@@ -186,10 +276,38 @@ public:
    */
    bool loop();
 
-   //! Are we connected?
+   //! Are we connected? False until the CONNACK of connect_start() arrives
    bool connected();
 
+   //! Did the broker resume a stored session?
+   /*!
+     Only with conn.unset_clean_session(): subscriptions of the previous
+     connection are still in place and QoS 1 and 2 messages sent meanwhile
+     are delivered, so they need not be subscribed again.
+    */
+   bool session_present(void) const { return _session_present; }
+
+   //! Protocol level of the current connection
+   uint8_t protocol(void) const { return _protocol; }
+
+   //! QoS 1 and 2 publishes the broker accepts unacknowledged (MQTT 5)
+   /*!
+     Publishes wait for their acknowledgement, so at most one is ever in flight
+    */
+   uint16_t receive_maximum(void) const { return _receive_maximum; }
+
+   //! Topic aliases used on this connection (MQTT 5)
+   uint16_t topic_alias_maximum(void) const { return _topic_alias_maximum; }
+
+   //! Reason code of the last DISCONNECT sent by the broker (MQTT 5)
+   uint8_t disconnect_reason(void) const { return _disconnect_reason; }
+
    //! Connect with a pre-constructed MQTT message object
+   /*!
+     With conn.set_protocol(MQTT::MQTT5) the whole connection speaks MQTT 5:
+     topics published repeatedly are replaced by topic aliases and failure
+     reason codes in acknowledgements make publish() return false.
+    */
    bool connect(MQTT::Connect &conn);
    //! Publish with a pre-constructed MQTT message object
    bool publish(MQTT::Publish &pub);
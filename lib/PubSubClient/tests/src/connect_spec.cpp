@@ -285,6 +285,143 @@ int test_connect_disconnect_connect() {
     END_IT
 }
 
+int test_connect_nonblocking() {
+    IT("connects without waiting for the connack");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    IS_TRUE(client.connect_start(conn));
+
+    // broker has not answered yet
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_PENDING);
+    IS_FALSE(client.connected());
+    IS_FALSE(client.publish("topic", "payload"));
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_DONE);
+    IS_TRUE(client.connected());
+
+    END_IT
+}
+
+int test_connect_nonblocking_bad_rc() {
+    IT("fails a non-blocking connect the broker refuses");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x05 };	// not authorized
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    IS_TRUE(client.connect_start(conn));
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_FAILED);
+    IS_FALSE(client.connected());
+
+    END_IT
+}
+
+int test_connect_nonblocking_broker_restart() {
+    IT("reconnects the same client after the broker restarts");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    byte suback[] = { 0x90,0x3,0x0,0x2,0x0 };
+    shimClient.respond(connack,4);
+    shimClient.respond(suback,5);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    IS_TRUE(client.connect_start(conn));
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_DONE);
+    IS_TRUE(client.subscribe("topic"));
+
+    // broker goes away
+    shimClient.setConnected(false);
+    IS_FALSE(client.loop());
+    IS_FALSE(client.connected());
+
+    // and refuses connections while it restarts
+    shimClient.setAllowConnect(false);
+    IS_FALSE(client.connect_start(conn));
+
+    // back up: same instance connects and subscribes again
+    shimClient.setAllowConnect(true);
+    byte connect[] = { 0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x2,0x0,0xf,
+		       0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31 };
+    byte subscribe[] = { 0x82,0xa,0x0,0x2,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0 };
+    shimClient.expect(connect,26);
+    shimClient.expect(subscribe,12);
+    IS_TRUE(client.connect_start(conn));
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_PENDING);
+    shimClient.respond(connack,4);
+    shimClient.respond(suback,5);
+    IS_TRUE(client.loop());	// loop() finishes the connect too
+    IS_TRUE(client.connected());
+    IS_TRUE(client.subscribe("topic"));
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_connect_nonblocking_connection_lost() {
+    IT("fails a non-blocking connect when the connection drops before connack");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    IS_TRUE(client.connect_start(conn));
+    shimClient.setConnected(false);
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_FAILED);
+    IS_FALSE(client.connected());
+
+    END_IT
+}
+
+int test_connect_session_present() {
+    IT("resumes a stored session and receives what was sent meanwhile");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connect[] = { 0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,
+		       0x0,		// flags: no clean session
+		       0x0,0xf,
+		       0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31 };
+    byte connack[] = { 0x20, 0x02, 0x01, 0x00 };	// session present
+    byte publish[] = { 0x32,0xb,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x7,0x68,0x69 };	// qos 1, id 7
+    byte puback[] = { 0x40,0x2,0x0,0x7 };
+    shimClient.expect(connect,26);
+    shimClient.expect(puback,4);
+    shimClient.respond(connack,4);
+    shimClient.respond(publish,13);
+
+    PubSubClient client(shimClient, server, 1883);
+    client.set_callback(callback);
+    MQTT::Connect conn("client_test1");
+    conn.unset_clean_session();
+    IS_TRUE(client.connect_start(conn));
+    IS_EQUAL(client.connect_poll(), PubSubClient::CONNECT_DONE);
+    IS_TRUE(client.session_present());
+
+    // delivered without subscribing again
+    IS_TRUE(client.loop());
+    IS_FALSE(shimClient.error());
+
+    // a new session on the next connection
+    client.disconnect();
+    byte connack_new[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack_new,4);
+    IS_TRUE(client.connect("client_test1"));
+    IS_FALSE(client.session_present());
+
+    END_IT
+}
+
 int main()
 {
     test_connect_fails_no_network();
@@ -298,6 +435,11 @@ int main()
     test_connect_with_will();
     test_connect_with_will_username_password();
     test_connect_disconnect_connect();
+    test_connect_nonblocking();
+    test_connect_nonblocking_bad_rc();
+    test_connect_nonblocking_broker_restart();
+    test_connect_nonblocking_connection_lost();
+    test_connect_session_present();
     
     FINISH
 }
@@ -0,0 +1,317 @@
+#include "PubSubClient.h"
+#include "ShimClient.h"
+#include "Buffer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// The ShimClient plays the broker: it checks what the client writes and
+// answers with MQTT 5 packets as a broker would.
+
+IPAddress server(172, 16, 0, 2);
+
+bool callback_called = false;
+String lastTopic;
+String lastPayload;
+
+void callback(const MQTT::Publish& pub) {
+    callback_called = true;
+    lastTopic = pub.topic();
+    lastPayload = pub.payload_string();
+}
+
+// Topic alias maximum 10, receive maximum 20
+byte connack5[] = { 0x20,0x9,0x0,0x0,0x6,0x22,0x0,0xa,0x21,0x0,0x14 };
+
+// 77 bytes, about as long as a device status topic
+const char long_topic[] = "/0123456789abcdef0123456789abcdef/0123456789abcdef0123456789abcdef0123/status";
+
+int test_mqtt5_connect_properly_formatted() {
+    IT("sends an MQTT 5 connect with session expiry and receive maximum");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connect[] = { 0x10,		// type and flags
+		       0x21,		// length
+		       0x0,0x4,0x4d,0x51,0x54,0x54,	// protocol name
+		       0x5,		// protocol level
+		       0x2,		// flags
+		       0x0,0xf,		// keepalive
+		       0x8,		// properties length
+		       0x11,0x0,0x0,0xe,0x10,	// session expiry 3600
+		       0x21,0x0,0x5,	// receive maximum 5
+		       0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31 // client id
+    };
+    byte connack[] = { 0x20,0xc,0x0,0x0,0x9,0x22,0x0,0x20,0x21,0x0,0x14,0x13,0x0,0x1e };
+
+    shimClient.expect(connect,35);
+    shimClient.respond(connack,14);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5).set_session_expiry(3600).set_receive_maximum(5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+    IS_FALSE(shimClient.error());
+
+    IS_EQUAL(client.protocol(), MQTT::MQTT5);
+    IS_EQUAL(client.receive_maximum(), 20);
+    IS_EQUAL(client.topic_alias_maximum(), MQTT_TOPIC_ALIASES);
+
+    END_IT
+}
+
+int test_mqtt5_connect_fails_on_reason_code() {
+    IT("fails to connect when the broker answers with a failure reason code");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20,0x3,0x0,0x87,0x0 };	// not authorized
+    shimClient.respond(connack,5);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_FALSE(rc);
+    IS_FALSE(client.connected());
+
+    END_IT
+}
+
+int test_mqtt5_publish_topic_alias() {
+    IT("sends the topic once, then only its alias");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    byte first[] = { 0x30,0xd,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x3,0x23,0x0,0x1,0x68,0x69 };
+    byte second[] = { 0x30,0x8,0x0,0x0,0x3,0x23,0x0,0x1,0x68,0x69 };
+    shimClient.expect(first,15);
+    shimClient.expect(second,10);
+
+    rc = client.publish((char*)"topic",(char*)"hi");
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"hi");
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_mqtt5_publish_topic_pointer_alias() {
+    IT("publishes to a topic pointer by alias");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    const char topic[] = "topicXX";	// not null-terminated after 5 bytes
+    byte payload[] = { 0x68,0x69 };
+
+    byte first[] = { 0x30,0xd,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x3,0x23,0x0,0x1,0x68,0x69 };
+    byte second[] = { 0x31,0x8,0x0,0x0,0x3,0x23,0x0,0x1,0x68,0x69 };
+    shimClient.expect(first,15);
+    shimClient.expect(second,10);
+
+    rc = client.publish(topic, 5, payload, 2);
+    IS_TRUE(rc);
+    rc = client.publish(topic, 5, payload, 2, true);
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_mqtt5_publish_overhead() {
+    IT("halves the bytes of a repeated publish to a long topic");
+    byte payload[] = "{\"temp\":21.5,\"rh\":40}";	// 21 bytes
+    size_t length = 21;
+
+    ShimClient shim311;
+    shim311.setAllowConnect(true);
+    byte connack[] = { 0x20,0x2,0x0,0x0 };
+    shim311.respond(connack,4);
+    PubSubClient client311(shim311, server, 1883);
+    IS_TRUE(client311.connect("client_test1"));
+    size_t before = shim311.received();
+    client311.publish(long_topic, strlen(long_topic), payload, length);
+    client311.publish(long_topic, strlen(long_topic), payload, length);
+    size_t bytes311 = (shim311.received() - before) / 2;
+
+    ShimClient shim5;
+    shim5.setAllowConnect(true);
+    shim5.respond(connack5,11);
+    PubSubClient client5(shim5, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    IS_TRUE(client5.connect(conn));
+    client5.publish(long_topic, strlen(long_topic), payload, length);
+    before = shim5.received();
+    client5.publish(long_topic, strlen(long_topic), payload, length);
+    size_t bytes5 = shim5.received() - before;
+
+    TRACE("MQTT 3.1.1: " << bytes311 << " bytes, MQTT 5 by alias: " << bytes5 << " bytes\n");
+    IS_EQUAL(bytes311, 2 + 2 + strlen(long_topic) + length);
+    IS_EQUAL(bytes5, 2 + 2 + 4 + length);
+    IS_TRUE(bytes5 * 2 <= bytes311);
+
+    END_IT
+}
+
+int test_mqtt5_publish_alias_maximum() {
+    IT("sends topics in full once the broker's aliases are used up");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20,0x6,0x0,0x0,0x3,0x22,0x0,0x1 };	// topic alias maximum 1
+    shimClient.respond(connack,8);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+    IS_EQUAL(client.topic_alias_maximum(), 1);
+
+    byte first[] = { 0x30,0xd,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x3,0x23,0x0,0x1,0x68,0x69 };
+    byte other[] = { 0x30,0xa,0x0,0x5,0x6f,0x74,0x68,0x65,0x72,0x0,0x68,0x69 };
+    shimClient.expect(first,15);
+    shimClient.expect(other,12);
+
+    rc = client.publish((char*)"topic",(char*)"hi");
+    IS_TRUE(rc);
+    rc = client.publish((char*)"other",(char*)"hi");
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_mqtt5_publish_qos1_reason_code() {
+    IT("fails a qos 1 publish the broker rejects with a reason code");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    byte puback[] = { 0x40,0x3,0x0,0x2,0x97 };	// quota exceeded
+    shimClient.respond(puback,5);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    MQTT::Publish pub("topic", "hi");
+    pub.set_qos(1);
+    rc = client.publish(pub);
+    IS_FALSE(rc);
+
+    END_IT
+}
+
+int test_mqtt5_receive_publish_with_properties() {
+    IT("receives a publish that carries properties");
+    callback_called = false;
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    // payload format indicator and message expiry
+    byte publish[] = { 0x30,0x11,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x7,0x1,0x1,0x2,0x0,0x0,0x0,0x3c,0x68 };
+    byte payload[] = { 0x69 };
+    shimClient.respond(publish,18);
+    shimClient.respond(payload,1);
+
+    PubSubClient client(shimClient, server, 1883);
+    client.set_callback(callback);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    IS_TRUE(lastTopic == "topic");
+    IS_TRUE(lastPayload == "hi");
+
+    END_IT
+}
+
+int test_mqtt5_subscribe() {
+    IT("subscribes with empty properties and accepts a suback with properties");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    byte subscribe[] = { 0x82,0xb,0x0,0x2,0x0,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x1 };
+    shimClient.expect(subscribe,13);
+    byte suback[] = { 0x90,0x4,0x0,0x2,0x0,0x1 };
+    shimClient.respond(suback,6);
+
+    rc = client.subscribe((char*)"topic", 1);
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_mqtt5_broker_disconnect() {
+    IT("closes the connection when the broker disconnects with a reason code");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+    shimClient.respond(connack5,11);
+
+    byte disconnect[] = { 0xe0,0x1,0x8b };	// server shutting down
+    shimClient.respond(disconnect,3);
+
+    PubSubClient client(shimClient, server, 1883);
+    MQTT::Connect conn("client_test1");
+    conn.set_protocol(MQTT::MQTT5);
+    int rc = client.connect(conn);
+    IS_TRUE(rc);
+
+    client.loop();
+    IS_FALSE(client.connected());
+    IS_EQUAL(client.disconnect_reason(), 0x8b);
+
+    END_IT
+}
+
+int main()
+{
+    test_mqtt5_connect_properly_formatted();
+    test_mqtt5_connect_fails_on_reason_code();
+    test_mqtt5_publish_topic_alias();
+    test_mqtt5_publish_topic_pointer_alias();
+    test_mqtt5_publish_overhead();
+    test_mqtt5_publish_alias_maximum();
+    test_mqtt5_publish_qos1_reason_code();
+    test_mqtt5_receive_publish_with_properties();
+    test_mqtt5_subscribe();
+    test_mqtt5_broker_disconnect();
+
+    FINISH
+}
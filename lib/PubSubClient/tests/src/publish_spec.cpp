@@ -4,6 +4,27 @@
 #include "BDDTest.h"
 #include "trace.h"
 
+#include <new>
+#include <stdlib.h>
+
+// Counts heap allocations, to check that publishing by topic pointer needs none
+static int allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
 
 IPAddress server(172, 16, 0, 2);
 
@@ -124,7 +145,7 @@ int test_publish_P() {
     byte publish[] = {0x31,0xc,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x1,0x2,0x3,0x0,0x5};
     shimClient.expect(publish,14);
     
-    rc = client.publish_P((char*)"topic",payload,length,true);
+    rc = client.publish_P((char*)"topic",(PGM_P)payload,length,true);
     IS_TRUE(rc);
     
     IS_FALSE(shimClient.error());
@@ -133,6 +154,77 @@ int test_publish_P() {
 }
 
 
+int test_publish_topic_pointer() {
+    IT("publishes to a topic pointer without allocating");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte payload[] = { 0x01,0x02,0x03,0x0,0x05 };
+    int length = 5;
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient, server, 1883);
+    int rc = client.connect("client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x31,0xc,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x1,0x2,0x3,0x0,0x5};
+    shimClient.expect(publish,14);
+
+    const char topics[] = "topic/other"; // not terminated after "topic"
+    int before = allocations;
+    rc = client.publish(topics,5,payload,length,true);
+    IS_TRUE(rc);
+    IS_EQUAL(allocations, before);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_topic_pointer_large() {
+    IT("publishes a payload larger than the stack buffer to a topic pointer");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte payload[200];
+    for (int i = 0; i < 200; i++) payload[i] = i;
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient, server, 1883);
+    int rc = client.connect("client_test1");
+    IS_TRUE(rc);
+
+    byte publish[3 + 2 + 5 + 200] = {0x30,0xcf,0x1,0x0,0x5,0x74,0x6f,0x70,0x69,0x63};
+    memcpy(publish + 10, payload, 200);
+    shimClient.expect(publish,sizeof(publish));
+
+    int before = allocations;
+    rc = client.publish("topic",5,payload,200);
+    IS_TRUE(rc);
+    IS_EQUAL(allocations, before);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_topic_pointer_not_connected() {
+    IT("publish to a topic pointer fails when not connected");
+    ShimClient shimClient;
+
+    PubSubClient client(shimClient, server, 1883);
+
+    byte payload[] = { 0x01 };
+    int rc = client.publish("topic",5,payload,1);
+    IS_FALSE(rc);
+
+    END_IT
+}
+
 int main()
 {
     test_publish();
@@ -140,6 +232,9 @@ int main()
     test_publish_retained();
     test_publish_not_connected();
     test_publish_P();
+    test_publish_topic_pointer();
+    test_publish_topic_pointer_large();
+    test_publish_topic_pointer_not_connected();
     
     FINISH
 }
@@ -129,6 +129,55 @@ int test_unsubscribe() {
     END_IT
 }
 
+int test_subscribe_nonblocking() {
+    IT("subscribes without waiting for the SUBACK");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient,server, 1883);
+    client.set_callback(callback);
+    int rc = client.connect("client_test1");
+    IS_TRUE(rc);
+
+    byte subscribe[] = { 0x82,0xa,0x0,0x2,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x1 };
+    shimClient.expect(subscribe,12);
+    IS_TRUE(client.subscribe_start("topic", 1));
+
+    // broker has not answered yet
+    IS_EQUAL(client.subscribe_poll(), PubSubClient::SUBSCRIBE_PENDING);
+
+    byte suback[] = { 0x90,0x3,0x0,0x2,0x1 };
+    shimClient.respond(suback,5);
+    IS_EQUAL(client.subscribe_poll(), PubSubClient::SUBSCRIBE_DONE);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_subscribe_nonblocking_connection_lost() {
+    IT("fails a non-blocking subscribe when the connection is lost");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient,server, 1883);
+    int rc = client.connect("client_test1");
+    IS_TRUE(rc);
+
+    IS_TRUE(client.subscribe_start("topic"));
+    shimClient.setConnected(false);
+    IS_EQUAL(client.subscribe_poll(), PubSubClient::SUBSCRIBE_FAILED);
+    IS_FALSE(client.subscribe_start("topic"));
+
+    END_IT
+}
+
 int test_unsubscribe_not_connected() {
     IT("unsubscribe fails when not connected");
     ShimClient shimClient;
@@ -152,5 +201,7 @@ int main()
     test_subscribe_invalid_qos();
     test_unsubscribe();
     test_unsubscribe_not_connected();
+    test_subscribe_nonblocking();
+    test_subscribe_nonblocking_connection_lost();
     FINISH
 }
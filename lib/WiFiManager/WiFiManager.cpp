@@ -11,6 +11,7 @@
  **************************************************************/
 
 #include "WiFiManager.h"
+#include "WiFiManagerAssets.h"
 
 WiFiManagerParameter::WiFiManagerParameter(const char *custom) {
   _id = NULL;
@@ -66,6 +67,73 @@ const char* WiFiManagerParameter::getCustomHTML() {
   return _customHTML;
 }
 
+WiFiManagerPage::WiFiManagerPage(ESP8266WebServer &server, int code) : _server(server) {
+  _buffer.reserve(WIFI_MANAGER_CHUNK_SIZE);
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN); // chunked for HTTP/1.1, connection close otherwise
+  _server.send(code, "text/html", "");
+}
+
+WiFiManagerPage::~WiFiManagerPage() {
+  flush();
+  _server.sendContent(""); // last chunk
+}
+
+void WiFiManagerPage::write(char c) {
+  if (_buffer.length() >= WIFI_MANAGER_CHUNK_SIZE) {
+    flush();
+  }
+  _buffer += c;
+}
+
+void WiFiManagerPage::flush() {
+  if (_buffer.length() > 0) {
+    _server.sendContent(_buffer);
+    _buffer = ""; // keeps reserved capacity
+  }
+}
+
+void WiFiManagerPage::print(const char *text) {
+  while (*text) {
+    write(*text++);
+  }
+}
+
+void WiFiManagerPage::print(const String &text) {
+  print(text.c_str());
+}
+
+void WiFiManagerPage::print(const __FlashStringHelper *text) {
+  print_P((PGM_P) text);
+}
+
+void WiFiManagerPage::print(unsigned long value) {
+  char digits[11];
+  print(ultoa(value, digits, 10));
+}
+
+void WiFiManagerPage::print_P(PGM_P text) {
+  char c;
+  while ((c = pgm_read_byte(text++)) != 0) {
+    write(c);
+  }
+}
+
+void WiFiManagerPage::printTemplate_P(PGM_P text, const char *keys, const char *const *values) {
+  char c;
+  while ((c = pgm_read_byte(text++)) != 0) {
+    if (c == '{') {
+      char key = pgm_read_byte(text);
+      const char *found = key ? strchr(keys, key) : NULL;
+      if (found && (pgm_read_byte(text + 1) == '}')) {
+        print(values[found - keys]);
+        text += 2;
+        continue;
+      }
+    }
+    write(c);
+  }
+}
+
 
 WiFiManager::WiFiManager() {
     _max_params = WIFI_MANAGER_MAX_PARAMS;
@@ -79,6 +147,7 @@ WiFiManager::~WiFiManager()
         DEBUG_WM(F("freeing allocated params!"));
         free(_params);
     }
+    delete[] _networks;
 }
 
 bool WiFiManager::addParameter(WiFiManagerParameter *p) {
@@ -151,10 +220,92 @@ void WiFiManager::setupConfigPortal() {
   server->on(String(F("/r")), std::bind(&WiFiManager::handleReset, this));
   //server->on("/generate_204", std::bind(&WiFiManager::handle204, this));  //Android/Chrome OS captive portal check.
   server->on(String(F("/fwlink")), std::bind(&WiFiManager::handleRoot, this));  //Microsoft captive portal. Maybe not needed. Might be handled by notFound handler.
+  server->on(String(FPSTR(HTTP_STYLE_PATH)), std::bind(&WiFiManager::handleAsset, this, HTTP_STYLE_TYPE, HTTP_STYLE_GZ, sizeof(HTTP_STYLE_GZ), HTTP_STYLE_ETAG));
+  server->on(String(FPSTR(HTTP_SCRIPT_PATH)), std::bind(&WiFiManager::handleAsset, this, HTTP_SCRIPT_TYPE, HTTP_SCRIPT_GZ, sizeof(HTTP_SCRIPT_GZ), HTTP_SCRIPT_ETAG));
   server->onNotFound (std::bind(&WiFiManager::handleNotFound, this));
+  const char *headers[] = { "If-None-Match" };
+  server->collectHeaders(headers, 1); // for revalidation of assets
   server->begin(); // Web server start
   DEBUG_WM(F("HTTP server started"));
 
+  startScan(); // results are ready by the time /wifi is opened
+
+}
+
+/** Starts an asynchronous scan unless one is running */
+void WiFiManager::startScan() {
+  if (WiFi.scanComplete() != WIFI_SCAN_RUNNING) {
+    DEBUG_WM(F("Starting background scan"));
+    WiFi.scanNetworks(true);
+  }
+}
+
+static uint32_t ssidHash(const char *ssid) {
+  uint32_t hash = 2166136261UL; // FNV-1a
+  while (*ssid) {
+    hash = (hash ^ (uint8_t) *ssid++) * 16777619UL;
+  }
+  return hash;
+}
+
+/** Copies a finished scan into the cache, returns true if the cache was updated */
+boolean WiFiManager::updateScan() {
+  int n = WiFi.scanComplete();
+  if (n < 0) {
+    return false; // running or not started
+  }
+  if (_networks == NULL) {
+    _networks = new WiFiManagerNetwork[WIFI_MANAGER_MAX_NETWORKS];
+  }
+
+  // keeps the strongest networks when more are in range than fit
+  _networkCount = 0;
+  for (int i = 0; i < n; i++) {
+    WiFiManagerNetwork found;
+    strlcpy(found.ssid, WiFi.SSID(i).c_str(), sizeof(found.ssid));
+    found.hash = ssidHash(found.ssid);
+    found.rssi = WiFi.RSSI(i);
+    found.secure = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+
+    int slot = -1;
+    if (_removeDuplicateAPs) {
+      // duplicates keep the strongest one
+      for (int j = 0; j < _networkCount && slot < 0; j++) {
+        if ((_networks[j].hash == found.hash) && (strcmp(_networks[j].ssid, found.ssid) == 0)) {
+          slot = j;
+        }
+      }
+      if (slot >= 0) {
+        DEBUG_WM(String(F("DUP AP: ")) + found.ssid);
+      }
+    }
+    if (slot < 0) {
+      if (_networkCount < WIFI_MANAGER_MAX_NETWORKS) {
+        slot = _networkCount++;
+        _networks[slot].rssi = INT32_MIN;
+      } else {
+        slot = 0; // replaces the weakest
+        for (int j = 1; j < _networkCount; j++) {
+          if (_networks[j].rssi < _networks[slot].rssi) {
+            slot = j;
+          }
+        }
+      }
+    }
+    if (found.rssi > _networks[slot].rssi) {
+      _networks[slot] = found;
+    }
+  }
+  WiFi.scanDelete();
+
+  std::sort(_networks, _networks + _networkCount, [](const WiFiManagerNetwork &a, const WiFiManagerNetwork &b) {
+    return a.rssi > b.rssi;
+  });
+
+  _scanTime = millis();
+  DEBUG_WM(F("Scan done"));
+  DEBUG_WM(_networkCount);
+  return true;
 }
 
 boolean WiFiManager::autoConnect() {
@@ -173,6 +324,19 @@ boolean WiFiManager::autoConnect(char const *apName, char const *apPassword) {
   // attempt to connect; should it fail, fall back to AP
   WiFi.mode(WIFI_STA);
 
+  if (!_configPortalBlocking) {
+    _apName = apName;
+    _apPassword = apPassword;
+    if (!beginConnect("", "")) {
+      return true;
+    }
+    if (!WiFi.SSID().length()) {
+      return startConfigPortal(apName, apPassword); // nothing to wait for
+    }
+    _connectBegin = millis(); // process() opens the portal if saved credentials fail
+    return false;
+  }
+
   if (connectWifi("", "") == WL_CONNECTED)   {
     DEBUG_WM(F("IP Address:"));
     DEBUG_WM(WiFi.localIP());
@@ -210,59 +374,158 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
   }
 
   connect = false;
+  _connectRequest = 0;
+  _connectBegin = 0;
   setupConfigPortal();
+  _configPortalActive = true;
+
+  if (!_configPortalBlocking) {
+    return false;
+  }
+
+  while (!processConfigPortal()) {
+    yield();
+  }
 
-  while(1){
+  return  WiFi.status() == WL_CONNECTED;
+}
 
-    // check if timeout
-    if(configPortalHasTimeout()) break;
+boolean WiFiManager::processConfigPortal() {
+  // check if timeout
+  if (configPortalHasTimeout()) {
+    stopConfigPortal();
+    return true;
+  }
 
-    //DNS
-    dnsServer->processNextRequest();
-    //HTTP
-    server->handleClient();
+  //DNS
+  dnsServer->processNextRequest();
+  //HTTP
+  server->handleClient();
+  //Scan
+  updateScan();
 
+  if (connect) {
+    connect = false;
+    _connectRequest = millis();
+    _connectBegin = 0;
+  }
 
-    if (connect) {
-      connect = false;
-      delay(2000);
-      DEBUG_WM(F("Connecting to new AP"));
+  if (_connectRequest == 0) {
+    return false;
+  }
 
-      // using user-provided  _ssid, _pass in place of system-stored ssid and pass
-      if (connectWifi(_ssid, _pass) != WL_CONNECTED) {
-        DEBUG_WM(F("Failed to connect."));
-      } else {
-        //connected
-        WiFi.mode(WIFI_STA);
-        //notify that configuration has changed and any optional parameters should be saved
-        if ( _savecallback != NULL) {
-          //todo: check if any custom parameters actually exist, and check if they really changed maybe
-          _savecallback();
-        }
-        break;
-      }
+  if (_connectBegin == 0) {
+    if (millis() - _connectRequest < 2000) {
+      return false; // lets the saved page reach the browser first
+    }
+    DEBUG_WM(F("Connecting to new AP"));
+    // using user-provided  _ssid, _pass in place of system-stored ssid and pass
+    beginConnect(_ssid, _pass);
+    _connectBegin = millis();
+    return false;
+  }
 
-      if (_shouldBreakAfterConfig) {
-        //flag set to exit after config after trying to connect
-        //notify that configuration has changed and any optional parameters should be saved
-        if ( _savecallback != NULL) {
-          //todo: check if any custom parameters actually exist, and check if they really changed maybe
-          _savecallback();
-        }
-        break;
-      }
+  if (WiFi.status() == WL_CONNECTED) {
+    //connected
+    WiFi.mode(WIFI_STA);
+    //notify that configuration has changed and any optional parameters should be saved
+    if ( _savecallback != NULL) {
+      //todo: check if any custom parameters actually exist, and check if they really changed maybe
+      _savecallback();
     }
-    yield();
+    stopConfigPortal();
+    return true;
+  }
+
+  if (millis() - _connectBegin < connectTimeout()) {
+    return false;
+  }
+
+  _connectRequest = 0;
+  _connectBegin = 0;
+  DEBUG_WM(F("Failed to connect."));
+
+  if (_shouldBreakAfterConfig) {
+    //flag set to exit after config after trying to connect
+    //notify that configuration has changed and any optional parameters should be saved
+    if ( _savecallback != NULL) {
+      //todo: check if any custom parameters actually exist, and check if they really changed maybe
+      _savecallback();
+    }
+    stopConfigPortal();
+    return true;
   }
+  return false;
+}
 
+void WiFiManager::stopConfigPortal() {
   server.reset();
   dnsServer.reset();
+  _configPortalActive = false;
+  _connectRequest = 0;
+  _connectBegin = 0;
+}
+
+boolean WiFiManager::process() {
+  unsigned long start = micros();
+
+  if (_configPortalActive) {
+    processConfigPortal();
+  } else if (_connectBegin != 0) {
+    // autoConnect() with saved credentials
+    if (WiFi.status() == WL_CONNECTED) {
+      _connectBegin = 0;
+      DEBUG_WM(F("IP Address:"));
+      DEBUG_WM(WiFi.localIP());
+    } else if (millis() - _connectBegin >= connectTimeout()) {
+      _connectBegin = 0;
+      startConfigPortal(_apName, _apPassword);
+    }
+  }
 
-  return  WiFi.status() == WL_CONNECTED;
+  unsigned long elapsed = micros() - start;
+  if (elapsed > _processMaxMicros) {
+    _processMaxMicros = elapsed;
+  }
+  return !_configPortalActive && (_connectBegin == 0);
+}
+
+boolean WiFiManager::getConfigPortalActive() {
+  return _configPortalActive;
+}
+
+unsigned long WiFiManager::getProcessMaxMicros() {
+  return _processMaxMicros;
+}
+
+void WiFiManager::setConfigPortalBlocking(boolean shouldBlock) {
+  _configPortalBlocking = shouldBlock;
+}
+
+unsigned long WiFiManager::connectTimeout() {
+  return _connectTimeout ? _connectTimeout : WIFI_MANAGER_CONNECT_TIMEOUT;
 }
 
 
 int WiFiManager::connectWifi(String ssid, String pass) {
+  if (!beginConnect(ssid, pass)) {
+    return WL_CONNECTED;
+  }
+
+  int connRes = waitForConnectResult();
+  DEBUG_WM ("Connection result: ");
+  DEBUG_WM ( connRes );
+  //not connected, WPS enabled, no pass - first attempt
+  if (_tryWPS && connRes != WL_CONNECTED && pass == "") {
+    startWPS();
+    //should be connected at the end of WPS
+    connRes = waitForConnectResult();
+  }
+  return connRes;
+}
+
+/** Starts connecting as wifi client (last saved credentials if ssid is empty), false if already connected */
+boolean WiFiManager::beginConnect(String ssid, String pass) {
   DEBUG_WM(F("Connecting as wifi client..."));
 
   // check if we've got static_ip settings, if we do, use those.
@@ -274,7 +537,7 @@ int WiFiManager::connectWifi(String ssid, String pass) {
   //fix for auto connect racing issue
   if (WiFi.status() == WL_CONNECTED) {
     DEBUG_WM(F("Already connected. Bailing out."));
-    return WL_CONNECTED;
+    return false;
   }
   //check if we have ssid and pass and force those, if not, try with last saved values
   if (ssid != "") {
@@ -292,17 +555,7 @@ int WiFiManager::connectWifi(String ssid, String pass) {
       DEBUG_WM(F("No saved credentials"));
     }
   }
-
-  int connRes = waitForConnectResult();
-  DEBUG_WM ("Connection result: ");
-  DEBUG_WM ( connRes );
-  //not connected, WPS enabled, no pass - first attempt
-  if (_tryWPS && connRes != WL_CONNECTED && pass == "") {
-    startWPS();
-    //should be connected at the end of WPS
-    connRes = waitForConnectResult();
-  }
-  return connRes;
+  return true;
 }
 
 uint8_t WiFiManager::waitForConnectResult() {
@@ -400,6 +653,19 @@ void WiFiManager::setBreakAfterConfig(boolean shouldBreak) {
   _shouldBreakAfterConfig = shouldBreak;
 }
 
+void WiFiManager::printHead(WiFiManagerPage &page, const char *title) {
+  const char *values[] = { title };
+  page.printTemplate_P(HTTP_HEAD, "v", values);
+  page.print_P(HTTP_ASSETS); // links to gzipped, cacheable style and script
+  page.print(_customHeadElement);
+  page.print_P(HTTP_HEAD_END);
+}
+
+void WiFiManager::printParam(WiFiManagerPage &page, const char *id, const char *placeholder, const char *length, const char *value, const char *custom) {
+  const char *values[] = { id, id, placeholder, length, value, custom };
+  page.printTemplate_P(HTTP_FORM_PARAM, "inplvc", values);
+}
+
 /** Handle root or redirect to captive portal */
 void WiFiManager::handleRoot() {
   DEBUG_WM(F("Handle root"));
@@ -407,110 +673,53 @@ void WiFiManager::handleRoot() {
     return;
   }
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Options");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += String(F("<h1>"));
-  page += _apName;
-  page += String(F("</h1>"));
-  page += String(F("<h3>WiFiManager</h3>"));
-  page += FPSTR(HTTP_PORTAL_OPTIONS);
-  page += FPSTR(HTTP_END);
-
-  server->sendHeader("Content-Length", String(page.length()));
-  server->send(200, "text/html", page);
+  WiFiManagerPage page(*server);
+  printHead(page, "Options");
+  page.print(F("<h1>"));
+  page.print(_apName);
+  page.print(F("</h1>"));
+  page.print(F("<h3>WiFiManager</h3>"));
+  page.print_P(HTTP_PORTAL_OPTIONS);
+  page.print_P(HTTP_END);
 
 }
 
 /** Wifi config page handler */
 void WiFiManager::handleWifi(boolean scan) {
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Config ESP");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
+  WiFiManagerPage page(*server);
+  printHead(page, "Config ESP");
 
   if (scan) {
-    int n = WiFi.scanNetworks();
-    DEBUG_WM(F("Scan done"));
-    if (n == 0) {
+    updateScan();
+    if (_scanTime == 0 || millis() - _scanTime > WIFI_MANAGER_SCAN_MAX_AGE) {
+      startScan(); // cached results are served meanwhile
+    }
+    if (_scanTime == 0) {
+      page.print(F("Scanning networks. Refresh in a few seconds."));
+    } else if (_networkCount == 0) {
       DEBUG_WM(F("No networks found"));
-      page += F("No networks found. Refresh to scan again.");
+      page.print(F("No networks found. Refresh to scan again."));
     } else {
-
-      //sort networks
-      int indices[n];
-      for (int i = 0; i < n; i++) {
-        indices[i] = i;
-      }
-
-      // RSSI SORT
-
-      // old sort
-      for (int i = 0; i < n; i++) {
-        for (int j = i + 1; j < n; j++) {
-          if (WiFi.RSSI(indices[j]) > WiFi.RSSI(indices[i])) {
-            std::swap(indices[i], indices[j]);
-          }
-        }
-      }
-
-      /*std::sort(indices, indices + n, [](const int & a, const int & b) -> bool
-        {
-        return WiFi.RSSI(a) > WiFi.RSSI(b);
-        });*/
-
-      // remove duplicates ( must be RSSI sorted )
-      if (_removeDuplicateAPs) {
-        String cssid;
-        for (int i = 0; i < n; i++) {
-          if (indices[i] == -1) continue;
-          cssid = WiFi.SSID(indices[i]);
-          for (int j = i + 1; j < n; j++) {
-            if (cssid == WiFi.SSID(indices[j])) {
-              DEBUG_WM("DUP AP: " + WiFi.SSID(indices[j]));
-              indices[j] = -1; // set dup aps to index -1
-            }
-          }
-        }
-      }
-
       //display networks in page
-      for (int i = 0; i < n; i++) {
-        if (indices[i] == -1) continue; // skip dups
-        DEBUG_WM(WiFi.SSID(indices[i]));
-        DEBUG_WM(WiFi.RSSI(indices[i]));
-        int quality = getRSSIasQuality(WiFi.RSSI(indices[i]));
+      char rssiQ[5];
+      for (int i = 0; i < _networkCount; i++) {
+        int quality = getRSSIasQuality(_networks[i].rssi);
 
         if (_minimumQuality == -1 || _minimumQuality < quality) {
-          String item = FPSTR(HTTP_ITEM);
-          String rssiQ;
-          rssiQ += quality;
-          item.replace("{v}", WiFi.SSID(indices[i]));
-          item.replace("{r}", rssiQ);
-          if (WiFi.encryptionType(indices[i]) != ENC_TYPE_NONE) {
-            item.replace("{i}", "l");
-          } else {
-            item.replace("{i}", "");
-          }
-          //DEBUG_WM(item);
-          page += item;
-          delay(0);
+          snprintf(rssiQ, sizeof(rssiQ), "%d", quality);
+          const char *values[] = { _networks[i].ssid, rssiQ, _networks[i].secure ? "l" : "" };
+          page.printTemplate_P(HTTP_ITEM, "vri", values);
         } else {
           DEBUG_WM(F("Skipping due to quality"));
         }
 
       }
-      page += "<br/>";
+      page.print("<br/>");
     }
   }
 
-  page += FPSTR(HTTP_FORM_START);
+  page.print_P(HTTP_FORM_START);
   char parLength[5];
   // add the extra parameters to the form
   for (int i = 0; i < _paramsCount; i++) {
@@ -518,65 +727,28 @@ void WiFiManager::handleWifi(boolean scan) {
       break;
     }
 
-    String pitem = FPSTR(HTTP_FORM_PARAM);
     if (_params[i]->getID() != NULL) {
-      pitem.replace("{i}", _params[i]->getID());
-      pitem.replace("{n}", _params[i]->getID());
-      pitem.replace("{p}", _params[i]->getPlaceholder());
       snprintf(parLength, 5, "%d", _params[i]->getValueLength());
-      pitem.replace("{l}", parLength);
-      pitem.replace("{v}", _params[i]->getValue());
-      pitem.replace("{c}", _params[i]->getCustomHTML());
+      printParam(page, _params[i]->getID(), _params[i]->getPlaceholder(), parLength, _params[i]->getValue(), _params[i]->getCustomHTML());
     } else {
-      pitem = _params[i]->getCustomHTML();
+      page.print(_params[i]->getCustomHTML());
     }
-
-    page += pitem;
   }
   if (_params[0] != NULL) {
-    page += "<br/>";
+    page.print("<br/>");
   }
 
   if (_sta_static_ip) {
-
-    String item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "ip");
-    item.replace("{n}", "ip");
-    item.replace("{p}", "Static IP");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_ip.toString());
-
-    page += item;
-
-    item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "gw");
-    item.replace("{n}", "gw");
-    item.replace("{p}", "Static Gateway");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_gw.toString());
-
-    page += item;
-
-    item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "sn");
-    item.replace("{n}", "sn");
-    item.replace("{p}", "Subnet");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_sn.toString());
-
-    page += item;
-
-    page += "<br/>";
+    printParam(page, "ip", "Static IP", "15", _sta_static_ip.toString().c_str(), "");
+    printParam(page, "gw", "Static Gateway", "15", _sta_static_gw.toString().c_str(), "");
+    printParam(page, "sn", "Subnet", "15", _sta_static_sn.toString().c_str(), "");
+    page.print("<br/>");
   }
 
-  page += FPSTR(HTTP_FORM_END);
-  page += FPSTR(HTTP_SCAN_LINK);
-
-  page += FPSTR(HTTP_END);
-
-  server->sendHeader("Content-Length", String(page.length()));
-  server->send(200, "text/html", page);
+  page.print_P(HTTP_FORM_END);
+  page.print_P(HTTP_SCAN_LINK);
 
+  page.print_P(HTTP_END);
 
   DEBUG_WM(F("Sent config page"));
 }
@@ -623,17 +795,12 @@ void WiFiManager::handleWifiSave() {
     optionalIPFromString(&_sta_static_sn, sn.c_str());
   }
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Credentials Saved");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += FPSTR(HTTP_SAVED);
-  page += FPSTR(HTTP_END);
-
-  server->sendHeader("Content-Length", String(page.length()));
-  server->send(200, "text/html", page);
+  {
+    WiFiManagerPage page(*server);
+    printHead(page, "Credentials Saved");
+    page.print_P(HTTP_SAVED);
+    page.print_P(HTTP_END);
+  }
 
   DEBUG_WM(F("Sent wifi save page"));
 
@@ -644,39 +811,32 @@ void WiFiManager::handleWifiSave() {
 void WiFiManager::handleInfo() {
   DEBUG_WM(F("Info"));
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Info");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("<dl>");
-  page += F("<dt>Chip ID</dt><dd>");
-  page += ESP.getChipId();
-  page += F("</dd>");
-  page += F("<dt>Flash Chip ID</dt><dd>");
-  page += ESP.getFlashChipId();
-  page += F("</dd>");
-  page += F("<dt>IDE Flash Size</dt><dd>");
-  page += ESP.getFlashChipSize();
-  page += F(" bytes</dd>");
-  page += F("<dt>Real Flash Size</dt><dd>");
-  page += ESP.getFlashChipRealSize();
-  page += F(" bytes</dd>");
-  page += F("<dt>Soft AP IP</dt><dd>");
-  page += WiFi.softAPIP().toString();
-  page += F("</dd>");
-  page += F("<dt>Soft AP MAC</dt><dd>");
-  page += WiFi.softAPmacAddress();
-  page += F("</dd>");
-  page += F("<dt>Station MAC</dt><dd>");
-  page += WiFi.macAddress();
-  page += F("</dd>");
-  page += F("</dl>");
-  page += FPSTR(HTTP_END);
-
-  server->sendHeader("Content-Length", String(page.length()));
-  server->send(200, "text/html", page);
+  WiFiManagerPage page(*server);
+  printHead(page, "Info");
+  page.print(F("<dl>"));
+  page.print(F("<dt>Chip ID</dt><dd>"));
+  page.print(ESP.getChipId());
+  page.print(F("</dd>"));
+  page.print(F("<dt>Flash Chip ID</dt><dd>"));
+  page.print(ESP.getFlashChipId());
+  page.print(F("</dd>"));
+  page.print(F("<dt>IDE Flash Size</dt><dd>"));
+  page.print(ESP.getFlashChipSize());
+  page.print(F(" bytes</dd>"));
+  page.print(F("<dt>Real Flash Size</dt><dd>"));
+  page.print(ESP.getFlashChipRealSize());
+  page.print(F(" bytes</dd>"));
+  page.print(F("<dt>Soft AP IP</dt><dd>"));
+  page.print(WiFi.softAPIP().toString());
+  page.print(F("</dd>"));
+  page.print(F("<dt>Soft AP MAC</dt><dd>"));
+  page.print(WiFi.softAPmacAddress());
+  page.print(F("</dd>"));
+  page.print(F("<dt>Station MAC</dt><dd>"));
+  page.print(WiFi.macAddress());
+  page.print(F("</dd>"));
+  page.print(F("</dl>"));
+  page.print_P(HTTP_END);
 
   DEBUG_WM(F("Sent info page"));
 }
@@ -685,17 +845,12 @@ void WiFiManager::handleInfo() {
 void WiFiManager::handleReset() {
   DEBUG_WM(F("Reset"));
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Info");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("Module will reset in a few seconds.");
-  page += FPSTR(HTTP_END);
-
-  server->sendHeader("Content-Length", String(page.length()));
-  server->send(200, "text/html", page);
+  {
+    WiFiManagerPage page(*server);
+    printHead(page, "Info");
+    page.print(F("Module will reset in a few seconds."));
+    page.print_P(HTTP_END);
+  }
 
   DEBUG_WM(F("Sent reset page"));
   delay(5000);
@@ -703,6 +858,19 @@ void WiFiManager::handleReset() {
   delay(2000);
 }
 
+/** Serves a gzipped asset from PROGMEM, or 304 when the browser has this version */
+void WiFiManager::handleAsset(PGM_P type, const uint8_t *gz, size_t length, PGM_P etag) {
+  String tag = FPSTR(etag);
+  server->sendHeader(F("ETag"), tag);
+  server->sendHeader(F("Cache-Control"), F("public, max-age=604800")); // URLs carry the version
+  if (server->header(F("If-None-Match")) == tag) {
+    server->send(304);
+    return;
+  }
+  server->sendHeader(F("Content-Encoding"), F("gzip"));
+  server->send_P(200, type, (PGM_P) gz, length);
+}
+
 void WiFiManager::handleNotFound() {
   if (captivePortal()) { // If captive portal redirect instead of displaying the error page.
     return;
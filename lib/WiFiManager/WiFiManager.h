@@ -17,6 +17,7 @@
 #include <ESP8266WebServer.h>
 #include <DNSServer.h>
 #include <memory>
+#include <algorithm>
 
 extern "C" {
   #include "user_interface.h"
@@ -39,6 +40,53 @@ const char HTTP_END[] PROGMEM             = "</div></body></html>";
 #define WIFI_MANAGER_MAX_PARAMS 10
 #endif
 
+#ifndef WIFI_MANAGER_CONNECT_TIMEOUT
+#define WIFI_MANAGER_CONNECT_TIMEOUT 10000 // ms, non-blocking connect attempts when setConnectTimeout() is not used
+#endif
+
+#ifndef WIFI_MANAGER_MAX_NETWORKS
+#define WIFI_MANAGER_MAX_NETWORKS 32
+#endif
+
+#ifndef WIFI_MANAGER_SCAN_MAX_AGE
+#define WIFI_MANAGER_SCAN_MAX_AGE 30000   // ms, older results are still shown while a new scan runs
+#endif
+
+struct WiFiManagerNetwork {
+  uint32_t hash;                          // FNV-1a of ssid
+  int32_t  rssi;
+  bool     secure;
+  char     ssid[33];
+};
+
+#ifndef WIFI_MANAGER_CHUNK_SIZE
+#define WIFI_MANAGER_CHUNK_SIZE 256
+#endif
+
+class WiFiManagerPage {
+  public:
+    /**
+        Streams a page with chunked transfer encoding, buffering at most WIFI_MANAGER_CHUNK_SIZE bytes
+        Templates are read from PROGMEM and their {x} placeholders filled while being copied
+    */
+    WiFiManagerPage(ESP8266WebServer &server, int code = 200);
+    ~WiFiManagerPage();
+
+    void print(const char *text);
+    void print(const String &text);
+    void print(const __FlashStringHelper *text);
+    void print(unsigned long value);
+    void print_P(PGM_P text);
+    // keys[i] is the placeholder letter replaced by values[i]
+    void printTemplate_P(PGM_P text, const char *keys, const char *const *values);
+    void flush();
+  private:
+    ESP8266WebServer &_server;
+    String            _buffer;
+
+    void write(char c);
+};
+
 class WiFiManagerParameter {
   public:
     /** 
@@ -81,6 +129,15 @@ class WiFiManager
     boolean       startConfigPortal();
     boolean       startConfigPortal(char const *apName, char const *apPassword = NULL);
 
+    //if false, autoConnect() and startConfigPortal() return right away and the portal runs from process()
+    void          setConfigPortalBlocking(boolean shouldBlock);
+    //services a non-blocking portal: at most one DNS query and one HTTP request per call
+    //returns true once there is nothing left to service (connected, or portal timed out)
+    boolean       process();
+    boolean       getConfigPortalActive();
+    //longest process() call since construction, in microseconds
+    unsigned long getProcessMaxMicros();
+
     // get the AP name of the config portal, so it can be used in the callback
     String        getConfigPortalSSID();
 
@@ -128,6 +185,8 @@ class WiFiManager
     //const String  HTTP_HEAD = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1\"/><title>{v}</title>";
 
     void          setupConfigPortal();
+    boolean       processConfigPortal();  // one portal step, true when portal was closed
+    void          stopConfigPortal();
     void          startWPS();
 
     const char*   _apName                 = "no-net";
@@ -137,6 +196,11 @@ class WiFiManager
     unsigned long _configPortalTimeout    = 0;
     unsigned long _connectTimeout         = 0;
     unsigned long _configPortalStart      = 0;
+    boolean       _configPortalBlocking   = true;
+    boolean       _configPortalActive     = false;
+    unsigned long _connectRequest         = 0;   // millis() when credentials were saved, 0 if none
+    unsigned long _connectBegin           = 0;   // millis() when WiFi.begin() was called, 0 if not yet
+    unsigned long _processMaxMicros       = 0;
 
     IPAddress     _ap_static_ip;
     IPAddress     _ap_static_gw;
@@ -156,16 +220,30 @@ class WiFiManager
     //String        getEEPROMString(int start, int len);
     //void          setEEPROMString(int start, int len, String string);
 
+    // Background scan, snapshot sorted by signal with duplicates removed
+    WiFiManagerNetwork* _networks         = NULL;
+    int           _networkCount           = 0;
+    unsigned long _scanTime               = 0;   // millis() of last completed scan, 0 if none
+
+    void          startScan();
+    boolean       updateScan();
+
     int           status = WL_IDLE_STATUS;
     int           connectWifi(String ssid, String pass);
+    boolean       beginConnect(String ssid, String pass);
+    unsigned long connectTimeout();
     uint8_t       waitForConnectResult();
 
+    void          printHead(WiFiManagerPage &page, const char *title);
+    void          printParam(WiFiManagerPage &page, const char *id, const char *placeholder, const char *length, const char *value, const char *custom);
+
     void          handleRoot();
     void          handleWifi(boolean scan);
     void          handleWifiSave();
     void          handleInfo();
     void          handleReset();
     void          handleNotFound();
+    void          handleAsset(PGM_P type, const uint8_t *gz, size_t length, PGM_P etag);
     void          handle204();
     boolean       captivePortal();
     boolean       configPortalHasTimeout();
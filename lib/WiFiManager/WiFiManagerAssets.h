@@ -0,0 +1,54 @@
+// Generated by extras/compress.js from extras/WiFiManager.template.html, do not edit
+
+const char HTTP_STYLE_PATH[] PROGMEM = "/wm.css";
+const char HTTP_STYLE_TYPE[] PROGMEM = "text/css";
+const char HTTP_STYLE_ETAG[] PROGMEM = "\"0dec6efc\"";
+const uint8_t HTTP_STYLE_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x52, 0x5d, 0x6f, 0xaa, 0x40,
+  0x10, 0xfd, 0x2b, 0xa6, 0x37, 0x4d, 0xee, 0x4d, 0x8a, 0xa2, 0xa2, 0x2d, 0x6c, 0xfa, 0xb0, 0x58,
+  0x6a, 0xb5, 0x7e, 0x5b, 0xa8, 0xe5, 0x6d, 0x61, 0x97, 0x65, 0x05, 0x76, 0x71, 0x5d, 0x05, 0x35,
+  0xfc, 0xf7, 0xc6, 0x6a, 0x52, 0x1f, 0xee, 0xdb, 0x9c, 0x39, 0x73, 0x26, 0x67, 0x32, 0xa7, 0x1e,
+  0x9e, 0x14, 0x29, 0x95, 0x86, 0x52, 0x46, 0xb9, 0x15, 0x12, 0xae, 0x88, 0x04, 0x15, 0x66, 0xfb,
+  0x07, 0xc6, 0xf3, 0x9d, 0x3a, 0xe5, 0x08, 0x63, 0xc6, 0xa9, 0xd5, 0xc9, 0x4b, 0x10, 0x09, 0xae,
+  0xb4, 0x2d, 0x3b, 0x12, 0xab, 0x49, 0x32, 0x50, 0x5d, 0x06, 0x0a, 0x86, 0x55, 0x6c, 0x99, 0x9d,
+  0x7b, 0x50, 0x05, 0x02, 0x1f, 0xfe, 0xb3, 0xed, 0x47, 0x16, 0xa1, 0x8c, 0xa5, 0x07, 0x6b, 0x4f,
+  0x24, 0x46, 0x1c, 0x81, 0x2a, 0xd8, 0x29, 0x25, 0xf8, 0x29, 0x10, 0x12, 0x13, 0x69, 0xe9, 0xe0,
+  0x52, 0x68, 0x12, 0x61, 0xb6, 0xdb, 0x5a, 0x7a, 0xbd, 0x2d, 0x49, 0x06, 0x02, 0x14, 0x26, 0x54,
+  0x8a, 0x1d, 0xc7, 0x5a, 0x28, 0x52, 0x21, 0xad, 0x3f, 0xcd, 0x08, 0xb5, 0x49, 0x08, 0xae, 0x28,
+  0x8a, 0x22, 0x90, 0x32, 0x4e, 0xb4, 0x98, 0x30, 0x1a, 0x2b, 0xab, 0x55, 0x37, 0xce, 0xb2, 0x1b,
+  0x9f, 0xf5, 0xd6, 0xb9, 0x71, 0xf1, 0xd8, 0xd4, 0xf5, 0x7b, 0x50, 0xd5, 0x37, 0xa7, 0x28, 0x15,
+  0x48, 0x59, 0xf2, 0x2c, 0xb9, 0x52, 0x5d, 0x23, 0x2f, 0xc1, 0x8d, 0xf3, 0x0b, 0x57, 0xd5, 0xd3,
+  0xd3, 0xaf, 0x05, 0x6b, 0x27, 0xd3, 0xbf, 0x77, 0x18, 0x29, 0x64, 0xb1, 0x0c, 0x51, 0xd2, 0xc8,
+  0x39, 0x05, 0x01, 0xda, 0x92, 0xae, 0xf1, 0xc0, 0x3c, 0x7b, 0xba, 0x28, 0xf4, 0xf7, 0x3e, 0x15,
+  0x10, 0x42, 0x38, 0x59, 0xba, 0xb1, 0xe3, 0x52, 0x08, 0x61, 0xef, 0x0c, 0x21, 0xed, 0xc1, 0x31,
+  0x84, 0xd0, 0x76, 0xf2, 0x81, 0xec, 0x9f, 0x1b, 0x23, 0xcf, 0x1e, 0x7b, 0xce, 0xaa, 0xd1, 0x68,
+  0x3c, 0x39, 0x76, 0x11, 0xd9, 0xc5, 0x76, 0x54, 0x3c, 0xcd, 0xe0, 0x71, 0xb2, 0x46, 0x3d, 0x6a,
+  0x4c, 0x3e, 0x3c, 0xcf, 0x5d, 0x0f, 0x99, 0xff, 0xb2, 0x70, 0x5d, 0xf7, 0xb5, 0xc4, 0xcc, 0xef,
+  0x2f, 0x63, 0xd1, 0x9d, 0x2e, 0x93, 0xce, 0x8c, 0x1a, 0xe4, 0xf5, 0x80, 0xdf, 0x3e, 0x7a, 0x6b,
+  0x14, 0xb5, 0xcf, 0xbb, 0x7c, 0x27, 0x75, 0xe6, 0xde, 0xdc, 0x58, 0x93, 0xd6, 0x64, 0x59, 0x3c,
+  0xc2, 0x01, 0x8c, 0x1d, 0x1b, 0x65, 0xef, 0xdc, 0x7c, 0x6c, 0xec, 0xc6, 0x2b, 0xa7, 0x6f, 0xef,
+  0xc5, 0x31, 0xf9, 0x0c, 0xcc, 0x5e, 0xcb, 0x2f, 0x8d, 0xf2, 0xf8, 0x79, 0x48, 0xec, 0xf8, 0x15,
+  0x92, 0xaf, 0xdc, 0xa4, 0xc9, 0xe8, 0xe0, 0x3b, 0xfa, 0x71, 0x30, 0xe6, 0xc2, 0xe4, 0x06, 0x6d,
+  0x9a, 0x71, 0x86, 0xbf, 0xda, 0xe6, 0x36, 0x2c, 0x36, 0x5e, 0x32, 0x5d, 0xa1, 0x32, 0x8f, 0x75,
+  0xbf, 0xb7, 0x9a, 0x87, 0x9b, 0x72, 0x99, 0xd3, 0x79, 0x3e, 0x9d, 0xa0, 0x8e, 0x59, 0x24, 0x8b,
+  0x97, 0xe9, 0xc8, 0x6c, 0x13, 0xb8, 0xda, 0xb3, 0xac, 0x48, 0x83, 0x59, 0x50, 0x14, 0x1e, 0x24,
+  0x74, 0xb4, 0x6c, 0xbe, 0xf5, 0x23, 0xff, 0xe7, 0x64, 0x7b, 0xb8, 0x70, 0x3b, 0x8e, 0x4c, 0x86,
+  0x94, 0xd2, 0xe7, 0xe7, 0xbb, 0x7f, 0x35, 0x2e, 0x34, 0x49, 0x72, 0x82, 0x54, 0x2d, 0x25, 0x91,
+  0xaa, 0x5d, 0xb3, 0x71, 0xf3, 0xe1, 0xdf, 0x60, 0x7d, 0x03, 0xec, 0xd0, 0x8a, 0x25, 0x94, 0x02,
+  0x00, 0x00,
+};
+
+const char HTTP_SCRIPT_PATH[] PROGMEM = "/wm.js";
+const char HTTP_SCRIPT_TYPE[] PROGMEM = "application/javascript";
+const char HTTP_SCRIPT_ETAG[] PROGMEM = "\"75722ecf\"";
+const uint8_t HTTP_SCRIPT_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4b, 0x2b, 0xcd, 0x4b, 0x2e, 0xc9,
+  0xcc, 0xcf, 0x53, 0x48, 0xd6, 0xc8, 0xd1, 0xac, 0x4e, 0xc9, 0x4f, 0x2e, 0xcd, 0x4d, 0xcd, 0x2b,
+  0xd1, 0x4b, 0x4f, 0x2d, 0x71, 0xcd, 0x49, 0x05, 0x31, 0x9d, 0x2a, 0x3d, 0x53, 0x34, 0xd4, 0x8b,
+  0xd5, 0x35, 0xf5, 0xca, 0x12, 0x73, 0x4a, 0x53, 0x6d, 0x73, 0xf4, 0x32, 0xf3, 0xf2, 0x52, 0x8b,
+  0x42, 0x52, 0x2b, 0x4a, 0x6a, 0x6a, 0x72, 0xf4, 0x4a, 0x52, 0x2b, 0x4a, 0x9c, 0xf3, 0xf3, 0x4a,
+  0x52, 0xf3, 0x4a, 0xac, 0x71, 0xea, 0x2e, 0x50, 0xd7, 0xd4, 0x4b, 0xcb, 0x4f, 0x2e, 0x2d, 0xd6,
+  0xd0, 0xb4, 0xae, 0x05, 0x00, 0x06, 0x53, 0xe7, 0x8e, 0x72, 0x00, 0x00, 0x00,
+};
+
+const char HTTP_ASSETS[] PROGMEM = "<link rel=\"stylesheet\" href=\"/wm.css?0dec6efc\"><script src=\"/wm.js?75722ecf\"></script>";
@@ -0,0 +1,94 @@
+'use strict';
+
+// Builds ../WiFiManagerAssets.h: the portal stylesheet and script from
+// WiFiManager.template.html, gzip-compressed into PROGMEM arrays with an ETag.
+// Run from this directory after changing HTTP_STYLE or HTTP_SCRIPT:
+//
+//   node compress.js
+//
+// It also prints the bytes each portal page costs on the wire before (inline)
+// and after (cached separate resources).
+
+const fs = require('fs');
+const zlib = require('zlib');
+const crypto = require('crypto');
+
+const inFile = 'WiFiManager.template.html';
+const outFile = '../WiFiManagerAssets.h';
+const headerFile = '../WiFiManager.h';
+
+const assets = [
+  { name: 'STYLE', block: 'HTTP_STYLE', tag: 'style', path: '/wm.css', type: 'text/css' },
+  { name: 'SCRIPT', block: 'HTTP_SCRIPT', tag: 'script', path: '/wm.js', type: 'application/javascript' }
+];
+
+function extract(data, block) {
+  const re = new RegExp('<!-- ' + block + ' -->([\\s\\S]+)<!-- /' + block + ' -->', 'm');
+  return re.exec(data)[1];
+}
+
+function minify(text, tag) {
+  text = text.replace(new RegExp('</?' + tag + '>', 'g'), '');
+  text = text.replace(/\s+/g, ' ').trim();
+  // spaces next to punctuation, never inside the data: URL (base64 has none)
+  return text.replace(/\s*([{};:,])\s*/g, '$1');
+}
+
+function bytes(array) {
+  let out = '';
+  for (let i = 0; i < array.length; i++) {
+    out += (i % 16 === 0 ? '\n  ' : ' ') + '0x' + ('0' + array[i].toString(16)).slice(-2) + ',';
+  }
+  return out;
+}
+
+function inlineLength(header, name) {
+  const re = new RegExp('const char ' + name + '\\[\\] PROGMEM\\s*= "((?:[^"\\\\]|\\\\.)*)";');
+  return JSON.parse('"' + re.exec(header)[1] + '"').length;
+}
+
+const data = fs.readFileSync(inFile, 'utf8');
+const header = fs.readFileSync(headerFile, 'utf8');
+
+let out = '// Generated by extras/compress.js from extras/' + inFile + ', do not edit\n\n';
+let links = '';
+let gzipTotal = 0;
+
+for (const asset of assets) {
+  const text = minify(extract(data, asset.block), asset.tag);
+  const gz = zlib.gzipSync(Buffer.from(text), { level: 9 });
+  gz[9] = 3; // OS: unix, so output does not depend on the build host
+  const etag = crypto.createHash('sha1').update(text).digest('hex').slice(0, 8);
+  asset.raw = text.length;
+  asset.gzip = gz.length;
+  gzipTotal += gz.length;
+
+  out += 'const char HTTP_' + asset.name + '_PATH[] PROGMEM = "' + asset.path + '";\n';
+  out += 'const char HTTP_' + asset.name + '_TYPE[] PROGMEM = "' + asset.type + '";\n';
+  out += 'const char HTTP_' + asset.name + '_ETAG[] PROGMEM = "\\"' + etag + '\\"";\n';
+  out += 'const uint8_t HTTP_' + asset.name + '_GZ[] PROGMEM = {' + bytes(gz) + '\n};\n\n';
+
+  // versioned URL, so browsers may keep the asset without revalidating
+  if (asset.tag === 'style') {
+    links += '<link rel=\\"stylesheet\\" href=\\"' + asset.path + '?' + etag + '\\">';
+  } else {
+    links += '<script src=\\"' + asset.path + '?' + etag + '\\"></script>';
+  }
+}
+
+out += 'const char HTTP_ASSETS[] PROGMEM = "' + links + '";\n';
+fs.writeFileSync(outFile, out);
+
+const inline = inlineLength(header, 'HTTP_STYLE') + inlineLength(header, 'HTTP_SCRIPT');
+const linked = JSON.parse('"' + links + '"').length;
+
+for (const asset of assets) {
+  console.log(asset.path + ': ' + asset.raw + ' bytes, ' + asset.gzip + ' gzipped');
+}
+console.log('style and script per page, inline: ' + inline + ' bytes');
+console.log('style and script per page, linked: ' + linked + ' bytes' +
+  ' (+' + gzipTotal + ' gzipped once per browser, 304 without body on revalidation)');
+for (const pages of [1, 3, 5]) {
+  console.log(pages + ' page(s): ' + inline * pages + ' bytes before, ' +
+    (linked * pages + gzipTotal) + ' bytes after');
+}
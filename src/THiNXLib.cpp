@@ -38,7 +38,7 @@ WiFiManagerParameter * THiNX::api_key_param;
 WiFiManagerParameter * THiNX::owner_param;
 
 void THiNX::saveConfigCallback() {
-  Serial.println(F("*TH: WiFiManager's saveConfigCallback called. Counfiguration should be saved now!"));
+  THX_LOGI("WiFiManager's saveConfigCallback called. Counfiguration should be saved now!");
   should_save_config = true;
   strcpy(thx_api_key, api_key_param->getValue());
   strcpy(thx_owner_key, owner_param->getValue());
@@ -60,31 +60,55 @@ THiNX::THiNX() {
 
 /* Designated Initializers */
 
-THiNX::THiNX(const char * __apikey) {
+THiNX::THiNX(const char * __apikey) : THiNX(__apikey, "") {
 
-  THiNX(__apikey, "");
 }
 
 THiNX::THiNX(const char * __apikey, const char * __owner_id) {
 
   thinx_phase = INIT;
+  arena_phase = INIT;
+
+  #ifndef __USE_SPIFFS__
+  EEPROM.begin(THINX_EEPROM_SIZE); // device info JSON, environment and WiFi store; must not exceed SPI_FLASH_SEC_SIZE
+  #endif
+
+  #ifdef __USE_WIFI_STORE__
+  bool wifi_store_busy = start_wifi_store();
+  #if defined(__USE_WIFI_MANAGER__) && !defined(__NONBLOCKING_PORTAL__)
+  while (wifi_store_step()) {
+    delay(100);
+  }
+  wifi_store_busy = false;
+  #endif
+  #endif
 
   #ifdef __USE_WIFI_MANAGER__
   should_save_config = false;
-  WiFiManager wifiManager;
+  wifi_manager = new WiFiManager();
   api_key_param = new WiFiManagerParameter("apikey", "API Key", thinx_api_key, 64);
-  wifiManager.addParameter(api_key_param);
+  wifi_manager->addParameter(api_key_param);
   owner_param = new WiFiManagerParameter("owner", "Owner ID", thinx_owner_key, 64);
-  wifiManager.addParameter(owner_param);
-  wifiManager.setTimeout(5000);
-  wifiManager.setDebugOutput(true); // does some logging on mode set
-  wifiManager.setSaveConfigCallback(saveConfigCallback);
-  wifiManager.autoConnect(accessPointName.c_str());
+  wifi_manager->addParameter(owner_param);
+  wifi_manager->setConfigPortalTimeout(THINX_PORTAL_TIMEOUT); // seconds, was 5000 (83 min)
+  wifi_manager->setDebugOutput(THINX_LOG_LEVEL >= THINX_LOG_DEBUG); // does some logging on mode set
+  wifi_manager->setSaveConfigCallback(saveConfigCallback);
+  #ifdef __NONBLOCKING_PORTAL__
+  wifi_manager->setConfigPortalBlocking(false);
+  #endif
+  #ifdef __USE_WIFI_STORE__
+  if (wifi_store_busy) {
+    // portal waits in loop() until remembered networks have been tried
+  } else if (WiFi.status() == WL_CONNECTED) {
+    delete wifi_manager;
+    wifi_manager = nullptr;
+  } else
+  #endif
+  if (wifi_manager->autoConnect(accessPointName.c_str()) || wifi_manager->process()) {
+    delete wifi_manager; // blocking portal is done, or connected already
+    wifi_manager = nullptr;
+  }
   #endif
-
-  Serial.print(F("\n*TH: THiNXLib rev. "));
-  Serial.print(thx_revision);
-  Serial.print(" commit-id:");
 
   if (strlen(thx_commit_id) > 8) {
     thinx_commit_id = strdup(thx_commit_id); // -D build env var
@@ -92,7 +116,7 @@ THiNX::THiNX(const char * __apikey, const char * __owner_id) {
     thinx_commit_id = strdup(THINX_COMMIT_ID); // value from thinx.h
   }
 
-  Serial.println(thinx_commit_id); // returned string is "not declared in expansion of THX_CID, why?
+  THX_LOGI("THiNXLib rev. %s commit-id: %s", thx_revision, thinx_commit_id);
 
   // see lines ../hardware/cores/esp8266/Esp.cpp:80..100
   wdt_disable(); // causes wdt reset after 8 seconds!
@@ -123,15 +147,30 @@ THiNX::THiNX(const char * __apikey, const char * __owner_id) {
   thinx_forced_update = false;
   last_checkin_timestamp = 0; // 1/1/1970
 
-  checkin_interval = millis() + checkin_timeout / 4; // retry faster before first checkin
-  reboot_interval = millis() + reboot_timeout;
+  // devices powered on together must not hit the API together
+  checkin_timeout = millis() + device_jitter(THINX_BOOT_JITTER_WINDOW);
+  reboot_timeout = millis() + reboot_interval + device_jitter(THINX_REBOOT_WINDOW);
 
   // will be loaded from SPIFFS/EEPROM or retrieved on Registration later
   if (strlen(__owner_id) == 0) {
     thinx_owner = strdup("");
   }
 
-  EEPROM.begin(512); // should be SPI_FLASH_SEC_SIZE
+  registerTopic("status"); // THINX_TOPIC_STATUS, prefixed once owner and udid are known
+
+  #ifdef __USE_ENV_STORE__
+  memset(env_keys, 0, sizeof(env_keys)); // loaded once filesystem is mounted
+  memset(env_values, 0, sizeof(env_values));
+  env_changed = 0;
+  #endif
+
+  #ifdef __USE_DNS_CACHE__
+  restore_dns_cache();
+  #endif
+
+  #ifdef __USE_DELTA_CHECKIN__
+  restore_checkin_state();
+  #endif
 
   import_build_time_constants();
   restore_device_info();
@@ -152,9 +191,9 @@ THiNX::THiNX(const char * __apikey, const char * __owner_id) {
     thinx_api_key = strdup(__apikey);
   } else {
       if (strlen(thinx_api_key) > 4) {
-          Serial.print(F("*TH: With thinx.h API Key..."));
+          THX_LOGI("With thinx.h API Key...");
       } else {
-          Serial.print(F("*TH: No API Key!"));
+          THX_LOGW("No API Key!");
           return;
       }
   }
@@ -163,9 +202,9 @@ THiNX::THiNX(const char * __apikey, const char * __owner_id) {
     thinx_owner = strdup(__owner_id);
   } else {
       if (strlen(thinx_owner) > 4) {
-          Serial.print(F("*TH: With thinx.h owner..."));
+          THX_LOGI("With thinx.h owner...");
       } else {
-          Serial.print(F("*TH: No API Key!"));
+          THX_LOGW("No API Key!");
           return;
       }
   }
@@ -178,9 +217,9 @@ THiNX::THiNX(const char * __apikey, const char * __owner_id) {
 void THiNX::init_with_api_key(const char * __apikey) {
 
   #ifdef __USE_SPIFFS__
-  Serial.println(F("*TH: Checking filesystem, please don't turn off or reset the device now..."));
+  THX_LOGI("Checking filesystem, please don't turn off or reset the device now...");
   if (!fsck()) {
-    Serial.println(F("*TH: Filesystem check failed, disabling THiNX."));
+    THX_LOGE("Filesystem check failed, disabling THiNX.");
     return;
   }
   #endif
@@ -190,11 +229,15 @@ void THiNX::init_with_api_key(const char * __apikey) {
     info_loaded = true;
   }
 
+  #ifdef __USE_ENV_STORE__
+  restore_env();
+  #endif
+
   if (strlen(__apikey) > 4) {
     thinx_api_key = strdup(__apikey);
   } else {
     if (strlen(thinx_api_key) < 4) {
-      Serial.print(F("*TH: No API Key!"));
+      THX_LOGW("No API Key!");
       return;
     }
   }
@@ -214,47 +257,46 @@ char* THiNX::get_udid() {
 void THiNX::connect() {
 
   if (wifi_connected) {
-    Serial.println(F("*TH: connected"));
+    THX_LOGI("connected");
     return;
   }
 
-  Serial.print(F("*TH: connecting: ")); Serial.println(wifi_retry);
+  THX_LOGI("connecting: %d", wifi_retry);
 
   #ifndef __USE_WIFI_MANAGER__
   if (WiFi.SSID()) {
 
     if (wifi_connection_in_progress != true) {
-      Serial.print(F("*TH: SSID ")); Serial.println(WiFi.SSID());
+      THX_LOGI("SSID %s", WiFi.SSID().c_str());
       if (WiFi.getMode() == WIFI_AP) {
-        Serial.print(F("THiNX > LOOP > START() > AP SSID"));
-        Serial.println(WiFi.SSID());
+        THX_LOGI("THiNX > LOOP > START() > AP SSID %s", WiFi.SSID().c_str());
       } else {
         if (strlen(THINX_ENV_SSID) > 2) {
-          Serial.println(F("*TH: LOOP > CONNECT > STA RECONNECT"));
+          THX_LOGD("LOOP > CONNECT > STA RECONNECT");
           WiFi.begin(THINX_ENV_SSID, THINX_ENV_PASS);
-          Serial.println(F("*TH: Enabling connection state (197)"));
+          THX_LOGD("Enabling connection state (197)");
         } else {
-          Serial.println(F("*TH: LOOP > CONNECT > NO CREDS"));
+          THX_LOGD("LOOP > CONNECT > NO CREDS");
           wifi_connection_in_progress = true;
-          Serial.println(F("*TH: WARNING: Dead branch (201)"));
+          THX_LOGW("Dead branch (201)");
         }
         wifi_connection_in_progress = true; // prevents re-entering connect_wifi(); should timeout
       }
       //
     }
   } else {
-    Serial.print(F("*TH: No SSID."));
+    THX_LOGW("No SSID.");
   }
   #endif
 
   if (WiFi.status() == WL_CONNECTED) {
-    Serial.println(F("THiNX > LOOP > ALREADY CONNECTED"));
+    THX_LOGI("THiNX > LOOP > ALREADY CONNECTED");
     wifi_connected = true; // prevents re-entering start() [this method]
     wifi_connection_in_progress = false;
   } else {
-    Serial.println(F("THiNX > LOOP > CONNECTING WiFi:"));
+    THX_LOGI("THiNX > LOOP > CONNECTING WiFi:");
     connect_wifi();
-    Serial.println(F("*TH: Enabling connection state (237)"));
+    THX_LOGD("Enabling connection state (237)");
     wifi_connection_in_progress = true;
   }
 }
@@ -276,7 +318,7 @@ void THiNX::connect_wifi() {
   if (wifi_connection_in_progress) {
     if (wifi_retry > 1000) {
       if (WiFi.getMode() == WIFI_STA) {
-        Serial.println(F("*TH: Starting AP with PASSWORD..."));
+        THX_LOGI("Starting AP with PASSWORD...");
         WiFi.mode(WIFI_AP);
         WiFi.softAP(accessPointName.c_str(), accessPointPassword.c_str()); // setup the AP on channel 1, not hidden, and allow 8 clients
         wifi_retry = 0;
@@ -285,17 +327,17 @@ void THiNX::connect_wifi() {
         return;
       } else {
         if (strlen(THINX_ENV_SSID) > 2) {
-          Serial.println(F("*TH: Connecting to AP with pre-defined credentials...")); Serial.flush();
+          THX_LOGI("Connecting to AP with pre-defined credentials...");
           WiFi.mode(WIFI_STA);
           WiFi.begin(THINX_ENV_SSID, THINX_ENV_PASS);
-          Serial.println(F("*TH: Enabling connection state (283)"));
+          THX_LOGD("Enabling connection state (283)");
           wifi_connection_in_progress = true; // prevents re-entering connect_wifi()
           wifi_retry = 0; // waiting for sta...
         }
       }
 
     } else {
-      Serial.print("*TH: WiFi retry"); Serial.println(wifi_retry); Serial.flush();
+      THX_LOGD("WiFi retry %d", wifi_retry);
       wifi_retry++;
     }
 
@@ -303,13 +345,13 @@ void THiNX::connect_wifi() {
 
     if (strlen(THINX_ENV_SSID) > 2) {
       if (wifi_retry == 0) {
-        Serial.println(F("*TH: Connecting to AP with pre-defined credentials..."));
+        THX_LOGI("Connecting to AP with pre-defined credentials...");
         // 1st run
         if (WiFi.getMode() != WIFI_STA) {
           WiFi.mode(WIFI_STA);
         } else {
           WiFi.begin(THINX_ENV_SSID, THINX_ENV_PASS);
-          Serial.println(F("*TH: Enabling connection state (272)"));
+          THX_LOGD("Enabling connection state (272)");
           wifi_connection_in_progress = true; // prevents re-entering connect_wifi()
         }
       }
@@ -318,93 +360,648 @@ void THiNX::connect_wifi() {
   #endif
 }
 
+/* FNV-1a, used for change detection and validating RTC memory contents */
+static uint32_t fnv1a(const void *data, size_t len, uint32_t hash = 2166136261UL) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+/*
+* DNS cache, consulted by the plain connect paths (API and MQTT with forceHTTP); TLS connects by name for SNI
+*/
+
+bool THiNX::resolve(const char *host, IPAddress &address) {
+
+  #ifdef __USE_DNS_CACHE__
+  uint32_t now = (uint32_t) time(nullptr);
+  thinx_dns_entry_t *entry = dns_cache_entry(host);
+
+  if (entry != NULL) {
+    if (now < entry->expires) {
+      address = entry->address; // fresh
+      return true;
+    }
+    // Stale, serve now and refresh from loop() when idle. Clock before SNTP sync counts as stale.
+    if ((now < THINX_DNS_CACHE_CLOCK_VALID) || (now < entry->expires + THINX_DNS_CACHE_MAX_STALE)) {
+      address = entry->address;
+      dns_revalidate = true;
+      return true;
+    }
+  }
+  #endif
+
+  IPAddress resolved;
+  if (WiFi.hostByName(host, resolved) != 1) {
+    #ifdef __USE_DNS_CACHE__
+    if (entry != NULL) {
+      THX_LOGE("DNS lookup failed, using expired address.");
+      address = entry->address;
+      return true;
+    }
+    #endif
+    THX_LOGE("DNS lookup failed for %s", host);
+    return false;
+  }
+
+  address = resolved;
+
+  #ifdef __USE_DNS_CACHE__
+  if (strlen(host) < sizeof(entry->host)) {
+    if (entry == NULL) {
+      // Replace empty or the oldest slot
+      entry = &dns_cache.entries[0];
+      for (int i = 1; i < THINX_DNS_CACHE_SIZE; i++) {
+        if (dns_cache.entries[i].expires < entry->expires) {
+          entry = &dns_cache.entries[i];
+        }
+      }
+      strcpy(entry->host, host);
+    }
+    entry->address = (uint32_t) resolved;
+    entry->expires = now + THINX_DNS_CACHE_TTL;
+    save_dns_cache();
+  }
+  #endif
+
+  return true;
+}
+
+void THiNX::invalidate_address(const char *host) {
+  #ifdef __USE_DNS_CACHE__
+  thinx_dns_entry_t *entry = dns_cache_entry(host);
+  if (entry != NULL) {
+    memset(entry, 0, sizeof(thinx_dns_entry_t));
+    save_dns_cache();
+  }
+  #endif
+}
+
+#ifdef __USE_DNS_CACHE__
+
+thinx_dns_entry_t * THiNX::dns_cache_entry(const char *host) {
+  for (int i = 0; i < THINX_DNS_CACHE_SIZE; i++) {
+    thinx_dns_entry_t *entry = &dns_cache.entries[i];
+    if ((entry->address != 0) && (strcmp(entry->host, host) == 0)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+uint32_t THiNX::dns_cache_checksum() {
+  // enough to reject uninitialized RTC memory after power-on
+  return fnv1a(dns_cache.entries, sizeof(dns_cache.entries));
+}
+
+void THiNX::restore_dns_cache() {
+  dns_revalidate = false;
+  dns_retry_at = 0;
+  dns_retry_delay = 0;
+  system_rtc_mem_read(THINX_DNS_CACHE_RTC_OFFSET, &dns_cache, sizeof(dns_cache));
+  if ((dns_cache.magic != THINX_DNS_CACHE_MAGIC) || (dns_cache.checksum != dns_cache_checksum())) {
+    memset(&dns_cache, 0, sizeof(dns_cache));
+    dns_cache.magic = THINX_DNS_CACHE_MAGIC;
+    return;
+  }
+  for (int i = 0; i < THINX_DNS_CACHE_SIZE; i++) {
+    dns_cache.entries[i].host[sizeof(dns_cache.entries[i].host) - 1] = 0;
+  }
+  THX_LOGI("DNS cache restored.");
+}
+
+void THiNX::save_dns_cache() {
+  dns_cache.magic = THINX_DNS_CACHE_MAGIC;
+  dns_cache.checksum = dns_cache_checksum();
+  system_rtc_mem_write(THINX_DNS_CACHE_RTC_OFFSET, &dns_cache, sizeof(dns_cache));
+}
+
+void THiNX::revalidate_dns_cache() {
+  if ((long)(millis() - dns_retry_at) < 0) {
+    return; // resolver was down, not due yet
+  }
+  dns_revalidate = false;
+  uint32_t now = (uint32_t) time(nullptr);
+  bool changed = false;
+  for (int i = 0; i < THINX_DNS_CACHE_SIZE; i++) {
+    thinx_dns_entry_t *entry = &dns_cache.entries[i];
+    if ((entry->address == 0) || (now < entry->expires)) continue;
+    IPAddress resolved;
+    if (WiFi.hostByName(entry->host, resolved) != 1) {
+      // resolver outage, keep serving stale and retry later without stalling every loop()
+      dns_retry_delay = (dns_retry_delay == 0) ? THINX_DNS_RETRY_MIN : min(dns_retry_delay * 2, THINX_DNS_RETRY_MAX);
+      dns_retry_at = millis() + dns_retry_delay;
+      dns_revalidate = true;
+      THX_LOGW("DNS refresh failed, next try in %lu ms", dns_retry_delay);
+      break;
+    }
+    entry->address = (uint32_t) resolved;
+    entry->expires = now + THINX_DNS_CACHE_TTL;
+    dns_retry_delay = 0;
+    changed = true;
+  }
+  if (changed) {
+    save_dns_cache();
+  }
+}
+
+#endif
+
+/*
+* Remembered networks, ranked by last success and signal so boot does not need the portal
+*/
+
+#ifdef __USE_WIFI_STORE__
+
+uint32_t THiNX::wifi_store_checksum() {
+  return fnv1a(wifi_store.entries, sizeof(wifi_store.entries));
+}
+
+void THiNX::restore_wifi_store() {
+  bool valid = false;
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_WIFI_STORE_FILE, "r");
+  if (f) {
+    valid = f.read((uint8_t *) &wifi_store, sizeof(wifi_store)) == sizeof(wifi_store);
+    f.close();
+  }
+  #else
+  EEPROM.get(THINX_WIFI_STORE_EEPROM_OFFSET, wifi_store);
+  valid = true;
+  #endif
+  if (!valid || (wifi_store.magic != THINX_WIFI_STORE_MAGIC) || (wifi_store.checksum != wifi_store_checksum())) {
+    memset(&wifi_store, 0, sizeof(wifi_store));
+    wifi_store.magic = THINX_WIFI_STORE_MAGIC;
+    return;
+  }
+  for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+    wifi_store.entries[i].ssid[sizeof(wifi_store.entries[i].ssid) - 1] = 0;
+    wifi_store.entries[i].pass[sizeof(wifi_store.entries[i].pass) - 1] = 0;
+  }
+}
+
+void THiNX::save_wifi_store() {
+  wifi_store.magic = THINX_WIFI_STORE_MAGIC;
+  wifi_store.checksum = wifi_store_checksum();
+  wifi_store_changed = false;
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_WIFI_STORE_FILE, "w");
+  if (!f || (f.write((const uint8_t *) &wifi_store, sizeof(wifi_store)) != sizeof(wifi_store))) {
+    THX_LOGE("Saving WiFi store failed!");
+  }
+  if (f) {
+    f.close();
+  }
+  #else
+  EEPROM.put(THINX_WIFI_STORE_EEPROM_OFFSET, wifi_store);
+  if (!EEPROM.commit()) {
+    THX_LOGE("Saving WiFi store failed!");
+  }
+  #endif
+}
+
+// Most recently successful network, -1 if none
+int THiNX::wifi_store_newest() {
+  int newest = -1;
+  for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+    thinx_wifi_credential_t *entry = &wifi_store.entries[i];
+    if ((entry->ssid[0] != 0) && ((newest < 0) || (entry->last_success > wifi_store.entries[newest].last_success))) {
+      newest = i;
+    }
+  }
+  return newest;
+}
+
+bool THiNX::start_wifi_store() {
+  #ifdef __USE_SPIFFS__
+  SPIFFS.begin(); // mounted before fsck(), portal may need the result first
+  #endif
+  restore_wifi_store();
+  wifi_store_phase = STORE_IDLE;
+  wifi_store_order[0] = -1;
+  wifi_store_next = 0;
+
+  int newest = wifi_store_newest();
+  if ((newest < 0) || (WiFi.status() == WL_CONNECTED)) {
+    return false;
+  }
+
+  WiFi.mode(WIFI_STA);
+  thinx_wifi_credential_t *entry = &wifi_store.entries[newest];
+  if ((entry->channel != 0) && (entry->failures < THINX_WIFI_STORE_MAX_FAILURES)) {
+    // skips the scan, the usual case for devices that do not move
+    wifi_store_attempt(newest);
+    wifi_store_phase = STORE_FAST;
+  } else {
+    WiFi.scanNetworks(true);
+    wifi_store_phase = STORE_SCAN;
+  }
+  return true;
+}
+
+void THiNX::wifi_store_attempt(int index) {
+  thinx_wifi_credential_t *entry = &wifi_store.entries[index];
+  THX_LOGI("Connecting to remembered network %s", entry->ssid);
+  if (entry->channel != 0) {
+    WiFi.begin(entry->ssid, entry->pass, entry->channel, entry->bssid);
+  } else {
+    WiFi.begin(entry->ssid, entry->pass);
+  }
+  wifi_store_current = index;
+  wifi_store_deadline = millis() + THINX_WIFI_STORE_TIMEOUT;
+}
+
+static bool wifi_store_better(const thinx_wifi_credential_t *a, int32_t rssi_a, const thinx_wifi_credential_t *b, int32_t rssi_b) {
+  bool failing_a = a->failures >= THINX_WIFI_STORE_MAX_FAILURES;
+  bool failing_b = b->failures >= THINX_WIFI_STORE_MAX_FAILURES;
+  if (failing_a != failing_b) {
+    return failing_b;
+  }
+  bool weak_a = rssi_a < THINX_WIFI_STORE_MIN_RSSI;
+  bool weak_b = rssi_b < THINX_WIFI_STORE_MIN_RSSI;
+  if (weak_a != weak_b) {
+    return weak_b;
+  }
+  if (a->last_success != b->last_success) {
+    return a->last_success > b->last_success;
+  }
+  return rssi_a > rssi_b;
+}
+
+void THiNX::rank_wifi_store(int count) {
+  int32_t rssi[THINX_WIFI_STORE_SIZE];
+  for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+    rssi[i] = INT32_MIN; // not seen
+  }
+
+  // strongest access point of each remembered network
+  for (int n = 0; n < count; n++) {
+    String ssid = WiFi.SSID(n);
+    int32_t signal = WiFi.RSSI(n);
+    for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+      thinx_wifi_credential_t *entry = &wifi_store.entries[i];
+      if ((entry->ssid[0] == 0) || (signal <= rssi[i]) || (strcmp(entry->ssid, ssid.c_str()) != 0)) continue;
+      rssi[i] = signal;
+      memcpy(entry->bssid, WiFi.BSSID(n), sizeof(entry->bssid));
+      entry->channel = (uint8_t) WiFi.channel(n);
+    }
+  }
+
+  // insertion sort, there are only a few
+  int ranked = 0;
+  for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+    if (rssi[i] == INT32_MIN) continue;
+    int position = ranked++;
+    while ((position > 0) && wifi_store_better(&wifi_store.entries[i], rssi[i],
+        &wifi_store.entries[wifi_store_order[position - 1]], rssi[wifi_store_order[position - 1]])) {
+      wifi_store_order[position] = wifi_store_order[position - 1];
+      position--;
+    }
+    wifi_store_order[position] = i;
+  }
+  if (ranked < THINX_WIFI_STORE_SIZE) {
+    wifi_store_order[ranked] = -1;
+  }
+  wifi_store_next = 0;
+  THX_LOGI("Remembered networks in range: %d", ranked);
+}
+
+bool THiNX::wifi_store_step() {
+  if (wifi_store_phase == STORE_IDLE) {
+    return false;
+  }
+
+  if (wifi_store_phase == STORE_SCAN) {
+    int count = WiFi.scanComplete();
+    if (count == WIFI_SCAN_RUNNING) {
+      return true;
+    }
+    rank_wifi_store(count); // failed scan leaves no candidates
+    WiFi.scanDelete();
+  } else if (WiFi.status() == WL_CONNECTED) {
+    THX_LOGI("Connected to remembered network %s", WiFi.SSID().c_str());
+    wifi_store_phase = STORE_IDLE;
+    remember_network();
+    return false;
+  } else if ((long)(millis() - wifi_store_deadline) < 0) {
+    return true;
+  } else {
+    thinx_wifi_credential_t *entry = &wifi_store.entries[wifi_store_current];
+    if (entry->failures < 255) {
+      entry->failures++;
+    }
+    wifi_store_changed = true;
+    WiFi.disconnect();
+    if (wifi_store_phase == STORE_FAST) {
+      // cached access point may be gone, scan for the others
+      WiFi.scanNetworks(true);
+      wifi_store_phase = STORE_SCAN;
+      return true;
+    }
+  }
+
+  if ((wifi_store_next < THINX_WIFI_STORE_SIZE) && (wifi_store_order[wifi_store_next] >= 0)) {
+    wifi_store_attempt(wifi_store_order[wifi_store_next++]);
+    wifi_store_phase = STORE_TRY;
+    return true;
+  }
+
+  THX_LOGI("No remembered network connected.");
+  if (wifi_store_changed) {
+    save_wifi_store();
+  }
+  wifi_store_phase = STORE_IDLE;
+  return false;
+}
+
+// Adds or refreshes the current network, replacing the least recently successful one when full
+void THiNX::remember_network() {
+  String ssid = WiFi.SSID();
+  String pass = WiFi.psk();
+  if ((ssid.length() == 0) || (ssid.length() >= sizeof(wifi_store.entries[0].ssid)) || (pass.length() >= sizeof(wifi_store.entries[0].pass))) {
+    return;
+  }
+
+  int index = -1;
+  int oldest = 0;
+  for (int i = 0; i < THINX_WIFI_STORE_SIZE; i++) {
+    thinx_wifi_credential_t *entry = &wifi_store.entries[i];
+    if (strcmp(entry->ssid, ssid.c_str()) == 0) {
+      index = i;
+      break;
+    }
+    if ((entry->ssid[0] == 0) ? (wifi_store.entries[oldest].ssid[0] != 0) : (entry->last_success < wifi_store.entries[oldest].last_success)) {
+      oldest = i; // free entry first
+    }
+  }
+
+  int newest = wifi_store_newest();
+  bool changed = wifi_store_changed || (index < 0) || (index != newest);
+  if (index < 0) {
+    index = oldest;
+    memset(&wifi_store.entries[index], 0, sizeof(thinx_wifi_credential_t));
+    strcpy(wifi_store.entries[index].ssid, ssid.c_str());
+  }
+
+  thinx_wifi_credential_t *entry = &wifi_store.entries[index];
+  uint8_t channel = (uint8_t) WiFi.channel();
+  changed = changed || (strcmp(entry->pass, pass.c_str()) != 0) || (entry->failures != 0) || (entry->channel != channel)
+    || (memcmp(entry->bssid, WiFi.BSSID(), sizeof(entry->bssid)) != 0);
+  if (!changed) {
+    return; // only the order matters, newest network is not rewritten on every boot
+  }
+
+  strcpy(entry->pass, pass.c_str());
+  memcpy(entry->bssid, WiFi.BSSID(), sizeof(entry->bssid));
+  entry->channel = channel;
+  entry->failures = 0;
+  if (index != newest) {
+    // SNTP time when available, still ordered after newest otherwise
+    uint32_t now = (uint32_t) time(nullptr);
+    uint32_t after = (newest >= 0) ? wifi_store.entries[newest].last_success + 1 : 1;
+    entry->last_success = (now > after) ? now : after;
+  }
+  THX_LOGI("Remembering network %s", entry->ssid);
+  save_wifi_store();
+}
+
+#endif
+
 /*
 * Registration
 */
 
 void THiNX::checkin() {
-  Serial.println(thinx_time(NULL));
-  Serial.println(F("\n*TH: Contacting API..."));
+  THX_LOGI("Contacting API at %s...", thinx_time(NULL).c_str());
   if(!wifi_connected) {
-    Serial.println(F("*TH: Cannot checkin while not connected, exiting."));
+    THX_LOGE("Cannot checkin while not connected, exiting.");
+  } else if ((checkin_backoff > 0) && !checkin_due()) {
+    // Server asked us to back off or API is failing, status is sent with the scheduled checkin
+    THX_LOGI("Checkin deferred (backoff).");
   } else {
     String body = checkin_body();
+    checkin_status = 0;
     if (thx_ca_cert_len == 0 || forceHTTP) {
       senddata(body); // HTTP fallback
     } else {
       send_data(body); // HTTPS
     }
-    checkin_interval = millis() + checkin_timeout;
+    #ifdef __USE_DELTA_CHECKIN__
+    acknowledge_checkin((checkin_status >= 200 && checkin_status < 300) || (checkin_status == 304));
+    #endif
+    schedule_checkin();
   }
 }
 
+#ifdef __USE_DELTA_CHECKIN__
+
+/*
+* Delta checkin - field hashes of last acknowledged registration
+*/
+
+bool THiNX::checkin_field(JsonObject &root, int index, const thinx_key<const char *> &key, const char *value, uint32_t hash) {
+  if (value == NULL) {
+    checkin_pending[index] = 0;
+    return false;
+  }
+  if (hash == 0) {
+    hash = fnv1a(value, strlen(value)) | 1; // 0 is reserved for absent field
+  }
+  bool known = (checkin_state.magic == THINX_CHECKIN_STATE_MAGIC);
+  if (known && (checkin_state.hashes[index] == hash)) {
+    checkin_pending[index] = hash;
+    return false; // unchanged since last acknowledged checkin
+  }
+  if (!thinx_set(root, key, value)) {
+    // not sent (too long for the schema), server keeps what it had
+    checkin_pending[index] = known ? checkin_state.hashes[index] : 0;
+    return false;
+  }
+  checkin_pending[index] = hash;
+  return true;
+}
+
+uint32_t THiNX::checkin_state_hash() {
+  return fnv1a(checkin_state.hashes, sizeof(checkin_state.hashes));
+}
+
+void THiNX::acknowledge_checkin(bool accepted) {
+  if (accepted) {
+    memcpy(checkin_state.hashes, checkin_pending, sizeof(checkin_state.hashes));
+    checkin_state.magic = THINX_CHECKIN_STATE_MAGIC;
+  } else if (checkin_status == 409) {
+    // Server lost our base state, next checkin sends everything
+    checkin_state.magic = 0;
+  } else {
+    return;
+  }
+  checkin_state.checksum = checkin_state_hash();
+  system_rtc_mem_write(THINX_CHECKIN_STATE_RTC_OFFSET, &checkin_state, sizeof(checkin_state));
+}
+
+void THiNX::restore_checkin_state() {
+  system_rtc_mem_read(THINX_CHECKIN_STATE_RTC_OFFSET, &checkin_state, sizeof(checkin_state));
+  if ((checkin_state.magic != THINX_CHECKIN_STATE_MAGIC) || (checkin_state.checksum != checkin_state_hash())) {
+    memset(&checkin_state, 0, sizeof(checkin_state));
+  }
+  memset(checkin_pending, 0, sizeof(checkin_pending));
+}
+
+#endif
+
+/*
+* Checkin scheduling
+*/
+
+unsigned long THiNX::device_jitter(unsigned long window) {
+  if (window == 0) return 0;
+  // Knuth multiplicative hash, spreads sequential chip IDs across the window
+  uint32_t hash = ESP.getChipId() * 2654435761UL;
+  hash ^= hash >> 16;
+  return hash % window;
+}
+
+bool THiNX::checkin_due() {
+  return (long)(millis() - checkin_timeout) >= 0;
+}
+
+void THiNX::schedule_checkin() {
+
+  unsigned long next;
+
+  if (((checkin_status >= 200) && (checkin_status < 300)) || (checkin_status == 304)) {
+    checkin_backoff = 0;
+    if (checkin_hint > 0) {
+      next = checkin_hint; // server knows its load better
+    } else {
+      unsigned long window = min(THINX_CHECKIN_JITTER_WINDOW, checkin_interval / 4);
+      next = checkin_interval + device_jitter(window);
+    }
+
+  } else if ((retry_after > 0) && ((checkin_status == 503) || (checkin_status == 429))) {
+    checkin_backoff = retry_after;
+    next = retry_after + device_jitter(THINX_BOOT_JITTER_WINDOW);
+
+  } else {
+    if (checkin_backoff == 0) {
+      checkin_backoff = THINX_BACKOFF_MIN;
+    } else {
+      checkin_backoff = min(checkin_backoff * 2, THINX_BACKOFF_MAX);
+    }
+    next = checkin_backoff + device_jitter(checkin_backoff / 2);
+  }
+
+  checkin_hint = 0;
+  retry_after = 0;
+  checkin_timeout = millis() + next;
+
+  THX_LOGI("Checkin status %d, next in %lu s", checkin_status, next / 1000);
+}
+
 /*
 * Registration - JSON body constructor
 */
 
 String THiNX::checkin_body() {
 
-  DynamicJsonBuffer jsonBuffer(512);
-  JsonObject& root = jsonBuffer.createObject();
-
-  root["mac"] = thinx_mac();
+  THiNXJsonBuffer jsonBuffer(thinx_registration::capacity);
+  JsonObject& wrapper = jsonBuffer.createObject();
+  thinx_create(wrapper, thinx_registration::registration); // members are set through their schema keys
 
+  const char *firmware = THINX_FIRMWARE_VERSION;
   if (strlen(thinx_firmware_version) > 1) {
-    root["firmware"] = thinx_firmware_version;
-  } else {
-    root["firmware"] = THINX_FIRMWARE_VERSION;
+    firmware = thinx_firmware_version;
   }
 
+  char lat[16], lon[16], rssi[8];
+  dtostrf(latitude, 1, 2, lat);
+  dtostrf(longitude, 1, 2, lon);
+  int signal = WiFi.RSSI();
+  itoa(signal, rssi, 10);
+
+  // Flag for THiNX CI
+  #ifndef PLATFORMIO_IDE
+  // THINX_PLATFORM is not overwritten by builder in Arduino IDE
+  const char *platform = "arduino";
+  #else
+  const char *platform = THINX_PLATFORM;
+  #endif
+
+  #ifdef __USE_DELTA_CHECKIN__
+
+  // Sends only fields changed since last acknowledged checkin; MAC always identifies the device
+  bool delta = (checkin_state.magic == THINX_CHECKIN_STATE_MAGIC);
+  if (delta) {
+    char state[9];
+    sprintf(state, "%08x", checkin_state_hash());
+    thinx_set(wrapper, thinx_registration::state, state); // char[] is duplicated into jsonBuffer
+  }
+
+  thinx_set(wrapper, thinx_registration::mac, thinx_mac());
+  checkin_field(wrapper, 0, thinx_registration::mac, thinx_mac());   // re-sets the same key, tracks hash only
+  checkin_field(wrapper, 1, thinx_registration::firmware, firmware);
+  checkin_field(wrapper, 2, thinx_registration::version, (strlen(thinx_firmware_version_short) > 1) ? thinx_firmware_version_short : NULL);
+  checkin_field(wrapper, 3, thinx_registration::commit, (strlen(thx_commit_id) > 1) ? thx_commit_id : NULL);
+  checkin_field(wrapper, 4, thinx_registration::owner, (strlen(thinx_owner) > 1) ? thinx_owner : NULL);
+  checkin_field(wrapper, 5, thinx_registration::alias, (strlen(thinx_alias) > 1) ? thinx_alias : NULL);
+  checkin_field(wrapper, 6, thinx_registration::udid, (strlen(thinx_udid) > 4) ? thinx_udid : NULL);
+  checkin_field(wrapper, 7, thinx_registration::status, (statusString.length() > 0) ? statusString.c_str() : NULL);
+  checkin_field(wrapper, 8, thinx_registration::lat, lat);
+  checkin_field(wrapper, 9, thinx_registration::lon, lon);
+  checkin_field(wrapper, 10, thinx_registration::rssi, rssi, (uint32_t)(signal / 6 + 32)); // ignore jitter within 6 dB, never 0
+  checkin_field(wrapper, 11, thinx_registration::platform, platform);
+
+  #else
+
+  thinx_set(wrapper, thinx_registration::mac, thinx_mac());
+  thinx_set(wrapper, thinx_registration::firmware, firmware);
+
   if (strlen(thinx_firmware_version_short) > 1) {
-    root["version"] = thinx_firmware_version_short;
+    thinx_set(wrapper, thinx_registration::version, thinx_firmware_version_short);
   }
 
   if (strlen(thx_commit_id) > 1) {
-    root["commit"] = thx_commit_id;
+    thinx_set(wrapper, thinx_registration::commit, thx_commit_id);
   }
 
   if (strlen(thinx_owner) > 1) {
-    root["owner"] = thinx_owner;
+    thinx_set(wrapper, thinx_registration::owner, thinx_owner);
   }
 
   if (strlen(thinx_alias) > 1) {
-    root["alias"] = thinx_alias;
+    thinx_set(wrapper, thinx_registration::alias, thinx_alias);
   }
 
   if (strlen(thinx_udid) > 4) {
-    root["udid"] = thinx_udid;
+    thinx_set(wrapper, thinx_registration::udid, thinx_udid);
   }
 
   if (statusString.length() > 0) {
-    root["status"] = statusString.c_str();
+    thinx_set(wrapper, thinx_registration::status, statusString.c_str());
   }
 
   // Optional location data
-  root["lat"] = String(latitude);
-  root["lon"] = String(longitude);
+  thinx_set(wrapper, thinx_registration::lat, lat); // sent before lat[] goes out of scope
+  thinx_set(wrapper, thinx_registration::lon, lon);
 
-  root["rssi"] = String(WiFi.RSSI());
+  thinx_set(wrapper, thinx_registration::rssi, rssi);
   // root["snr"] = String(100 + WiFi.RSSI() / WiFi.RSSI()); // approximate only
 
-  // Flag for THiNX CI
-  #ifndef PLATFORMIO_IDE
-  // THINX_PLATFORM is not overwritten by builder in Arduino IDE
-  root["platform"] = "arduino";
-  #else
-  root["platform"] = strdup(THINX_PLATFORM);
-  #endif
-
-  DynamicJsonBuffer wrapperBuffer(1024);
-  JsonObject& wrapper = wrapperBuffer.createObject();
-  wrapper["registration"] = root;
+  thinx_set(wrapper, thinx_registration::platform, platform);
 
-#ifdef __DEBUG_JSON__
-  wrapper.printTo(Serial);
-  Serial.println();
-#endif
+  #endif
 
   json_output = "";
+  #ifdef __USE_MSGPACK__
+  if (msgpack_accepted) {
+    wrapper.msgPackTo(json_output); // binary, length is tracked by String
+    return json_output;
+  }
+  #endif
   wrapper.printTo(json_output);
+  THX_LOGD("Registration request: %s", json_output.c_str()); // truncated to THINX_LOG_LINE_SIZE
   return json_output;
 }
 
@@ -417,14 +1014,30 @@ void THiNX::senddata(String body) {
 
   // Serial.print("Sending data over HTTP to: "); Serial.println(thinx_cloud_url);
 
-  if (thx_wifi_client.connect(thinx_cloud_url, 7442)) {
+  IPAddress api_address;
+  if (!resolve(thinx_cloud_url, api_address)) {
+    THX_LOGE("API connection failed.");
+    return;
+  }
+
+  if (thx_wifi_client.connect(api_address, 7442)) {
 
     thx_wifi_client.println(F("POST /device/register HTTP/1.1"));
     thx_wifi_client.print(F("Host: ")); thx_wifi_client.println(thinx_cloud_url);
     thx_wifi_client.print(F("Authentication: ")); thx_wifi_client.println(thinx_api_key);
+    #ifdef __USE_MSGPACK__
+    thx_wifi_client.println(F("Accept: application/msgpack, application/json;q=0.9"));
+    thx_wifi_client.println(F("Origin: device"));
+    if (msgpack_accepted) {
+      thx_wifi_client.println(F("Content-Type: application/msgpack"));
+    } else {
+      thx_wifi_client.println(F("Content-Type: application/json"));
+    }
+    #else
     thx_wifi_client.println(F("Accept: application/json")); // application/json
     thx_wifi_client.println(F("Origin: device"));
     thx_wifi_client.println(F("Content-Type: application/json"));
+    #endif
     thx_wifi_client.println(F("User-Agent: THiNX-Client"));
     thx_wifi_client.println(F("Connection: close"));
     thx_wifi_client.print(F("Content-Length: "));
@@ -432,10 +1045,11 @@ void THiNX::senddata(String body) {
     thx_wifi_client.println();
     thx_wifi_client.println(body);
 
-    fetch_data();
+    fetch_data(thx_wifi_client);
 
   } else {
-    Serial.println(F("*TH: API connection failed."));
+    THX_LOGE("API connection failed.");
+    invalidate_address(thinx_cloud_url);
     return;
   }
 }
@@ -443,96 +1057,157 @@ void THiNX::senddata(String body) {
 /* Secure version */
 void THiNX::send_data(String body) {
 
-  char buf[512];
-  int pos = 0;
-
-  Serial.println(F("Secure API checkin..."));
+  THX_LOGI("Secure API checkin...");
 
+  // Connects by name so the handshake carries SNI; the cached address cannot be used here
   if (https_client.connect(thinx_cloud_url, 7443)) {
 
     // Load root certificate in DER format into WiFiClientSecure object
     bool res = https_client.setCACert_P(thx_ca_cert, thx_ca_cert_len);
     if (!res) {
-      Serial.println(F("*TH: Failed to load root CA certificate!"));
+      THX_LOGE("Failed to load root CA certificate!");
     }
 
     // Verify validity of server's certificate
     if (https_client.verifyCertChain(thinx_cloud_url)) {
-      Serial.println(F("*TH: Server certificate verified. Handshake will take about 120 seconds now... keep calm."));
+      THX_LOGI("Server certificate verified. Handshake will take about 120 seconds now... keep calm.");
     } else {
-      Serial.println(F("*TH: ERROR: certificate verification failed!"));
+      THX_LOGE("certificate verification failed!");
       return;
     }
 
     https_client.println(F("POST /device/register HTTP/1.1"));
     https_client.print(F("Host: ")); https_client.println(thinx_cloud_url);
     https_client.print(F("Authentication: ")); https_client.println(thinx_api_key);
+    #ifdef __USE_MSGPACK__
+    https_client.println(F("Accept: application/msgpack, application/json;q=0.9"));
+    https_client.println(F("Origin: device"));
+    if (msgpack_accepted) {
+      https_client.println(F("Content-Type: application/msgpack"));
+    } else {
+      https_client.println(F("Content-Type: application/json"));
+    }
+    #else
     https_client.println(F("Accept: application/json")); // application/json
     https_client.println(F("Origin: device"));
     https_client.println(F("Content-Type: application/json"));
+    #endif
     https_client.println(F("User-Agent: THiNX-Client"));
     https_client.print(F("Content-Length: "));
     https_client.println(body.length());
     https_client.println();
     https_client.println(body);
 
-    fetch_data();
+    fetch_data(https_client);
 
   } else {
-    Serial.println(F("*TH: API connection failed."));
+    THX_LOGE("API connection failed.");
     return;
   }
 }
 
-void THiNX::fetch_data() {
+void THiNX::fetch_data(Client &client) {
 
-  Serial.println(F("*TH: Waiting for API response..."));
+  THX_LOGI("Waiting for API response...");
 
-  char buf[1024];
-  int pos = 0;
-
-  long interval = 30000;
-  unsigned long currentMillis = millis(), previousMillis = millis();
+  // Body is copied out of the fetch buffer, so parsing and saving device info
+  // lease from an empty arena
+  String payload;
+  #ifdef __USE_MSGPACK__
+  uint8_t *packed = NULL;
+  size_t packed_length = 0;
+  #endif
 
-  // Wait until client available or timeout...
-  while(!thx_wifi_client.available()){
-    delay(1);
-    if( (currentMillis - previousMillis) > interval ){
-      thx_wifi_client.stop();
+  {
+    THiNXLease lease(THINX_FETCH_BUFFER_SIZE);
+    if (!lease.ok()) {
+      client.stop();
       return;
     }
-    currentMillis = millis();
-  }
+    char *buf = lease.c_str();
+    size_t pos = 0;
+
+    long interval = 30000;
+    unsigned long currentMillis = millis(), previousMillis = millis();
+
+    // Wait until client available or timeout...
+    while(!client.available()){
+      delay(1);
+      if( (currentMillis - previousMillis) > interval ){
+        client.stop();
+        return;
+      }
+      currentMillis = millis();
+    }
 
-  // Read while connected
-  bool headers_passed = false;
-  while ( thx_wifi_client.connected() ) {
-    String line = "    ";
-    // Wait for empty line to drop headers and process only JSON data in parser...
-    if (!headers_passed) {
-        line = thx_wifi_client.readStringUntil('\n');
-        //Serial.print("HEADERS > ");
-        //Serial.println(line);
-        if (line.length() < 3) {
-          headers_passed = true;
+    // Read while connected
+    bool headers_passed = false;
+    while ( client.connected() ) {
+      String line = "    ";
+      // Wait for empty line to drop headers and process only JSON data in parser...
+      if (!headers_passed) {
+          line = client.readStringUntil('\n');
+          //Serial.print("HEADERS > ");
+          //Serial.println(line);
+          if (line.startsWith("HTTP/")) {
+            checkin_status = line.substring(9, 12).toInt();
+          } else if (line.substring(0, 12).equalsIgnoreCase("Retry-After:")) { // header names are case-insensitive
+            retry_after = line.substring(12).toInt() * 1000UL; // HTTP-date form is ignored (0)
+          }
+          #ifdef __USE_MSGPACK__
+          else if (line.substring(0, 13).equalsIgnoreCase("Content-Type:")) {
+            // API answering in MessagePack accepts it in requests too
+            msgpack_accepted = (line.indexOf("application/msgpack") > 0);
+          }
+          #endif
+          if (line.length() < 3) {
+            headers_passed = true;
+          }
+      } else {
+        if ( client.available() ) {
+            int c = client.read();
+            if (pos < lease.size() - 1) {
+              buf[pos] = c;
+              pos++;
+            } // excess is drained and dropped
         }
-    } else {
-      if ( thx_wifi_client.available() ) {
-          buf[pos] = thx_wifi_client.read();
-          pos++;
       }
     }
-  }
 
-  buf[pos] = '\0'; // add null termination for any case...
+    buf[pos] = '\0'; // add null termination for any case...
+
+    client.stop(); // ??
 
-  thx_wifi_client.stop(); // ??
+    if (checkin_status == 304) {
+      THX_LOGI("Registration unchanged.");
+      return; // nothing to parse or persist
+    }
+
+    #ifdef __USE_MSGPACK__
+    if (msgpack_accepted) {
+      THX_LOGI("Received %u bytes (MessagePack)", pos);
+      packed = (uint8_t *) malloc(pos);
+      if (packed == NULL) {
+        return;
+      }
+      memcpy(packed, buf, pos);
+      packed_length = pos;
+    } else
+    #endif
+    {
+      THX_LOGI("Received %u bytes", pos);
+      payload = String(buf);
+    }
+  }
+
+  #ifdef __USE_MSGPACK__
+  if (packed != NULL) {
+    parse_msgpack(packed, packed_length);
+    free(packed);
+    return;
+  }
+  #endif
 
-  Serial.printf("*TH: Received %u bytes\n", pos);
-  //printStackHeap("allocating string");
-  String payload = String(buf);
-  Serial.println(payload);
-  //printStackHeap("string allocated");
   parse(payload);
 
 }
@@ -562,100 +1237,196 @@ void THiNX::parse(String payload) {
   int upd_index = payload.indexOf("{\"UPDATE\"");
   int not_index = payload.indexOf("{\"notification\"");
   int cfg_index = payload.indexOf("{\"configuration\"");
+  int log_index = payload.indexOf("{\"log\"");
   int undefined_owner = payload.indexOf("old_protocol_owner:-undefined-");
 
   if (upd_index > start_index) {
     start_index = upd_index;
-    Serial.println("ptype: UPDATE");
+    THX_LOGD("ptype: UPDATE");
     ptype = UPDATE;
   }
 
   if (reg_index > start_index) {
     start_index = reg_index;
     endIndex = payload.indexOf("}}") + 2;
-    Serial.println("ptype: REGISTRATION");
+    THX_LOGD("ptype: REGISTRATION");
     ptype = REGISTRATION;
   }
 
   if (not_index > start_index) {
     start_index = not_index;
     endIndex = payload.indexOf("}}") + 2; // is this still needed?
-    Serial.println("ptype: NOTIFICATION");
+    THX_LOGD("ptype: NOTIFICATION");
     ptype = NOTIFICATION;
   }
 
   if (cfg_index > start_index) {
     start_index = cfg_index;
     endIndex = payload.indexOf("}}") + 2; // is this still needed?
-    Serial.println("ptype: CONFIGURATION");
+    THX_LOGD("ptype: CONFIGURATION");
     ptype = CONFIGURATION;
   }
 
+  if (log_index > start_index) {
+    start_index = log_index;
+    endIndex = payload.length();
+    THX_LOGD("ptype: LOG");
+    ptype = LOG;
+  }
+
   if (ptype == Unknown) {
-    Serial.println("ptype: UNKNOWN! EXITING.");
+    THX_LOGW("ptype: UNKNOWN! EXITING.");
     return;
   }
 
   if (undefined_owner > start_index) {
-    Serial.println(F("ERROR: Not authorized. Please copy your owner_id into thinx.h from RTM Console > User Profile."));
+    THX_LOGE("Not authorized. Please copy your owner_id into thinx.h from RTM Console > User Profile.");
     return;
   }
 
   String body = payload.substring(start_index, endIndex);
 
-#ifdef __DEBUG__
-  Serial.print(F("*TH: Parsing response:\n'"));
-  Serial.print(body);
-  Serial.println("'");
-#endif
+  THX_LOGD("Parsing response: %s", body.c_str());
+
+  if ((ptype == REGISTRATION) || (ptype == UPDATE)) {
+    // Only schema members are stored, in a buffer sized for them at compile time
+    bool registration = (ptype == REGISTRATION);
+    THiNXJsonBuffer filterBuffer(registration ? thinx_registration_response::filter_capacity : thinx_update::filter_capacity);
+    JsonObject& filter = registration ? thinx_filter(filterBuffer, thinx_registration_response::fields)
+                                      : thinx_filter(filterBuffer, thinx_update::fields);
+    THiNXJsonBuffer jsonBuffer(registration ? thinx_registration_response::capacity : thinx_update::capacity);
+    JsonObject& root = jsonBuffer.parseObject(body.c_str(), filter);
+    bool valid = registration ? thinx_valid(root, thinx_registration_response::fields)
+                              : thinx_valid(root, thinx_update::fields);
+    if (!valid) {
+      THX_LOGW("Response does not fit its schema, rejected.");
+      return;
+    }
+    parse_payload(root, ptype, body);
+    return;
+  }
+
+  // strings are duplicated into the buffer, nodes need at most THINX_PARSE_SLACK more
+  if (body.length() > THINX_FETCH_BUFFER_SIZE) {
+    // MQTT pushes may be larger than the arena is sized for
+    THX_LOGI("Parsing %u bytes on the heap.", (unsigned) body.length());
+    DynamicJsonBuffer jsonBuffer(body.length() + THINX_PARSE_SLACK);
+    JsonObject& root = jsonBuffer.parseObject(body.c_str());
+    if ( !root.success() ) {
+      THX_LOGE("Failed parsing root node.");
+      return;
+    }
+    parse_payload(root, ptype, body);
+    return;
+  }
 
-  DynamicJsonBuffer jsonBuffer(1024);
+  THiNXJsonBuffer jsonBuffer(body.length() + THINX_PARSE_SLACK);
   JsonObject& root = jsonBuffer.parseObject(body.c_str());
 
   if ( !root.success() ) {
-    Serial.println(F("Failed parsing root node."));
+    THX_LOGE("Failed parsing root node.");
     return;
   }
 
+  parse_payload(root, ptype, body);
+}
+
+#ifdef __USE_MSGPACK__
+/*
+* Response Parser (MessagePack), same payloads as JSON
+*/
+
+void THiNX::parse_msgpack(const uint8_t *data, size_t length, String *json) {
+
+  if (length > THINX_FETCH_BUFFER_SIZE) {
+    // MQTT pushes may be larger than the arena is sized for
+    THX_LOGI("Parsing %u bytes on the heap.", (unsigned) length);
+    DynamicJsonBuffer jsonBuffer(length + THINX_PARSE_SLACK);
+    parse_msgpack_root(jsonBuffer.parseMsgPackObject(data, length), json);
+    return;
+  }
+
+  THiNXJsonBuffer jsonBuffer(length + THINX_PARSE_SLACK);
+  parse_msgpack_root(jsonBuffer.parseMsgPackObject(data, length), json);
+}
+
+void THiNX::parse_msgpack_root(JsonObject &root, String *json) {
+
+  if ( !root.success() ) {
+    THX_LOGE("Failed parsing MessagePack root node.");
+    return;
+  }
+
+  if (json != NULL) {
+    root.printTo(*json); // callback API is JSON
+  }
+
+  payload_type ptype = Unknown;
+  if (root.containsKey("UPDATE")) {
+    ptype = UPDATE;
+  } else if (root.containsKey("registration")) {
+    ptype = REGISTRATION;
+  } else if (root.containsKey("notification")) {
+    ptype = NOTIFICATION;
+  } else if (root.containsKey("configuration")) {
+    ptype = CONFIGURATION;
+  } else if (root.containsKey("log")) {
+    ptype = LOG;
+  } else {
+    THX_LOGW("ptype: UNKNOWN! EXITING.");
+    return;
+  }
+
+  if (((ptype == REGISTRATION) && !thinx_valid(root, thinx_registration_response::fields)) ||
+      ((ptype == UPDATE) && !thinx_valid(root, thinx_update::fields))) {
+    THX_LOGW("Response does not fit its schema, rejected.");
+    return;
+  }
+
+  String body = ""; // rendered as JSON only if configuration callback needs it
+  parse_payload(root, ptype, body);
+}
+#endif
+
+void THiNX::parse_payload(JsonObject &root, payload_type ptype, String &body) {
+
   switch (ptype) {
 
     case UPDATE: {
 
-      Serial.println(F("ptype case UPDATE")); Serial.flush();
+      THX_LOGD("ptype case UPDATE");
 
-      JsonObject& update = root["registration"];
+      THX_LOGD("TODO: Parse update payload...");
 
-      Serial.println(F("TODO: Parse update payload..."));
-
-      String mac = update["mac"];
+      String mac = thinx_get(root, thinx_update::mac);
       String this_mac = String(thinx_mac());
-      Serial.println(String("mac: ") + mac);
+      THX_LOGD("mac: %s", mac.c_str());
 
       if (!mac.equals(this_mac)) {
-        Serial.println(F("*TH: Warning: firmware is dedicated to device with different MAC."));
+        THX_LOGW("firmware is dedicated to device with different MAC.");
       }
 
-      String udid = root["udid"];
+      String udid = thinx_get(root, thinx_update::udid);
       if ( udid.length() > 4 ) {
         thinx_udid = strdup(udid.c_str());
       }
 
       // Check current firmware based on commit id and store Updated state...
-      String commit = update["commit"];
-      Serial.println(String("commit: ") + commit);
+      String commit = thinx_get(root, thinx_update::commit);
+      THX_LOGD("commit: %s", commit.c_str());
 
       // Check current firmware based on version and store Updated state...
-      String version = update["version"];
-      Serial.println(String("version: ") + version);
+      String version = thinx_get(root, thinx_update::version);
+      THX_LOGD("version: %s", version.c_str());
 
       //if ((commit == thinx_commit_id) && (version == thinx_version_id)) { WHY?
       if (strlen(available_update_url) > 5) {
-        Serial.println(F("*TH: firmware has same thx_commit_id as current and update availability is stored. Firmware has been installed."));
+        THX_LOGI("firmware has same thx_commit_id as current and update availability is stored. Firmware has been installed.");
         available_update_url = strdup("");
         notify_on_successful_update();
         return;
       } else {
-        Serial.println(F("*TH: Info: firmware has same thx_commit_id as current and no update is available."));
+        THX_LOGI("Info: firmware has same thx_commit_id as current and no update is available.");
       }
 
       save_device_info();
@@ -664,9 +1435,9 @@ void THiNX::parse(String payload) {
       // we must ask user to commence firmware update.
       if (thinx_auto_update == false) {
         if (mqtt_client != NULL) {
-          Serial.println(F("*TH: Update availability notification..."));
+          THX_LOGI("Update availability notification...");
           mqtt_client->publish(
-            thinx_mqtt_channel().c_str(),
+            mqtt_device_channel,
             F("{ title: \"Update Available\", body: \"There is an update available for this device. Do you want to install it now?\", type: \"actionable\", response_type: \"bool\" }")
           );
           mqtt_client->loop();
@@ -674,7 +1445,7 @@ void THiNX::parse(String payload) {
 
       } else if (thinx_auto_update || thinx_forced_update){
 
-        Serial.println(F("*TH: Starting update A..."));
+        THX_LOGI("Starting update A...");
 
 
         // FROM LUA: update variants
@@ -683,30 +1454,30 @@ void THiNX::parse(String payload) {
         // local url   = payload['url']
         // local type  = payload['type']
 
-        String type = update["type"];
-        Serial.print(F("*TH: Payload type: ")); Serial.println(type);
+        String type = thinx_get(root, thinx_update::type);
+        THX_LOGI("Payload type: %s", type.c_str());
 
-        String files = update["files"];
+        String files = thinx_get(root, thinx_update::files);
 
-        String url = update["url"]; // may be OTT URL
+        String url = thinx_get(root, thinx_update::url); // may be OTT URL
         available_update_url = url.c_str();
 
-        String ott = update["ott"];
+        String ott = thinx_get(root, thinx_update::ott);
         available_update_url = ott.c_str();
 
-        String hash = update["hash"];
+        String hash = thinx_get(root, thinx_update::hash);
         if (hash.length() > 2) {
-          Serial.print(F("*TH: #")); Serial.println(hash);
+          THX_LOGD("#%s", hash.c_str());
           expected_hash = strdup(hash.c_str());
         }
 
-        String md5 = update["md5"];
+        String md5 = thinx_get(root, thinx_update::md5);
         if (md5.length() > 2) {
-          Serial.print(F("*TH: #")); Serial.println(md5);
+          THX_LOGD("#%s", md5.c_str());
           expected_md5 = strdup(md5.c_str());
         }
 
-        Serial.println(F("Saving device info before firmware update.")); Serial.flush();
+        THX_LOGI("Saving device info before firmware update.");
         save_device_info();
 
         if (url) {
@@ -716,8 +1487,7 @@ void THiNX::parse(String payload) {
           );
 
           mqtt_client->loop();
-          Serial.print(F("*TH: Force update URL must not contain HTTP!!!: "));
-          Serial.println(url);
+          THX_LOGW("Force update URL must not contain HTTP!!!: %s", url.c_str());
           url.replace("http://", "");
           // TODO: must not contain HTTP, extend with http://thinx.cloud/"
           update_and_reboot(url);
@@ -733,7 +1503,7 @@ void THiNX::parse(String payload) {
       JsonObject& notification = root["notification"];
 
       if ( !notification.success() ) {
-        Serial.println(F("*TH: Failed parsing notification node."));
+        THX_LOGE("Failed parsing notification node.");
         return;
       }
 
@@ -741,24 +1511,24 @@ void THiNX::parse(String payload) {
       if ((type == "bool") || (type == "boolean")) {
         bool response = notification["response"];
         if (response == true) {
-          Serial.println(F("*TH: User allowed update using boolean."));
+          THX_LOGI("User allowed update using boolean.");
           if (strlen(available_update_url) > 4) {
             update_and_reboot(available_update_url);
           }
         } else {
-          Serial.println(F("*TH: User denied update using boolean."));
+          THX_LOGI("User denied update using boolean.");
         }
       }
 
       if ((type == "string") || (type == "String")) {
         String response = notification["response"];
         if (response == "yes") {
-          Serial.println(F("*TH: User allowed update using string."));
+          THX_LOGI("User allowed update using string.");
           if (strlen(available_update_url) > 4) {
             update_and_reboot(available_update_url);
           }
         } else if (response == "no") {
-          Serial.println(F("*TH: User denied update using string."));
+          THX_LOGI("User denied update using string.");
         }
       }
 
@@ -769,45 +1539,60 @@ void THiNX::parse(String payload) {
       JsonObject& registration = root["registration"];
 
       if ( !registration.success() ) {
-        Serial.println(F("*TH: Failed parsing registration node."));
+        THX_LOGE("Failed parsing registration node.");
         return;
       }
 
-      bool success = registration["success"];
-      String status = registration["status"];
+      bool success = thinx_get(root, thinx_registration_response::success);
+      String status = thinx_get(root, thinx_registration_response::status);
+
+      if (status == "UNCHANGED") {
+        // Delta checkin acknowledged, device record is current
+        return;
 
-      if (status == "OK") {
+      } else if (status == "OK") {
 
-        String alias = registration["alias"];
+        String alias = thinx_get(root, thinx_registration_response::alias);
         if ( alias.length() > 1 ) {
           thinx_alias = strdup(alias.c_str());
         }
 
-        String owner = registration["owner"];
+        String owner = thinx_get(root, thinx_registration_response::owner);
         if ( owner.length() > 1 ) {
+          #ifdef __USE_MQTT_SESSION__
+          if (!owner.equals(thinx_owner)) {
+            mqtt_clean_session = true; // stored session is subscribed to the old device channel
+          }
+          #endif
           thinx_owner = strdup(owner.c_str());
         }
 
-        String udid = registration["udid"];
+        String udid = thinx_get(root, thinx_registration_response::udid);
         if ( udid.length() > 4 ) {
+          #ifdef __USE_MQTT_SESSION__
+          if (!udid.equals(thinx_udid)) {
+            mqtt_clean_session = true;
+          }
+          #endif
           thinx_udid = strdup(udid.c_str());
         }
 
-        if (registration.containsKey(F("auto_update"))) {
-          thinx_auto_update = (bool)registration[F("auto_update")];
+        if (thinx_has(root, thinx_registration_response::auto_update)) {
+          thinx_auto_update = thinx_get(root, thinx_registration_response::auto_update);
+        }
+
+        if (thinx_has(root, thinx_registration_response::forced_update)) {
+          thinx_forced_update = thinx_get(root, thinx_registration_response::forced_update);
         }
 
-        if (registration.containsKey(F("forced_update"))) {
-          thinx_forced_update = (bool)registration[F("forced_update")];
+        if (thinx_has(root, thinx_registration_response::next_checkin)) {
+          checkin_hint = thinx_get(root, thinx_registration_response::next_checkin) * 1000UL;
         }
 
-        if (registration.containsKey(F("timestamp"))) {
-          Serial.print(F("*TH: Updating THiNX time: "));
-          last_checkin_timestamp = (long)registration[F("timestamp")] + timezone_offset * 3600;
+        if (thinx_has(root, thinx_registration_response::timestamp)) {
+          last_checkin_timestamp = thinx_get(root, thinx_registration_response::timestamp) + timezone_offset * 3600;
           last_checkin_millis = millis();
-          Serial.print(thinx_time(NULL));
-          Serial.print(" ");
-          Serial.println(thinx_date(NULL));
+          THX_LOGI("Updating THiNX time: %s %s", thinx_time(NULL).c_str(), thinx_date(NULL).c_str());
         }
 
         save_device_info();
@@ -816,60 +1601,59 @@ void THiNX::parse(String payload) {
 
         // Warning, this branch may be deprecated!
 
-        String udid = registration["udid"];
+        String udid = thinx_get(root, thinx_registration_response::udid);
         if ( udid.length() > 4 ) {
           thinx_udid = strdup(udid.c_str());
         }
 
-        Serial.println(F("Saving device info for update.")); Serial.flush();
+        THX_LOGI("Saving device info for update.");
         save_device_info();
 
-        String mac = registration["mac"];
-        Serial.println(String("*TH: Update for MAC: ") + mac);
+        String mac = thinx_get(root, thinx_registration_response::mac);
+        THX_LOGI("Update for MAC: %s", mac.c_str());
         // TODO: must be current or 'ANY'
 
         // commit should not be same except for forced update
-        String commit = registration["commit"];
-        Serial.println(String("commit: ") + commit);
+        String commit = thinx_get(root, thinx_registration_response::commit);
+        THX_LOGD("commit: %s", commit.c_str());
         if (commit == thinx_commit_id) {
-          Serial.println(F("*TH: Info: new firmware has same thx_commit_id as current."));
+          THX_LOGI("Info: new firmware has same thx_commit_id as current.");
         }
 
-        String version = registration["version"];
-        Serial.println(String(F("*TH: version: ")) + version);
+        String version = thinx_get(root, thinx_registration_response::version);
+        THX_LOGI("version: %s", version.c_str());
 
         if (thinx_auto_update == false) {
-          Serial.println(String(F("*TH: Skipping auto-update (disabled).")));
+          THX_LOGI("Skipping auto-update (disabled).");
           return;
         }
 
         String update_url;
 
-        String url = registration["url"];
+        String url = thinx_get(root, thinx_registration_response::url);
         if (url.length() > 2) {
-          Serial.println(F("*TH: Starting direct update..."));
+          THX_LOGI("Starting direct update...");
           update_url = url;
         }
 
-        String ott = registration["ott"];
+        String ott = thinx_get(root, thinx_registration_response::ott);
         if (ott.length() > 2) {
-          Serial.println(F("*TH: Starting OTT update..."));
+          THX_LOGI("Starting OTT update...");
           update_url = "http://thinx.cloud:7442/device/firmware?ott="+ott;
         }
 
-        String hash = registration["hash"];
+        String hash = thinx_get(root, thinx_registration_response::hash);
         if (hash.length() > 2) {
-          Serial.print(F("*TH: #")); Serial.println(hash);
+          THX_LOGD("#%s", hash.c_str());
           expected_hash = strdup(hash.c_str());
         }
 
-        String md5 = registration["md5"];
+        String md5 = thinx_get(root, thinx_registration_response::md5);
         if (md5.length() > 2) {
-          Serial.print(F("*TH: #")); Serial.println(md5);
+          THX_LOGD("#%s", md5.c_str());
           expected_md5 = strdup(md5.c_str());
         }
 
-        Serial.println(update_url);
         update_and_reboot(update_url);
         return;
 
@@ -882,43 +1666,56 @@ void THiNX::parse(String payload) {
       JsonObject& configuration = root["configuration"];
 
       if ( !configuration.success() ) {
-        Serial.println(F("*TH: Failed parsing configuration node."));
+        THX_LOGE("Failed parsing configuration node.");
         return;
       }
 
 
+      #ifdef __USE_ENV_STORE__
+      // repeated pushes of the same configuration store nothing and run no handlers,
+      // the config callback still gets every push (apps may keep it in RAM only)
+      if (apply_env(configuration) == 0) {
+        THX_LOGI("Configuration unchanged.");
+      }
+      #endif
+
       #ifdef __ENABLE_WIFI_MIGRATION__
       //
       // Built-in support for WiFi migration
       //
 
-      const char *ssid = configuration["THINX_ENV_SSID"];
-      const char *pass = configuration["THINX_ENV_PASS"];
+      #ifdef __USE_ENV_STORE__
+      // only when credentials changed, the other one may come from an earlier push
+      char ssid[THINX_ENV_VALUE_SIZE] = {0};
+      char pass[THINX_ENV_VALUE_SIZE] = {0};
+      if (envChanged("THINX_ENV_SSID") || envChanged("THINX_ENV_PASS")) {
+        env("THINX_ENV_SSID", ssid, sizeof(ssid));
+        env("THINX_ENV_PASS", pass, sizeof(pass));
+      }
+      #else
+      const char *ssid = configuration["THINX_ENV_SSID"] | "";
+      const char *pass = configuration["THINX_ENV_PASS"] | "";
+      #endif
 
       // password may be empty string
       if ((strlen(ssid) > 2) && (strlen(pass) > 0)) {
-        WiFi.disconnect();
-        WiFi.begin(ssid, pass);
-        long timeout = millis() + 20000;
-        Serial.println(F("*TH: Attempting WiFi migration..."));
-        while (WiFi.status() != WL_CONNECTED) {
-          yield();
-          if (millis() > timeout) break;
-        }
-        if (WiFi.status() != WL_CONNECTED) {
-          Serial.println(F("*TH: WiFi migration failed."));
-        } else {
-          Serial.println(F("*TH: WiFi migration successful.")); // TODO: Notify using publish() to device status topic
-        }
+        migrate_wifi(ssid, pass); // network is switched from loop(), not inside MQTT callback
       }
       #endif
       // Forward update body to the library user
       if (_config_callback != NULL) {
+        if (body.length() == 0) {
+          root.printTo(body); // callback API is JSON
+        }
         _config_callback(body);
       }
 
     } break;
 
+    case LOG: {
+      publish_log(root["log"] | THINX_LOG_TAIL_LINES);
+    } break;
+
     default:
     break;
   }
@@ -926,24 +1723,218 @@ void THiNX::parse(String payload) {
 }
 
 /*
-* MQTT channel names
+* Remote log, {"log": lines} on device channel is answered with the newest lines on status topic
+*/
+
+void THiNX::publish_log(int lines) {
+  if ((lines <= 0) || (lines > THINX_LOG_TAIL_LINES)) {
+    lines = THINX_LOG_TAIL_LINES;
+  }
+  THiNXLease lease(THINX_LOG_TAIL_SIZE);
+  if (!lease.ok()) {
+    return;
+  }
+  char *text = lease.c_str();
+  THiNXLog::tail(text, lease.size(), lines);
+
+  THiNXJsonBuffer jsonBuffer(JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(THINX_LOG_TAIL_LINES));
+  JsonObject& message = jsonBuffer.createObject();
+  message["status"] = "log";
+  message["dropped"] = THiNXLog::dropped();
+  JsonArray& list = message.createNestedArray("lines");
+  while (*text) {
+    char *end = strchr(text, '\n');
+    *end = 0; // every line ends with '\n'
+    list.add((const char *) text);
+    text = end + 1;
+  }
+  publish_status(message, false);
+}
+
+#ifdef __ENABLE_WIFI_MIGRATION__
+
+/*
+* WiFi migration, pushed credentials must connect before deadline or the last working ones are restored
+*/
+
+void THiNX::migrate_wifi(const char *ssid, const char *pass) {
+  if ((strlen(ssid) >= sizeof(wifi_migration_ssid)) || (strlen(pass) >= sizeof(wifi_migration_pass))) {
+    THX_LOGW("WiFi credentials too long, not migrating.");
+    return;
+  }
+  // a push during migration keeps the original rollback target
+  if (wifi_migration == MIGRATION_IDLE) {
+    strlcpy(wifi_rollback_ssid, WiFi.SSID().c_str(), sizeof(wifi_rollback_ssid));
+    strlcpy(wifi_rollback_pass, WiFi.psk().c_str(), sizeof(wifi_rollback_pass));
+  }
+  strcpy(wifi_migration_ssid, ssid);
+  strcpy(wifi_migration_pass, pass);
+  wifi_migration = MIGRATION_PENDING;
+}
+
+bool THiNX::wifi_migration_step() {
+  if (wifi_migration == MIGRATION_IDLE) {
+    return false;
+  }
+
+  if (wifi_migration == MIGRATION_PENDING) {
+    THX_LOGI("Attempting WiFi migration to %s", wifi_migration_ssid);
+    WiFi.disconnect();
+    WiFi.begin(wifi_migration_ssid, wifi_migration_pass);
+    wifi_migration_deadline = millis() + THINX_WIFI_MIGRATION_TIMEOUT;
+    wifi_migration = MIGRATION_CONNECTING;
+    return true;
+  }
+
+  if (WiFi.status() == WL_CONNECTED) {
+    wifi_migration_result = (wifi_migration == MIGRATION_CONNECTING) ? "migrated" : "rolled_back";
+    THX_LOGI("WiFi migration finished: %s", wifi_migration_result);
+  } else if ((long)(millis() - wifi_migration_deadline) < 0) {
+    return true;
+  } else if ((wifi_migration == MIGRATION_CONNECTING) && (strlen(wifi_rollback_ssid) > 0)) {
+    THX_LOGW("WiFi migration failed, rolling back to %s", wifi_rollback_ssid);
+    WiFi.disconnect();
+    WiFi.begin(wifi_rollback_ssid, wifi_rollback_pass);
+    wifi_migration_deadline = millis() + THINX_WIFI_MIGRATION_TIMEOUT;
+    wifi_migration = MIGRATION_ROLLBACK;
+    return true;
+  } else {
+    wifi_migration_result = "failed";
+    THX_LOGE("WiFi migration failed.");
+  }
+
+  wifi_migration = MIGRATION_IDLE;
+
+  #ifdef __USE_WIFI_STORE__
+  if (WiFi.status() == WL_CONNECTED) {
+    remember_network();
+  }
+  #endif
+
+  // MQTT session does not survive the network change
+  if (mqtt_client != NULL) {
+    mqtt_client->disconnect();
+  }
+  mqtt_connected = false;
+  mqtt_state = MQTT_IDLE; // reconnected by CONNECT_MQTT phase
+  wifi_connected = (WiFi.status() == WL_CONNECTED);
+  if (!wifi_connected) {
+    wifi_connection_in_progress = false;
+    thinx_phase = CONNECT_WIFI;
+  } else if (thinx_phase > CONNECT_MQTT) {
+    thinx_phase = CONNECT_MQTT;
+  }
+  return false;
+}
+
+void THiNX::publish_wifi_migration() {
+  if (wifi_migration_result == NULL) {
+    return;
+  }
+  THiNXJsonBuffer jsonBuffer(JSON_OBJECT_SIZE(3));
+  JsonObject& message = jsonBuffer.createObject();
+  message["status"] = "wifi_migration";
+  message["result"] = wifi_migration_result;
+  message["ssid"] = (const char *) wifi_migration_ssid;
+  publish_status(message, false);
+  wifi_migration_result = NULL;
+}
+
+#endif
+
+/*
+* MQTT channel names, formatted by build_topics() when MQTT starts
 */
 
 String THiNX::thinx_mqtt_channel() {
-  sprintf(mqtt_device_channel, "/%s/%s", thinx_owner, thinx_udid);
   return String(mqtt_device_channel);
 }
 
 String THiNX::thinx_mqtt_channels() {
-  sprintf(mqtt_device_channels, "/%s/%s/#", thinx_owner, thinx_udid);
   return String(mqtt_device_channels);
 }
 
 String THiNX::thinx_mqtt_status_channel() {
-  sprintf(mqtt_device_status_channel, "/%s/%s/status", thinx_owner, thinx_udid);
   return String(mqtt_device_status_channel);
 }
 
+void THiNX::build_topics() {
+  sprintf(mqtt_device_channel, "/%s/%s", thinx_owner, thinx_udid);
+  sprintf(mqtt_device_channels, "/%s/%s/#", thinx_owner, thinx_udid);
+  sprintf(mqtt_device_status_channel, "/%s/%s/status", thinx_owner, thinx_udid);
+
+  size_t prefix = strlen(mqtt_device_channel) + 1; // with trailing '/'
+  if ((strlen(thinx_owner) < 4) || (strlen(thinx_udid) < 4)) {
+    prefix = 0; // not registered yet
+  }
+  if (topic_count == 0) {
+    topic_prefix_length = prefix; // nothing to lay out yet
+    return;
+  }
+  if ((prefix == topic_prefix_length) && ((prefix == 0) || (strncmp(topic_pool, mqtt_device_channel, prefix - 1) == 0))) {
+    return; // registered topics are up to date
+  }
+
+  // sub-topics are copied aside and laid out again behind the new prefix
+  THiNXLease lease(sizeof(topic_pool));
+  if (!lease.ok()) {
+    return;
+  }
+  char *old = lease.c_str();
+  memcpy(old, topic_pool, sizeof(topic_pool));
+  size_t pos = 0;
+  for (uint8_t i = 0; i < topic_count; i++) {
+    const char *subtopic = old + topic_offset[i] + topic_prefix_length;
+    size_t length = prefix + strlen(subtopic);
+    topic_offset[i] = pos;
+    if ((topic_length[i] == 0) || (length > 255) || (pos + length + 1 > sizeof(topic_pool))) {
+      THX_LOGE("Topic %s does not fit, not publishing.", subtopic);
+      topic_length[i] = 0;
+      topic_pool[pos] = 0;
+      continue; // cannot be recovered, sub-topic is lost
+    }
+    memcpy(topic_pool + pos, mqtt_device_channel, prefix); // '/' overwritten below
+    topic_pool[pos + prefix - 1] = '/';
+    strcpy(topic_pool + pos + prefix, subtopic);
+    topic_length[i] = length;
+    pos += length + 1;
+  }
+  topic_prefix_length = prefix;
+}
+
+thinx_topic_t THiNX::find_topic(const char *subtopic) {
+  for (uint8_t i = 0; i < topic_count; i++) {
+    if ((topic_length[i] > 0) && (strcmp(topic_pool + topic_offset[i] + topic_prefix_length, subtopic) == 0)) {
+      return i;
+    }
+  }
+  return THINX_TOPIC_NONE;
+}
+
+thinx_topic_t THiNX::registerTopic(const char *subtopic) {
+  thinx_topic_t existing = find_topic(subtopic);
+  if (existing != THINX_TOPIC_NONE) {
+    return existing;
+  }
+  size_t pos = 0;
+  if (topic_count > 0) {
+    pos = topic_offset[topic_count - 1] + strlen(topic_pool + topic_offset[topic_count - 1]) + 1;
+  }
+  size_t length = topic_prefix_length + strlen(subtopic);
+  if ((topic_count >= THINX_TOPICS) || (length > 255) || (pos + length + 1 > sizeof(topic_pool))) {
+    THX_LOGE("Topic registry full, %s not registered.", subtopic);
+    return THINX_TOPIC_NONE;
+  }
+  if (topic_prefix_length > 0) {
+    memcpy(topic_pool + pos, mqtt_device_channel, topic_prefix_length);
+    topic_pool[pos + topic_prefix_length - 1] = '/';
+  }
+  strcpy(topic_pool + pos + topic_prefix_length, subtopic);
+  topic_offset[topic_count] = pos;
+  topic_length[topic_count] = length;
+  return topic_count++;
+}
+
 long THiNX::epoch() {
   long since_last_checkin = (millis() - last_checkin_millis) / 1000;
   return last_checkin_timestamp + since_last_checkin;
@@ -961,7 +1952,7 @@ String THiNX::thinx_time(const char* optional_format) {
   char res[32];
   (void) localtime_r(&stamp, &lt);
   if (strftime(res, sizeof(res), format, &lt) == 0) {
-      Serial.println(F("cannot format supplied time into buffer"));
+      THX_LOGE("cannot format supplied time into buffer");
   }
   return String(res);
 }
@@ -978,7 +1969,7 @@ String THiNX::thinx_date(const char* optional_format) {
   char res[32];
   (void) localtime_r(&stamp, &lt);
   if (strftime(res, sizeof(res), format, &lt) == 0) {
-      Serial.println(F("cannot format supplied date into buffer"));
+      THX_LOGE("cannot format supplied date into buffer");
   }
   return String(res);
 }
@@ -998,14 +1989,14 @@ const char * THiNX::thinx_mac() {
 
 void THiNX::notify_on_successful_update() {
   if (mqtt_client != NULL) {
-    Serial.println(F("*TH: notify_on_successful_update()"));
+    THX_LOGI("notify_on_successful_update()");
     mqtt_client->publish(
       mqtt_device_status_channel,
       F("{ title: \"Update Successful\", body: \"The device has been successfully updated.\", type: \"success\" }")
     );
     mqtt_client->loop();
   } else {
-    Serial.println(F("*TH: Device updated but MQTT not active to notify. TODO: Store."));
+    THX_LOGI("Device updated but MQTT not active to notify. TODO: Store.");
   }
 }
 
@@ -1022,6 +2013,22 @@ void THiNX::publishStatusUnretained(String message) {
   publishStatusRetain(message, false);
 }
 
+// Topic bytes come prebuilt from the pool, nothing is formatted or allocated per call
+bool THiNX::publish(thinx_topic_t topic, const uint8_t *payload, size_t length, bool retain) {
+  if ((topic >= topic_count) || (topic_length[topic] == 0)) {
+    return false;
+  }
+  if ((mqtt_state == MQTT_UP) && (topic_prefix_length > 0) &&
+      mqtt_client->publish(topic_pool + topic_offset[topic], topic_length[topic], payload, length, retain)) {
+    return true;
+  }
+  return queue_pending(topic, payload, length, retain); // sent once MQTT is back
+}
+
+bool THiNX::publish(thinx_topic_t topic, const char *message, bool retain) {
+  return publish(topic, (const uint8_t *) message, strlen(message), retain);
+}
+
 void THiNX::publish_status_unretained(char *message) {
   publish_status(message, false);
 }
@@ -1038,54 +2045,77 @@ void THiNX::publishStatusRetain(String message, bool retain) {
     }
     mqtt_client->loop();
   } else {
-    Serial.println(F("*TH: MQTT not active while trying to publish retained status."));
+    THX_LOGI("MQTT not active while trying to publish retained status.");
   }
 }
 
 void THiNX::publish_status(char *message, bool retain) {
-  Serial.println(F("*TH: publish_status")); Serial.flush();
-  if (mqtt_client != NULL) {
-    if (!mqtt_client->connected()) {
-      Serial.println(F("*TH: MQTT cannot publish messages while not connected."));
-    }
-    if (retain) {
-      mqtt_client->publish(
-        MQTT::Publish(mqtt_device_status_channel, message).set_retain()
-      );
-    } else {
-      mqtt_client->publish(mqtt_device_status_channel, message); // this is weird but already tried to use object in retain version and does not consume
+  THX_LOGD("publish_status");
+  if (!publish(THINX_TOPIC_STATUS, (const char *) message, retain)) {
+    THX_LOGE("MQTT status neither published nor queued.");
+  }
+}
+
+// Serializes straight into the MQTT client a window at a time, large status
+// documents never exist as a whole in RAM
+void THiNX::publish_status(JsonObject &message, bool retain) {
+  size_t length = message.measureLength();
+  if (mqtt_state != MQTT_UP) {
+    // sent after reconnect if it fits the pending buffer
+    THiNXLease lease(length + 1);
+    if (lease.ok()) {
+      message.printTo(lease.c_str(), length + 1);
+      publish(THINX_TOPIC_STATUS, lease.bytes(), length, retain);
     }
-    mqtt_client->loop();
-  } else {
-    Serial.println(F("*TH: MQTT not active while trying to publish retained status."));
+    return;
   }
+  mqtt_client->publish(mqtt_device_status_channel, [&message, length](Client &client) {
+    // header already promised length bytes, a short or long payload cannot be
+    // resynchronised, so the connection is dropped instead
+    THiNXLease window(THINX_STREAM_WINDOW_SIZE);
+    if (!window.ok()) {
+      client.stop();
+      return false;
+    }
+    ChunkedJsonSerializer serializer(message);
+    while (size_t n = serializer.next(window.c_str(), window.size())) {
+      if ((serializer.bytesWritten() > length) || (client.write(window.bytes(), n) != n)) {
+        client.stop();
+        return false;
+      }
+    }
+    if (serializer.overflowed() || (serializer.bytesWritten() != length)) {
+      THX_LOGE("MQTT status sent %u of %u bytes, nested too deep.", serializer.bytesWritten(), length);
+      client.stop();
+      return false;
+    }
+    return true;
+  }, length, retain);
+  mqtt_client->loop();
 }
 
 /*
 * Sends a MQTT message to the Device Channel (/owner/udid)
 */
 
-// Old version, leaks strings, deprecated.
+// Old version, deprecated.
 void THiNX::publish(String message, String topic, bool retain)  {
-  String channel = String(mqtt_device_channel) + String("/") + String(topic);
-  if (mqtt_client != NULL) {
-    if (retain == true) {
-      mqtt_client->publish(
-        MQTT::Publish(channel.c_str(), message.c_str()).set_retain()
-      );
-    } else {
-      mqtt_client->publish(
-        channel.c_str(), message.c_str()
-      );
-    }
-    mqtt_client->loop();
-  } else {
-    Serial.println(F("*TH: MQTT not active while trying to publish message."));
-  }
+  publish((char *) message.c_str(), (char *) topic.c_str(), retain);
 }
 
 void THiNX::publish(char * message, char * topic, bool retain)  {
-  char channel[256] = {0};
+  thinx_topic_t registered = find_topic(topic);
+  if ((registered != THINX_TOPIC_NONE) && (topic_prefix_length > 0)) {
+    if (publish(registered, message, retain)) {
+      mqtt_client->loop();
+    }
+    return;
+  }
+  THiNXLease lease(strlen(mqtt_device_channel) + strlen(topic) + 2);
+  if (!lease.ok()) {
+    return;
+  }
+  char *channel = lease.c_str();
   sprintf(channel, "%s/%s", mqtt_device_channel, topic);
   if (mqtt_client != NULL) {
     if (retain == true) {
@@ -1099,7 +2129,7 @@ void THiNX::publish(char * message, char * topic, bool retain)  {
     }
     mqtt_client->loop();
   } else {
-    Serial.println(F("*TH: MQTT not active while trying to publish message."));
+    THX_LOGI("MQTT not active while trying to publish message.");
   }
 }
 
@@ -1112,59 +2142,54 @@ void setLastWill(String nextWill) {
 }
 
 void THiNX::setLastWill(String nextWill) {
+  lastWill = nextWill;
+  if ((mqtt_state != MQTT_IDLE) && (mqtt_client != NULL)) {
+    // reconnects at once, the will is part of CONNECT
     mqtt_client->disconnect();
-    start_mqtt();
-}
-
-bool THiNX::start_mqtt() {
-
-  if (mqtt_client != NULL) {
-    Serial.println(F("*TH: start_mqtt")); Serial.flush();
-    mqtt_connected = mqtt_client->connected();
-    if (mqtt_connected) {
-      return true;
-    }
+    mqtt_connected = false;
+    mqtt_backoff_delay = 0;
+    mqtt_state = MQTT_BACKOFF;
+    mqtt_retry_at = millis();
   }
+}
+
+bool THiNX::start_mqtt() {
 
   if (strlen(thinx_udid) < 4) {
-    Serial.println(F("*TH: MQTT NO-UDID!")); Serial.flush();
+    THX_LOGW("MQTT NO-UDID!");
     return false;
   }
 
-  if (forceHTTP == true) {
-    Serial.println(F("*TH: Contacting MQTT server over HTTP..."));
-    mqtt_client = new PubSubClient(thx_wifi_client, thinx_mqtt_url);
-  } else {
-    Serial.println(F("*TH: Contacting MQTT server over HTTPS..."));
-    bool res = https_client.setCACert_P(thx_ca_cert, thx_ca_cert_len);
-    if (res) {
-      mqtt_client = new PubSubClient(https_client, thinx_mqtt_url);
-    } else {
-      Serial.println(F("*TH: Failed to load root CA certificate for MQTT!"));
-    }
-  }
-
   if (strlen(thinx_api_key) < 5) {
-    Serial.println(F("*TH: API Key not set, exiting."));
+    THX_LOGW("API Key not set, exiting.");
     return false;
   }
 
-  int willQos = 0;
-  bool willRetain = false;
-
-  if (mqtt_client->connect(MQTT::Connect(thinx_mac())
-    .set_will(thinx_mqtt_status_channel().c_str(), lastWill.c_str())
-    .set_auth(thinx_udid, thinx_api_key)
-    .set_keepalive(120))) {
+  // TLS connects by name so the handshake carries SNI, only plain MQTT uses the cached address
+  IPAddress mqtt_address;
+  if ((forceHTTP == true) && !resolve(thinx_mqtt_url, mqtt_address)) {
+    return false;
+  }
 
-    mqtt_connected = true;
-    performed_mqtt_checkin = true;
+  // one client for the lifetime of the library, reconnects reuse it
+  if (mqtt_client == NULL) {
+    if (forceHTTP == true) {
+      THX_LOGI("Contacting MQTT server over HTTP...");
+      mqtt_client = new PubSubClient(thx_wifi_client);
+    } else {
+      THX_LOGI("Contacting MQTT server over HTTPS...");
+      if (!https_client.setCACert_P(thx_ca_cert, thx_ca_cert_len)) {
+        THX_LOGE("Failed to load root CA certificate for MQTT!");
+        return false;
+      }
+      mqtt_client = new PubSubClient(https_client);
+    }
 
     mqtt_client->set_callback([this](const MQTT::Publish &pub){
 
       // Stream has been never tested so far...
       if (pub.has_stream()) {
-        Serial.println(F("*TH: MQTT Type: Stream..."));
+        THX_LOGI("MQTT Type: Stream...");
         uint32_t startTime = millis();
         uint32_t size = pub.payload_len();
         if ( ESP.updateSketch(*pub.payload_stream(), size, true, false) ) {
@@ -1175,10 +2200,11 @@ bool THiNX::start_mqtt() {
           );
           mqtt_client->disconnect();
           pub.payload_stream()->stop();
-          Serial.printf("Update Success: %u\nRebooting...\n", millis() - startTime);
+          THX_LOGI("Update Success: %lu ms, rebooting...", (unsigned long) (millis() - startTime));
+          THiNXLog::flush();
           ESP.restart();
         } else {
-          Serial.println(F("*TH: ESP MQTT Stream update failed..."));
+          THX_LOGE("ESP MQTT Stream update failed...");
           mqtt_client->publish(
             mqtt_device_status_channel,
             "{ \"status\" : \"mqtt_update_failed\" }"
@@ -1186,35 +2212,193 @@ bool THiNX::start_mqtt() {
         }
 
       } else {
-        Serial.println(F("*TH: MQTT Type: String or JSON..."));
-        Serial.println(pub.payload_string());
+        #ifdef __USE_MSGPACK__
+        // MessagePack map marker, JSON always starts with '{' or whitespace
+        uint8_t marker = (pub.payload_len() > 0) ? pub.payload()[0] : 0;
+        if (((marker & 0xf0) == 0x80) || (marker == 0xde) || (marker == 0xdf)) {
+          THX_LOGI("MQTT Type: MessagePack...");
+          String json; // binary payload is not handed to user code
+          parse_msgpack(pub.payload(), pub.payload_len(), _mqtt_callback ? &json : NULL);
+          if (_mqtt_callback && (json.length() > 0)) {
+            _mqtt_callback(json);
+          }
+          return;
+        }
+        #endif
+        THX_LOGI("MQTT Type: String or JSON...");
         parse(pub.payload_string());
         if (_mqtt_callback) {
             _mqtt_callback(pub.payload_string());
         }
       }
     }); // end-of-callback
+  }
 
-    return true;
+  if (forceHTTP == true) {
+    mqtt_client->set_server(mqtt_address);
+  } else {
+    mqtt_client->set_server(String(thinx_mqtt_url));
+  }
+
+  build_topics(); // owner and udid are final once MQTT starts
+
+  MQTT::Connect conn(thinx_mac());
+  conn.set_will(mqtt_device_status_channel, lastWill.c_str())
+    .set_auth(thinx_udid, thinx_api_key)
+    .set_keepalive(120);
+  #ifdef __USE_MQTT_SESSION__
+  // client id comes from the chip id, so the broker finds the session again after sleep
+  if (!mqtt_clean_session) {
+    conn.unset_clean_session();
+  }
+  #endif
+  return mqtt_client->connect_start(conn);
+}
+
+/*
+* MQTT reconnects, one attempt at a time without waiting for the broker
+*/
+
+void THiNX::mqtt_step() {
+  switch (mqtt_state) {
+    case MQTT_IDLE:
+      return;
+
+    case MQTT_BACKOFF:
+      if ((WiFi.status() == WL_CONNECTED) && ((long)(millis() - mqtt_retry_at) >= 0)) {
+        mqtt_attempt();
+      }
+      return;
+
+    case MQTT_CONNECTING:
+      switch (mqtt_client->connect_poll()) {
+        case PubSubClient::CONNECT_PENDING:
+          return;
+        case PubSubClient::CONNECT_DONE:
+          mqtt_subscribe();
+          return;
+        default:
+          THX_LOGW("MQTT Not connected.");
+          invalidate_address(thinx_mqtt_url);
+          mqtt_backoff();
+          return;
+      }
+
+    case MQTT_SUBSCRIBING:
+      switch (mqtt_client->subscribe_poll()) {
+        case PubSubClient::SUBSCRIBE_PENDING:
+          return;
+        case PubSubClient::SUBSCRIBE_DONE:
+          THX_LOGI("MQTT device topic: %s successfully subscribed.", mqtt_device_channel);
+          mqtt_established();
+          return;
+        default:
+          THX_LOGW("MQTT device topic: %s not subscribed.", mqtt_device_channel);
+          mqtt_client->disconnect();
+          mqtt_backoff();
+          return;
+      }
+
+    case MQTT_UP:
+      if (!mqtt_client->loop()) {
+        THX_LOGW("MQTT connection lost.");
+        mqtt_connected = false;
+        mqtt_backoff(); // broker was fine until now, first retry is quick
+      }
+      return;
+  }
+}
 
+void THiNX::mqtt_attempt() {
+  if (start_mqtt()) {
+    mqtt_state = MQTT_CONNECTING;
   } else {
-    mqtt_connected = false;
-    Serial.println(F("*TH: MQTT Not connected."));
-
-    /*
-    #ifdef __DEBUG__
-          Serial.println(F("*TH: Failed to load root CA certificate for MQTT, falling back to HTTP!"));
-          forceHTTP = true;
-          mqtt_client = new PubSubClient(thx_wifi_client, thinx_mqtt_url);
-          return start_mqtt();
-    #else
-          Serial.println(F("*TH: Failed to connect using MQTTS!"));
-          //ESP.restart();
-    #endif
-    */
+    mqtt_backoff();
+  }
+}
+
+void THiNX::mqtt_backoff() {
+  if (mqtt_backoff_delay == 0) {
+    mqtt_backoff_delay = THINX_MQTT_BACKOFF_MIN;
+  } else {
+    mqtt_backoff_delay = min(mqtt_backoff_delay * 2, THINX_MQTT_BACKOFF_MAX);
+  }
+  // a restarted broker is not hit by the whole fleet at once
+  unsigned long wait = mqtt_backoff_delay + device_jitter(mqtt_backoff_delay / 2);
+  THX_LOGI("MQTT reconnect in %lu ms", wait);
+  mqtt_retry_at = millis() + wait;
+  mqtt_state = MQTT_BACKOFF;
+}
 
+void THiNX::mqtt_subscribe() {
+  bool resumed = false;
+  #ifdef __USE_MQTT_SESSION__
+  resumed = mqtt_client->session_present(); // subscription is part of the session
+  mqtt_clean_session = false;
+  #endif
+  if (resumed) {
+    THX_LOGI("MQTT session resumed, device topic: %s still subscribed.", mqtt_device_channel);
+    mqtt_established();
+    return;
+  }
+  if (!mqtt_client->subscribe_start(mqtt_device_channel, THINX_MQTT_SUBSCRIBE_QOS)) {
+    THX_LOGW("MQTT device topic: %s not subscribed.", mqtt_device_channel);
+    mqtt_client->disconnect();
+    mqtt_backoff();
+    return;
+  }
+  mqtt_state = MQTT_SUBSCRIBING; // mqtt_step() waits for SUBACK
+}
+
+void THiNX::mqtt_established() {
+  mqtt_state = MQTT_UP;
+  mqtt_connected = true;
+  performed_mqtt_checkin = true;
+  mqtt_backoff_delay = 0;
+
+  THX_LOGI("Publishing connected `status: connected` to MQTT");
+  mqtt_client->publish(
+    mqtt_device_status_channel,
+    F("{ \"status\" : \"connected\" }")
+  );
+  #ifdef __ENABLE_WIFI_MIGRATION__
+  publish_wifi_migration();
+  #endif
+  flush_pending();
+}
+
+bool THiNX::queue_pending(thinx_topic_t topic, const uint8_t *payload, size_t length, bool retain) {
+  if (mqtt_pending_length + 4 + length > sizeof(mqtt_pending)) {
+    THX_LOGW("MQTT pending publishes full, dropping %u bytes.", (unsigned) length);
     return false;
   }
+  uint8_t *entry = mqtt_pending + mqtt_pending_length;
+  entry[0] = topic;
+  entry[1] = retain;
+  entry[2] = length >> 8;
+  entry[3] = length & 0xFF;
+  memcpy(entry + 4, payload, length);
+  mqtt_pending_length += 4 + length;
+  return true;
+}
+
+void THiNX::flush_pending() {
+  uint16_t pos = 0;
+  while (pos < mqtt_pending_length) {
+    uint8_t *entry = mqtt_pending + pos;
+    thinx_topic_t topic = entry[0];
+    size_t length = (entry[2] << 8) | entry[3];
+    if ((topic_length[topic] > 0) &&
+        !mqtt_client->publish(topic_pool + topic_offset[topic], topic_length[topic], entry + 4, length, entry[1])) {
+      break; // connection lost again, rest waits for next reconnect
+    }
+    pos += 4 + length;
+  }
+  memmove(mqtt_pending, mqtt_pending + pos, mqtt_pending_length - pos);
+  mqtt_pending_length -= pos;
+  if (pos > 0) {
+    THX_LOGI("MQTT sent %u bytes published while offline.", pos);
+  }
 }
 
 /*
@@ -1226,17 +2410,23 @@ void THiNX::restore_device_info() {
 
   int json_end = 0;
 
+  THiNXLease lease(THINX_DEVICE_INFO_SIZE);
+  if (!lease.ok()) {
+    return;
+  }
+  char *json_info = lease.c_str();
+  memset(json_info, 0, THINX_DEVICE_INFO_SIZE);
+
   #ifndef __USE_SPIFFS__
 
   int value;
-  long buf_len = 512;
+  long buf_len = THINX_DEVICE_INFO_SIZE - 1;
   long data_len = 0;
 
-  Serial.println(F("*TH: Restoring configuration from EEPROM..."));
+  THX_LOGI("Restoring configuration from EEPROM...");
 
   for (long a = 0; a < buf_len; a++) {
     value = EEPROM.read(a);
-    json_output += char(value);
     // validate at least data start
     if (a == 0) {
       if (value != '{') {
@@ -1252,7 +2442,7 @@ void THiNX::restore_device_info() {
     if (value == 0) {
       json_info[a] = char(value);
       data_len++;
-      Serial.print("*TH: "); Serial.print(a); Serial.println(F(" bytes read from EEPROM."));
+      THX_LOGI("%ld bytes read from EEPROM.", a);
       // Validate JSON
       break;
     } else {
@@ -1264,11 +2454,11 @@ void THiNX::restore_device_info() {
 
   // Validating bracket count
   if (json_end != 0) {
-    Serial.println(F("*TH: JSON invalid... bailing out."));
+    THX_LOGI("JSON invalid... bailing out.");
     return;
   }
 
-  Serial.println(F("*TH: Converting data to String..."));
+  THX_LOGI("Converting data to String...");
 
   #else
   if (!SPIFFS.exists("/thx.cfg")) {
@@ -1276,57 +2466,58 @@ void THiNX::restore_device_info() {
     return;
   }
   File f = SPIFFS.open("/thx.cfg", "r");
-  Serial.println(F("*TH: Found persistent data..."));
+  THX_LOGI("Found persistent data...");
   if (!f) {
-    Serial.println(F("*TH: No remote configuration found so far..."));
+    THX_LOGI("No remote configuration found so far...");
     return;
   }
   if (f.size() == 0) {
-    Serial.println(F("*TH: Remote configuration file empty..."));
+    THX_LOGI("Remote configuration file empty...");
     return;
   }
 
-  f.readBytesUntil('\n', json_info, 511);
+  f.readBytesUntil('\n', json_info, THINX_DEVICE_INFO_SIZE - 1);
   #endif
 
-  DynamicJsonBuffer jsonBuffer(512);
-  JsonObject& config = jsonBuffer.parseObject((char*)json_info); // must not be String!
+  // parsed in place, strings stay in the leased json_info
+  THiNXJsonBuffer jsonBuffer(thinx_device_record::parse_capacity);
+  JsonObject& config = jsonBuffer.parseObject(json_info); // must not be String!
 
-  if (!config.success()) {
+  if (!thinx_valid(config, thinx_device_record::fields)) {
     // Serial.println(F("*TH: No JSON data to be parsed..."));
     return;
 
   } else {
 
-    if (config["alias"]) {
-      thinx_alias = strdup(config["alias"]);
+    const char *alias = thinx_get(config, thinx_device_record::alias);
+    if (alias) {
+      thinx_alias = strdup(alias);
     }
 
-    if (config["udid"]) {
-      const char *udid = config["udid"];
-      if ( strlen(udid) > 2 ) {
-        thinx_udid = strdup(udid);
-      } else {
-        thinx_udid = strdup(THINX_UDID);
-      }
+    const char *udid = thinx_get(config, thinx_device_record::udid);
+    if ( udid && (strlen(udid) > 2) ) {
+      thinx_udid = strdup(udid);
     } else {
       thinx_udid = strdup(THINX_UDID);
     }
 
-    if (config["apikey"]) {
-      thinx_api_key = strdup(config["apikey"]);
+    const char *apikey = thinx_get(config, thinx_device_record::apikey);
+    if (apikey) {
+      thinx_api_key = strdup(apikey);
     }
 
-    if (config["owner"]) {
-      thinx_owner = strdup(config["owner"]);
+    const char *owner = thinx_get(config, thinx_device_record::owner);
+    if (owner) {
+      thinx_owner = strdup(owner);
     }
 
-    if (config["ott"]) {
-      available_update_url = strdup(config["ott"]);
+    const char *ott = thinx_get(config, thinx_device_record::ott);
+    if (ott) {
+      available_update_url = strdup(ott);
     }
 
     #ifdef __USE_SPIFFS__
-    Serial.print(F("*TH: Closing SPIFFS file."));
+    THX_LOGD("Closing SPIFFS file.");
     f.close();
     #else
     #endif
@@ -1339,27 +2530,35 @@ void THiNX::restore_device_info() {
 
 void THiNX::save_device_info()
 {
-  deviceInfo(); // update json_output
+  THiNXLease lease(THINX_DEVICE_INFO_SIZE);
+  if (!lease.ok()) {
+    return;
+  }
+  char *json_info = lease.c_str();
+  if (deviceInfo(json_info, THINX_DEVICE_INFO_SIZE) <= 2) {
+    THX_LOGE("Device info not built, stored configuration kept.");
+    return; // "{}" or nothing would wipe owner, API key and UDID
+  }
 
   // disabled for it crashes when closing the file (LoadStoreAlignmentCause) when using String
   #ifdef __USE_SPIFFS__
   File f = SPIFFS.open("/thx.cfg", "w");
   if (f) {
-    Serial.println(F("*TH: Saving configuration to SPIFFS..."));
+    THX_LOGI("Saving configuration to SPIFFS...");
     f.println(String((char*)json_info)); // String instead of const char* due to LoadStoreAlignmentCause...
     f.close();
   } else {
-    Serial.println(F("*TH: Saving configuration failed!"));
+    THX_LOGE("Saving configuration failed!");
   }
   #else
-  Serial.println(F("*TH: Saving configuration to EEPROM: "));
+  THX_LOGI("Saving configuration to EEPROM:");
   for (long addr = 0; addr < strlen((const char*)json_info); addr++) {
     uint8_t byte = json_info[addr];
     EEPROM.put(addr, json_info[addr]);
     if (byte == 0) break;
   }
   EEPROM.commit();
-  Serial.println(F("*TH: Saved configuration (EEPROM)."));
+  THX_LOGI("Saved configuration (EEPROM).");
   #endif
 }
 
@@ -1367,35 +2566,352 @@ void THiNX::save_device_info()
 * Fills output buffer with persistent dconfiguration JSON.
 */
 
-void THiNX::deviceInfo() {
+size_t THiNX::deviceInfo(char *buffer, size_t size) {
 
-  DynamicJsonBuffer jsonBuffer(512);
+  THiNXJsonBuffer jsonBuffer(thinx_device_record::capacity);
   JsonObject& root = jsonBuffer.createObject();
+  if (!root.success()) {
+    return 0;
+  }
 
   // Mandatories
 
   if (strlen(thinx_owner) > 1) {
-    root["owner"] = thinx_owner; // allow owner change
+    thinx_set(root, thinx_device_record::owner, thinx_owner); // allow owner change
   }
 
   if (strlen(thinx_api_key) > 1) {
-    root["apikey"] = thinx_api_key; // allow dynamic API Key
+    thinx_set(root, thinx_device_record::apikey, thinx_api_key); // allow dynamic API Key
   }
 
   if (strlen(thinx_udid) > 1) {
-    root["udid"] = thinx_udid; // allow setting UDID, skip 0
+    thinx_set(root, thinx_device_record::udid, thinx_udid); // allow setting UDID, skip 0
   }
 
   // Optionals
   if (strlen(available_update_url) > 1) {
-    root["update"] = available_update_url; // allow update
-    Serial.println(F("*TH: available_update_url..."));
+    thinx_set(root, thinx_device_record::update, available_update_url); // allow update
+    THX_LOGI("available_update_url...");
   }
 
-  json_output = "";
-  root.printTo(json_output);
+  if (root.measureLength() >= size) {
+    return 0; // truncated JSON is not a record
+  }
+  return root.printTo(buffer, size);
+}
+
+#ifdef __USE_ENV_STORE__
+
+/*
+* Environment store, Configuration Push is diffed per key against hashes kept in RAM
+*/
+
+static uint32_t env_hash(const char *name) {
+  return fnv1a(name, strlen(name)) | 1; // 0 marks a free slot
+}
+
+static size_t env_offset(int slot) {
+  return sizeof(thinx_env_header_t) + slot * sizeof(thinx_env_slot_t);
+}
+
+// Strings are kept as they are, other values as JSON; false if too long
+static bool env_text(JsonVariant value, char *text, size_t size) {
+  if (value.is<const char *>()) {
+    const char *string = value.as<const char *>();
+    if (strlen(string) >= size) {
+      return false;
+    }
+    strcpy(text, string);
+    return true;
+  }
+  if (value.measureLength() >= size) {
+    return false;
+  }
+  value.printTo(text, size);
+  return true;
+}
+
+size_t THiNX::apply_env(JsonObject &configuration) {
+  thinx_env_slot_t entry;
+  size_t changes = 0;
+  uint32_t pushed = 0; // slots of keys in this push, never replaced to make room
+  env_changed = 0;
+
+  for (JsonObject::iterator it = configuration.begin(); it != configuration.end(); ++it) {
+    int slot = env_slot(env_hash(it->key));
+    if (slot >= 0) {
+      pushed |= 1UL << slot;
+    }
+  }
+
+  for (JsonObject::iterator it = configuration.begin(); it != configuration.end(); ++it) {
+    memset(&entry, 0, sizeof(entry));
+    if ((strlen(it->key) >= sizeof(entry.name)) || !env_text(it->value, entry.text, sizeof(entry.text))) {
+      THX_LOGW("Environment variable too long: %s", it->key);
+      continue;
+    }
+
+    uint32_t key = env_hash(it->key);
+    uint32_t value = fnv1a(entry.text, strlen(entry.text));
+    int slot = env_slot(key);
+    if ((slot >= 0) && (env_values[slot] == value)) {
+      continue; // unchanged, nothing written or called
+    }
+
+    // a changed key is always persisted, so env() and envChanged() know it
+    // and the next push with the same value ends above
+    slot = env_slot(key, it->key); // hashes may collide, another key's slot is kept
+    if (slot < 0) {
+      slot = env_free_slot(pushed);
+    }
+    if (slot < 0) {
+      THX_LOGE("Environment store full, %s ignored.", it->key);
+      continue;
+    }
+    entry.key = key;
+    entry.value = value;
+    strcpy(entry.name, it->key);
+    if (!write_env_slot(slot, &entry)) {
+      continue;
+    }
+    env_keys[slot] = key;
+    env_values[slot] = value;
+    env_changed |= 1UL << slot;
+    pushed |= 1UL << slot;
+
+    changes++;
+    call_env_handlers(key, it->value, entry.text);
+  }
+
+  #ifndef __USE_SPIFFS__
+  if (env_changed) {
+    EEPROM.commit();
+  }
+  #endif
+
+  return changes;
+}
+
+void THiNX::call_env_handlers(uint32_t key, JsonVariant value, const char *text) {
+  for (size_t i = 0; i < env_handler_count; i++) {
+    thinx_env_handler_t &h = env_handlers[i];
+    if (h.key != key) {
+      continue;
+    }
+    switch (h.type) {
+      case THINX_ENV_STRING: h.handler.string(text); break;
+      case THINX_ENV_LONG: h.handler.number(value.as<long>()); break;
+      case THINX_ENV_DOUBLE: h.handler.real(value.as<double>()); break;
+      case THINX_ENV_BOOL: h.handler.flag(value.as<bool>()); break;
+    }
+  }
+}
+
+bool THiNX::add_env_handler(const char *key, thinx_env_handler_t &handler) {
+  if (env_handler_count == THINX_ENV_HANDLERS) {
+    THX_LOGI("Too many environment handlers.");
+    return false;
+  }
+  handler.key = env_hash(key);
+  env_handlers[env_handler_count++] = handler;
+  return true;
+}
+
+bool THiNX::onEnv(const char *key, void (*handler)(const char *)) {
+  thinx_env_handler_t h;
+  h.type = THINX_ENV_STRING;
+  h.handler.string = handler;
+  return add_env_handler(key, h);
+}
+
+bool THiNX::onEnv(const char *key, void (*handler)(long)) {
+  thinx_env_handler_t h;
+  h.type = THINX_ENV_LONG;
+  h.handler.number = handler;
+  return add_env_handler(key, h);
+}
+
+bool THiNX::onEnv(const char *key, void (*handler)(double)) {
+  thinx_env_handler_t h;
+  h.type = THINX_ENV_DOUBLE;
+  h.handler.real = handler;
+  return add_env_handler(key, h);
+}
+
+bool THiNX::onEnv(const char *key, void (*handler)(bool)) {
+  thinx_env_handler_t h;
+  h.type = THINX_ENV_BOOL;
+  h.handler.flag = handler;
+  return add_env_handler(key, h);
+}
+
+bool THiNX::env(const char *key, char *value, size_t size) {
+  thinx_env_slot_t entry;
+  int slot = env_slot(env_hash(key), key);
+  if ((slot < 0) || !read_env_slot(slot, &entry)) {
+    return false;
+  }
+  entry.text[sizeof(entry.text) - 1] = 0;
+  if (strlen(entry.text) >= size) {
+    return false;
+  }
+  strcpy(value, entry.text);
+  return true;
+}
+
+bool THiNX::envChanged(const char *key) {
+  thinx_env_slot_t entry;
+  uint32_t hash = env_hash(key);
+  for (int i = 0; i < THINX_ENV_SLOTS; i++) {
+    if ((env_keys[i] != hash) || !(env_changed & (1UL << i))) {
+      continue; // store is read only for a changed slot
+    }
+    if (read_env_slot(i, &entry)) {
+      entry.name[sizeof(entry.name) - 1] = 0;
+      if (strcmp(entry.name, key) == 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// With name, the stored name is compared too (reads the store)
+int THiNX::env_slot(uint32_t key, const char *name) {
+  thinx_env_slot_t entry;
+  for (int i = 0; i < THINX_ENV_SLOTS; i++) {
+    if (env_keys[i] != key) {
+      continue;
+    }
+    if (name == NULL) {
+      return i;
+    }
+    if (read_env_slot(i, &entry)) {
+      entry.name[sizeof(entry.name) - 1] = 0;
+      if (strcmp(entry.name, name) == 0) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+// Free slot; when the store is full, one whose key is not in this push
+int THiNX::env_free_slot(uint32_t pushed) {
+  int slot = env_slot(0);
+  if (slot >= 0) {
+    return slot;
+  }
+  for (int i = 0; i < THINX_ENV_SLOTS; i++) {
+    if (!(pushed & (1UL << i))) {
+      THX_LOGW("Environment store full, replacing slot %d.", i);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void THiNX::restore_env() {
+  thinx_env_header_t header = {0, 0};
+  uint32_t hashes[2];
+  bool valid = false;
+
+  memset(env_keys, 0, sizeof(env_keys));
+  memset(env_values, 0, sizeof(env_values));
+  env_changed = 0;
+
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_ENV_FILE, "r");
+  if (f) {
+    valid = (f.size() == THINX_ENV_STORE_SIZE)
+      && (f.read((uint8_t *) &header, sizeof(header)) == sizeof(header))
+      && (header.magic == THINX_ENV_MAGIC) && (header.slot_size == sizeof(thinx_env_slot_t));
+    for (int i = 0; valid && (i < THINX_ENV_SLOTS); i++) {
+      valid = f.seek(env_offset(i), SeekSet) && (f.read((uint8_t *) hashes, sizeof(hashes)) == sizeof(hashes));
+      env_keys[i] = hashes[0];
+      env_values[i] = hashes[1];
+    }
+    f.close();
+  }
+  #else
+  EEPROM.get(THINX_ENV_EEPROM_OFFSET, header);
+  valid = (header.magic == THINX_ENV_MAGIC) && (header.slot_size == sizeof(thinx_env_slot_t));
+  for (int i = 0; valid && (i < THINX_ENV_SLOTS); i++) {
+    EEPROM.get(THINX_ENV_EEPROM_OFFSET + env_offset(i), hashes);
+    env_keys[i] = hashes[0];
+    env_values[i] = hashes[1];
+  }
+  #endif
+
+  if (!valid) {
+    memset(env_keys, 0, sizeof(env_keys));
+    memset(env_values, 0, sizeof(env_values));
+    format_env();
+  }
+}
+
+bool THiNX::format_env() {
+  thinx_env_header_t header = { THINX_ENV_MAGIC, sizeof(thinx_env_slot_t) };
+  thinx_env_slot_t empty;
+  memset(&empty, 0, sizeof(empty));
+
+  THX_LOGI("Creating environment store...");
+
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_ENV_FILE, "w");
+  if (!f) {
+    THX_LOGE("Creating environment store failed!");
+    return false;
+  }
+  bool ok = f.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  for (int i = 0; ok && (i < THINX_ENV_SLOTS); i++) {
+    ok = f.write((const uint8_t *) &empty, sizeof(empty)) == sizeof(empty);
+  }
+  f.close();
+  return ok;
+  #else
+  EEPROM.put(THINX_ENV_EEPROM_OFFSET, header);
+  for (int i = 0; i < THINX_ENV_SLOTS; i++) {
+    EEPROM.put(THINX_ENV_EEPROM_OFFSET + env_offset(i), empty);
+  }
+  return EEPROM.commit();
+  #endif
+}
+
+bool THiNX::read_env_slot(int slot, thinx_env_slot_t *entry) {
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_ENV_FILE, "r");
+  if (!f) {
+    return false;
+  }
+  bool ok = f.seek(env_offset(slot), SeekSet) && (f.read((uint8_t *) entry, sizeof(*entry)) == sizeof(*entry));
+  f.close();
+  return ok;
+  #else
+  EEPROM.get(THINX_ENV_EEPROM_OFFSET + env_offset(slot), *entry);
+  return true;
+  #endif
+}
+
+// Rewrites one slot only; EEPROM is committed by caller once per push
+bool THiNX::write_env_slot(int slot, const thinx_env_slot_t *entry) {
+  #ifdef __USE_SPIFFS__
+  File f = SPIFFS.open(THINX_ENV_FILE, "r+");
+  if (!f) {
+    THX_LOGE("Saving environment failed!");
+    return false;
+  }
+  bool ok = f.seek(env_offset(slot), SeekSet) && (f.write((const uint8_t *) entry, sizeof(*entry)) == sizeof(*entry));
+  f.close();
+  return ok;
+  #else
+  EEPROM.put(THINX_ENV_EEPROM_OFFSET + env_offset(slot), *entry);
+  return true;
+  #endif
 }
 
+#endif
+
 /*
 * Updates
 */
@@ -1405,19 +2921,18 @@ void THiNX::deviceInfo() {
 
 void THiNX::update_and_reboot(String url) {
 
-  Serial.print("*TH: Update with URL: ");
-  Serial.println(url);
+  THX_LOGI("Update with URL: %s", url.c_str());
 
   // #define __USE_STREAM_UPDATER__ ; // Warning, this is MQTT-based streamed update!
   #ifdef __USE_STREAM_UPDATER__
-  Serial.println(F("*TH: Starting MQTT & reboot..."));
+  THX_LOGI("Starting MQTT & reboot...");
   uint32_t size = pub.payload_len();
   if (ESP.updateSketch(*pub.payload_stream(), size, true, false)) {
-    Serial.println(F("Clearing retained message."));
+    THX_LOGI("Clearing retained message.");
     mqtt_client->publish(MQTT::Publish(pub.topic(), "").set_retain());
     mqtt_client->disconnect();
 
-    Serial.printf("Update Success: %u\nRebooting...\n", millis() - startTime);
+    THX_LOGI("Update Success: %lu ms, rebooting...", (unsigned long) (millis() - startTime));
 
     // Notify on reboot for update
     if (mqtt_client != NULL) {
@@ -1429,26 +2944,28 @@ void THiNX::update_and_reboot(String url) {
     }
   }
 
+  THiNXLog::flush();
   ESP.restart();
   #else
 
   // TODO: Download the file and check expected_hash first...
 
-  Serial.println(F("*TH: Starting ESP8266 HTTP Update & reboot..."));
+  THX_LOGI("Starting ESP8266 HTTP Update & reboot...");
   t_httpUpdate_return ret = ESPhttpUpdate.update(url.c_str(), expected_md5);
 
   switch(ret) {
     case HTTP_UPDATE_FAILED:
-    Serial.printf("HTTP_UPDATE_FAILED Error (%d): %s", ESPhttpUpdate.getLastError(), ESPhttpUpdate.getLastErrorString().c_str());
+    THX_LOGE("HTTP_UPDATE_FAILED Error (%d): %s", ESPhttpUpdate.getLastError(), ESPhttpUpdate.getLastErrorString().c_str());
     setDashboardStatus(ESPhttpUpdate.getLastErrorString());
     break;
 
     case HTTP_UPDATE_NO_UPDATES:
-    Serial.println(F("HTTP_UPDATE_NO_UPDATES"));
+    THX_LOGI("HTTP_UPDATE_NO_UPDATES");
     break;
 
     case HTTP_UPDATE_OK:
-    Serial.println(F("HTTP_UPDATE_OK"));
+    THX_LOGI("HTTP_UPDATE_OK");
+    THiNXLog::flush();
     ESP.restart();
     break;
   }
@@ -1512,16 +3029,18 @@ bool THiNX::fsck() {
       fileSystemReady = SPIFFS.begin(true); // formatOnFail=true
     #endif
     if (!fileSystemReady) {
-      Serial.println(F("*TH: Formatting SPIFFS..."));
+      THX_LOGI("Formatting SPIFFS...");
       fileSystemReady = SPIFFS.format();;
-      Serial.println(F("*TH: Format complete, rebooting...")); Serial.flush();
+      THX_LOGI("Format complete, rebooting...");
+      THiNXLog::flush();
       ESP.restart();
       return false;
     }
   }  else {
-    Serial.print(F("*TH: Flash incorrectly configured, SPIFFS cannot start."));
 #if defined(ESP8266)
-    Serial.println(ideSize + ", real size: " + realSize);
+    THX_LOGE("Flash incorrectly configured, SPIFFS cannot start. %s, real size: %s", ideSize.c_str(), realSize.c_str());
+#else
+    THX_LOGE("Flash incorrectly configured, SPIFFS cannot start.");
 #endif
   }
   return fileSystemReady ? true : false;
@@ -1536,13 +3055,13 @@ void THiNX::evt_save_api_key() {
   if (should_save_config) {
     if (strlen(thx_api_key) > 4) {
       thinx_api_key = thx_api_key;
-      Serial.print(F("Saving thx_api_key from Captive Portal."));
+      THX_LOGI("Saving thx_api_key from Captive Portal.");
     }
     if (strlen(thx_owner_key) > 4) {
       thinx_owner_key = thx_owner_key;
-      Serial.print(F("Saving thx_owner_key from Captive Portal."));
+      THX_LOGI("Saving thx_owner_key from Captive Portal.");
     }
-    Serial.println(F("Saving device info for API key.")); Serial.flush();
+    THX_LOGI("Saving device info for API key.");
     save_device_info();
     should_save_config = false;
   }
@@ -1570,26 +3089,24 @@ void THiNX::finalize() {
   if (_finalize_callback) {
     _finalize_callback();
   } else {
-    Serial.println(F("*TH: Checkin completed (no _finalize_callback)."));
+    THX_LOGI("Checkin completed (no _finalize_callback).");
   }
 }
 
 /* This is necessary for SSL/TLS and should replace THiNX timestamp */
 void THiNX::sync_sntp() {
-  Serial.print("*TH: Setting time using SNTP...");
+  THX_LOGI("Setting time using SNTP...");
   // THiNX API returns timezone_offset in current DST, if applicable
   configTime(timezone_offset * 3600, 0, "0.europe.pool.ntp.org", "cz.pool.ntp.org");
   time_t now = time(nullptr);
   while (now < 8 * 3600 * 2) {
     delay(500);
-    Serial.print(".");
+    THiNXLog::drain();
     now = time(nullptr);
   }
-  Serial.println();
   struct tm timeinfo;
   gmtime_r(&now, &timeinfo);
-  Serial.print("*TH: SNTP time: ");
-  Serial.print(asctime(&timeinfo));
+  THX_LOGI("SNTP time: %.24s", asctime(&timeinfo)); // without asctime() newline
 }
 
 /*
@@ -1600,12 +3117,63 @@ void THiNX::loop() {
 
   //printStackHeap("in");
 
+  THiNXLog::drain(); // lines the UART could not take while they were logged
+
+  #ifdef __DEBUG__
+  if (thinx_phase != arena_phase) {
+    static const char *phase_names[] = {
+      "INIT", "CONNECT_WIFI", "CONNECT_API", "CONNECT_MQTT", "CHECKIN_MQTT", "FINALIZE", "COMPLETED"
+    };
+    THiNXArena::report(phase_names[arena_phase]); // peak usage of the phase just left
+    arena_phase = thinx_phase;
+  }
+  #endif
+
+  #ifdef __USE_WIFI_STORE__
+  if (wifi_store_phase != STORE_IDLE) {
+    if (wifi_store_step()) {
+      return; // trying remembered networks
+    }
+    #ifdef __USE_WIFI_MANAGER__
+    if ((wifi_manager != nullptr) && ((WiFi.status() == WL_CONNECTED) || wifi_manager->autoConnect(accessPointName.c_str()))) {
+      delete wifi_manager;
+      wifi_manager = nullptr;
+    }
+    #endif
+  }
+  #endif
+
+  #ifdef __USE_WIFI_MANAGER__
+  // non-blocking portal: at most one DNS query and one HTTP request per loop, longest step is printed when portal closes
+  if (wifi_manager != nullptr) {
+    if (wifi_manager->process()) {
+      THX_LOGI("WiFi Manager done, longest step (us): %lu", (unsigned long) wifi_manager->getProcessMaxMicros());
+      if (WiFi.status() == WL_CONNECTED) {
+        delete wifi_manager;
+        wifi_manager = nullptr;
+      } else if (wifi_manager->autoConnect(accessPointName.c_str())) {
+        delete wifi_manager; // saved network came back
+        wifi_manager = nullptr;
+      } else {
+        // portal timed out unprovisioned: saved credentials are retried, then the portal opens again
+        THX_LOGW("WiFi portal timed out, retrying.");
+      }
+    }
+  }
+  #endif
+
+  #ifdef __ENABLE_WIFI_MIGRATION__
+  if (wifi_migration_step()) {
+    return; // network is changing, MQTT and check-ins resume afterwards
+  }
+  #endif
+
   if (thinx_phase == CONNECT_WIFI) {
     // If not connected manually or using WiFiManager, start connection in progress...
     if (WiFi.status() != WL_CONNECTED) {
       wifi_connected = false;
       if (wifi_connection_in_progress != true) {
-        Serial.println(F("*TH: CONNECTING »"));
+        THX_LOGI("CONNECTING »");
         connect(); // blocking
         wifi_connection_in_progress = true;
         wifi_connection_in_progress = true;
@@ -1619,12 +3187,16 @@ void THiNX::loop() {
       // Synchronize SNTP time
       sync_sntp();
 
+      #ifdef __USE_WIFI_STORE__
+      remember_network();
+      #endif
+
       // Start MDNS broadcast
       if (!MDNS.begin(thinx_alias)) {
-        Serial.println(F("*TH: Error setting up mDNS"));
+        THX_LOGE("Error setting up mDNS");
       } else {
         // Query MDNS proxy
-        Serial.println(F("*TH: Searching for thinx-connect on local network..."));
+        THX_LOGI("Searching for thinx-connect on local network...");
         int n = MDNS.queryService("thinx", "tcp"); // TODO: WARNING! may be _tcp!
         if (n > 0) {
           thinx_cloud_url = strdup(String(MDNS.hostname(0)).c_str());
@@ -1637,83 +3209,42 @@ void THiNX::loop() {
     }
   }
 
-  // After MQTT gets connected:
-  if (thinx_phase == CHECKIN_MQTT) {
-    thinx_mqtt_channel(); // initialize channel variable
-    if (strlen(mqtt_device_channel) > 5) {
-      if (mqtt_client->subscribe(mqtt_device_channel)) {
-        Serial.print(F("*TH: MQTT device topic: "));
-        Serial.print(mqtt_device_channel);
-        Serial.println(F(" successfully subscribed."));
-        Serial.println(F("*TH: Publishing connected `status: connected` to MQTT"));
-        // Publish status on status topic
-        mqtt_client->publish(
-          mqtt_device_status_channel,
-          F("{ \"status\" : \"connected\" }")
-        );
-        mqtt_client->loop();
-        //Serial.println(F("*TH: LOOP » FINALIZE"));
-        thinx_phase = FINALIZE;
-        return;
-      }
-    }
-  }
+  // Subscribes and publishes the connected status once the broker accepts,
+  // after a lost connection retries with backoff, never waiting for the broker
+  mqtt_step();
 
   if ( thinx_phase == CONNECT_MQTT ) {
     if (strlen(thinx_udid) > 4) {
-      if (mqtt_connected == false) {
-        mqtt_connected = start_mqtt();
-        mqtt_client->loop();
-        if (mqtt_connected) {
-            thinx_phase = CHECKIN_MQTT;
-        } else {
-          // tries again next time
-        }
-        return;
-      } else {
-        thinx_phase = FINALIZE;
-        return;
+      if (mqtt_state == MQTT_IDLE) {
+        mqtt_attempt();
+      }
+      if ((mqtt_state != MQTT_CONNECTING) && (mqtt_state != MQTT_SUBSCRIBING)) {
+        thinx_phase = FINALIZE; // up, or retried in background
       }
+      return;
     } else {
-      Serial.println(F("*TH: LOOP » FINALIZE"));
+      THX_LOGD("LOOP » FINALIZE");
       thinx_phase = FINALIZE;
       return;
     }
   }
 
-  /*
-  if (thinx_phase > CHECKIN_MQTT) {
-    Serial.println(F("*TH: start_mqtt")); Serial.flush();
-    mqtt_connected = mqtt_client->connected();
-    if (!mqtt_connected) {
-      Serial.println(F("*TH: MQTT RECONNECT ON CONNECTION CHECK..."));
-      Serial.println(thinx_time(NULL));
-      mqtt_connected = start_mqtt();
-      if (mqtt_connected) {
-          thinx_phase = CHECKIN_MQTT;
-      } else {
-        // tries again next time
-      }
-    }
-  }*/
-
   // CASE thinx_phase == CONNECT_API
 
-  // Force re-checkin after specified interval
+  // Force re-checkin after specified interval (next one is scheduled by checkin())
   if (thinx_phase > FINALIZE) {
-    if (millis() > checkin_timeout) {
-      if (checkin_interval > 0) {
-        Serial.println(F("*TH: LOOP » Checkin interval arrived..."));
+    if (checkin_due()) {
+      if ((checkin_interval > 0) || (checkin_backoff > 0)) {
+        THX_LOGD("LOOP » Checkin interval arrived...");
         thinx_phase = CONNECT_API;
-        checkin_timeout = millis() + checkin_interval;
       }
     }
   }
 
   // If connected, perform the MQTT loop and bail out ASAP
-  if (thinx_phase == CONNECT_API) {
+  if ((thinx_phase == CONNECT_API) && checkin_due()) {
     if (WiFi.getMode() == WIFI_AP) {
-      Serial.println(F("*TH: LOOP « (AP_MODE)"));
+      THX_LOGD("LOOP « (AP_MODE)");
       return;
     }
     if (strlen(thinx_api_key) > 4) {
@@ -1721,7 +3252,7 @@ void THiNX::loop() {
       if (mqtt_connected == false) {
         thinx_phase = CONNECT_MQTT;
       } else {
-        Serial.println(F("*TH: LOOP » FINALIZE (mqtt connected)"));
+        THX_LOGD("LOOP » FINALIZE (mqtt connected)");
         thinx_phase = FINALIZE;
       }
     }
@@ -1732,19 +3263,24 @@ void THiNX::loop() {
   }
 
   if ( thinx_phase > FINALIZE ) {
-    mqtt_client->loop();
+    #ifdef __USE_DNS_CACHE__
+    if (dns_revalidate) {
+      revalidate_dns_cache();
+    }
+    #endif
   }
 
-  if ( (reboot_interval > 0) && (millis() > reboot_interval) ) {
-    Serial.println(F("Rebooting...")); Serial.flush();
+  if ( (reboot_interval > 0) && ((long)(millis() - reboot_timeout) >= 0) ) {
+    THX_LOGI("Rebooting...");
     setDashboardStatus(F("Rebooting..."));
+    THiNXLog::flush();
     ESP.restart();
   }
 
   #ifdef __USE_WIFI_MANAGER__
     // Save API key on change
     if (should_save_config) {
-      Serial.println(F("*TH: Saving API key on change..."));
+      THX_LOGI("Saving API key on change...");
       evt_save_api_key();
       should_save_config = false;
     }
@@ -1759,7 +3295,7 @@ void THiNX::setLocation(double lat, double lon) {
   // uses mqtt_connected status because this happens only after first checkin
   // and thus prevents premature request to backend.
   if (wifi_connected && thinx_phase > FINALIZE) {
-    Serial.println(F("*TH: LOOP » setLocation checkin"));
+    THX_LOGD("LOOP » setLocation checkin");
     checkin();
   }
 }
@@ -1767,7 +3303,7 @@ void THiNX::setLocation(double lat, double lon) {
 void THiNX::setDashboardStatus(String newstatus) {
   statusString = newstatus;
   if (wifi_connected && thinx_phase > FINALIZE) {
-    Serial.println(F("*TH: LOOP » setDashboardStatus checkin"));
+    THX_LOGD("LOOP » setDashboardStatus checkin");
     checkin();
     if (mqtt_client) {
       String message = String("{ \"status\" : \"") + newstatus + String("\" }");
@@ -1787,6 +3323,7 @@ void THiNX::setCheckinInterval(long interval) {
 
 void THiNX::setRebootInterval(long interval) {
   reboot_interval = interval;
+  reboot_timeout = millis() + reboot_interval + device_jitter(THINX_REBOOT_WINDOW);
 }
 
 // SHA256
@@ -1827,18 +3364,18 @@ bool THiNX::check_hash(char * filename, char * expected) {
       sprintf(aes_text + 2 * i, "%02X", obuf[i]);
     }
 
-    Serial.printf("AES # %s at %u\n", aes_text, fpos);
-    Serial.printf("EXPECTED # %s", expected);
+    THX_LOGD("AES # %s at %u", aes_text, fpos);
+    THX_LOGD("EXPECTED # %s", expected);
 
     end = millis() - start;
-    Serial.printf("%u bytes hashed in %u ms\n\n", flen, end);
+    THX_LOGD("%u bytes hashed in %u ms", flen, end);
 
     file.close();
 
     return strcmp(expected, aes_text);
 
   } else {
-    Serial.println(F("Failed to open file for reading"));
+    THX_LOGE("Failed to open file for reading");
     return false;
   }
 }
@@ -1848,9 +3385,7 @@ void THiNX::printStackHeap(String tag) {
   extern cont_t g_cont;
   register uint32_t *sp asm("a1");
   unsigned long heap = system_get_free_heap_size();
-  Serial.printf("[%s] STACK U=%4d ", tag.c_str(), cont_get_free_stack(&g_cont));
-  Serial.printf("F=%4d ", 4 * (sp - g_cont.stack));
-  Serial.print("H="); Serial.println(heap);
+  THX_LOGD("[%s] STACK U=%4d F=%4d H=%lu", tag.c_str(), cont_get_free_stack(&g_cont), 4 * (sp - g_cont.stack), heap);
 }
 
 #endif // IMPORTANT LINE FOR UNIT-TESTING!
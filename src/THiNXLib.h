@@ -1,11 +1,20 @@
 #include <Arduino.h>
 
 #define __DEBUG__ // enables stack/heap debugging
-#define __DEBUG_JSON__ // enables API request debugging
+#ifndef THINX_LOG_LEVEL
+#define THINX_LOG_LEVEL THINX_LOG_INFO // THINX_LOG_NONE, _ERROR, _WARN, _INFO or _DEBUG; less severe messages are compiled out
+#endif
 
 #define __ENABLE_WIFI_MIGRATION__ // enable automatic WiFi disconnect/reconnect on Configuration Push (THINX_ENV_SSID and THINX_ENV_PASS)
 #define __USE_WIFI_MANAGER__ // if disabled, you need to `WiFi.begin(ssid, pass)` on your own
+#define __NONBLOCKING_PORTAL__ // captive portal (WiFi Manager) is serviced from loop() instead of blocking in constructor
 #define __USE_SPIFFS__ // if disabled, uses EEPROM instead
+#define __USE_DNS_CACHE__ // caches resolved API/MQTT addresses in RTC memory to skip DNS lookup on wake
+#define __USE_DELTA_CHECKIN__ // sends only registration fields changed since last acknowledged checkin
+#define __USE_MSGPACK__ // MessagePack for API and MQTT device channel once server answers with application/msgpack
+#define __USE_WIFI_STORE__ // remembers several networks, reconnects to the best one seen before opening the portal
+#define __USE_ENV_STORE__ // persists Configuration Push, runs onEnv() handlers and WiFi migration only for changed keys
+#define __USE_MQTT_SESSION__ // broker keeps the session while device sleeps, device channel messages sent meanwhile arrive on wake
 
 // Provides placeholder for THINX_FIRMWARE_VERSION_SHORT
 #ifndef VERSION
@@ -44,6 +53,152 @@
 #include <PubSubClient.h>
 
 #include "sha256.h"
+#include "thinx_arena.h"
+#include "thinx_log.h"
+#include "thinx_schema.h"
+
+// Check-in scheduling, spreads fleet load after site-wide power loss
+#define THINX_BOOT_JITTER_WINDOW (30 * 1000UL)        // first check-in delayed by up to 30 s per device
+#define THINX_CHECKIN_JITTER_WINDOW (300 * 1000UL)    // periodic check-in stretched by up to 5 min per device
+#define THINX_REBOOT_WINDOW (3600 * 1000UL)           // periodic reboot spread across 1 h
+#define THINX_BACKOFF_MIN (60 * 1000UL)               // first retry after failed check-in
+#define THINX_BACKOFF_MAX (3600 * 1000UL)             // retries never wait longer than this
+#define THINX_MQTT_BACKOFF_MIN (1 * 1000UL)           // first MQTT reconnect after losing the broker
+#define THINX_MQTT_BACKOFF_MAX (300 * 1000UL)         // MQTT reconnects never wait longer than this
+
+#define THINX_STREAM_WINDOW_SIZE 256                  // JSON streamed to MQTT in windows of this size
+#define THINX_PORTAL_TIMEOUT 300                      // seconds the captive portal stays open without clients
+#define THINX_WIFI_MIGRATION_TIMEOUT (20 * 1000UL)   // pushed credentials must connect within, rollback gets as long
+#define THINX_TOPICS 8                                // registered sub-topics of device channel, status included
+#define THINX_TOPIC_POOL_SIZE 640                     // all registered topics, formatted
+#define THINX_MQTT_PENDING_SIZE 256                   // publishes kept while MQTT is down, sent on reconnect
+#define THINX_MQTT_SUBSCRIBE_QOS 1                    // device channel; QoS 0 messages are not kept in a session
+#define THINX_LOG_TAIL_SIZE 512                       // bytes of newest log lines returned by {"log": lines}
+#define THINX_LOG_TAIL_LINES 16                       // most lines returned by {"log": lines}
+
+typedef uint8_t thinx_topic_t;                        // registerTopic() handle
+#define THINX_TOPIC_STATUS ((thinx_topic_t) 0)        // "/owner/udid/status", registered by constructor
+#define THINX_TOPIC_NONE 0xFF
+
+#ifdef __USE_ENV_STORE__
+
+#define THINX_ENV_SLOTS 16                  // persisted variables, at most 32 (change mask)
+#define THINX_ENV_KEY_SIZE 32               // longest key + 1
+#define THINX_ENV_VALUE_SIZE 64             // longest value as text + 1, fits WPA passphrase
+#define THINX_ENV_HANDLERS 8                // onEnv() registrations
+#define THINX_ENV_FILE "/thx.env"           // SPIFFS store
+#define THINX_ENV_EEPROM_OFFSET THINX_DEVICE_INFO_SIZE // EEPROM store, after device info JSON
+#define THINX_ENV_MAGIC 0x54584556          // 'TXEV'
+
+typedef struct {
+  uint32_t magic;
+  uint32_t slot_size;                       // store is recreated when slot layout changes
+} thinx_env_header_t;
+
+typedef struct {
+  uint32_t key;                             // FNV-1a of name, 0 for free slot
+  uint32_t value;                           // FNV-1a of text
+  char name[THINX_ENV_KEY_SIZE];
+  char text[THINX_ENV_VALUE_SIZE];          // string value, other types as JSON
+} thinx_env_slot_t;
+
+enum thinx_env_type {
+  THINX_ENV_STRING,
+  THINX_ENV_LONG,
+  THINX_ENV_DOUBLE,
+  THINX_ENV_BOOL
+};
+
+typedef struct {
+  uint32_t key;                             // FNV-1a of name
+  thinx_env_type type;
+  union {
+    void (*string)(const char *);
+    void (*number)(long);
+    void (*real)(double);
+    void (*flag)(bool);
+  } handler;
+} thinx_env_handler_t;
+
+#define THINX_ENV_STORE_SIZE (sizeof(thinx_env_header_t) + THINX_ENV_SLOTS * sizeof(thinx_env_slot_t))
+
+#else
+
+#define THINX_ENV_STORE_SIZE 0
+
+#endif
+
+#ifdef __USE_WIFI_STORE__
+
+#define THINX_WIFI_STORE_SIZE 4             // remembered networks, least recently used one is replaced
+#define THINX_WIFI_STORE_TIMEOUT (8 * 1000UL) // each remembered network must connect within
+#define THINX_WIFI_STORE_MAX_FAILURES 3     // networks failing more often in a row are tried last
+#define THINX_WIFI_STORE_MIN_RSSI -80       // weaker networks are tried after stronger ones
+#define THINX_WIFI_STORE_FILE "/thx.wifi"   // SPIFFS store
+#define THINX_WIFI_STORE_EEPROM_OFFSET (THINX_DEVICE_INFO_SIZE + THINX_ENV_STORE_SIZE) // EEPROM store
+#define THINX_WIFI_STORE_MAGIC 0x54585753   // 'TXWS'
+
+typedef struct {
+  char ssid[33];                            // empty for free entry
+  char pass[65];
+  uint8_t bssid[6];                         // strongest AP of last scan or connection
+  uint8_t channel;                          // 0 if BSSID unknown
+  uint8_t failures;                         // failed attempts since last success
+  uint32_t last_success;                    // epoch seconds (SNTP), or ordinal while time is unknown
+} thinx_wifi_credential_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t checksum;
+  thinx_wifi_credential_t entries[THINX_WIFI_STORE_SIZE];
+} thinx_wifi_store_t;
+
+#define THINX_EEPROM_SIZE (THINX_WIFI_STORE_EEPROM_OFFSET + sizeof(thinx_wifi_store_t))
+
+#else
+
+#define THINX_EEPROM_SIZE (THINX_DEVICE_INFO_SIZE + THINX_ENV_STORE_SIZE)
+
+#endif
+
+#ifdef __USE_DELTA_CHECKIN__
+
+#define THINX_CHECKIN_FIELDS 12             // mac, firmware, version, commit, owner, alias, udid, status, lat, lon, rssi, platform
+#define THINX_CHECKIN_STATE_RTC_OFFSET 128  // RTC user memory block, after DNS cache
+#define THINX_CHECKIN_STATE_MAGIC 0x54584b53  // 'TXKS'
+
+typedef struct {
+  uint32_t magic;
+  uint32_t checksum;
+  uint32_t hashes[THINX_CHECKIN_FIELDS];    // FNV-1a of each field as last acknowledged by API, 0 if not sent
+} thinx_checkin_state_t;
+
+#endif
+
+#ifdef __USE_DNS_CACHE__
+
+#define THINX_DNS_CACHE_SIZE 2              // API and MQTT broker
+#define THINX_DNS_CACHE_TTL 3600            // seconds an address is considered fresh
+#define THINX_DNS_CACHE_MAX_STALE 604800    // seconds a stale address may be served without successful lookup first
+#define THINX_DNS_CACHE_CLOCK_VALID 57600  // time() below this means SNTP has not set the clock yet
+#define THINX_DNS_RETRY_MIN (30 * 1000UL)   // first refresh retry after a failed lookup
+#define THINX_DNS_RETRY_MAX (900 * 1000UL)  // refresh retries during a resolver outage never wait longer than this
+#define THINX_DNS_CACHE_RTC_OFFSET 64       // first RTC user memory block (blocks 0..63 are reserved by SDK)
+#define THINX_DNS_CACHE_MAGIC 0x54584443    // 'TXDC'
+
+typedef struct {
+  char host[64];                            // FQDN, truncated names are never cached
+  uint32_t address;                         // IPv4 in network order as stored by IPAddress
+  uint32_t expires;                         // epoch seconds (SNTP time)
+} thinx_dns_entry_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t checksum;
+  thinx_dns_entry_t entries[THINX_DNS_CACHE_SIZE];
+} thinx_dns_cache_t;
+
+#endif
 
 class THiNX {
 
@@ -66,6 +221,7 @@ public:
     static WiFiManagerParameter *owner_param;
     static int should_save_config; // after autoconnect, may provide new API Key
     static void saveConfigCallback();
+    WiFiManager *wifi_manager = nullptr;         // until connected or portal timeout when non-blocking
 #endif
 
     THiNX();
@@ -78,6 +234,7 @@ public:
         REGISTRATION = 2,                           // Registration Response Payload
         NOTIFICATION = 3,                      // Notification/Interaction Response Payload
         CONFIGURATION = 4,                     // Environment variables update
+        LOG = 5,                                    // Log lines request, answered on status topic
         Reserved = 255,                             // Reserved
     };
 
@@ -101,12 +258,12 @@ public:
 
     // MQTT
     PubSubClient *mqtt_client = nullptr;
-    char mqtt_device_channel[128];
-    char mqtt_device_channels[128];
-    char mqtt_device_status_channel[128];
-    String thinx_mqtt_channel();
-    String thinx_mqtt_channels();
-    String thinx_mqtt_status_channel();
+    char mqtt_device_channel[128] = {0};
+    char mqtt_device_channels[128] = {0};
+    char mqtt_device_status_channel[128] = {0};
+    String thinx_mqtt_channel();              // DEPRECATED, use mqtt_device_channel
+    String thinx_mqtt_channels();             // DEPRECATED, use mqtt_device_channels
+    String thinx_mqtt_status_channel();       // DEPRECATED, use mqtt_device_status_channel
 
     // Values imported on from thinx.h
     const char* app_version;                  // max 80 bytes
@@ -114,7 +271,7 @@ public:
     const char* thinx_cloud_url;              // up to 1k but generally something where FQDN fits
     const char* thinx_commit_id;              // 40 bytes + 1
     const char* thinx_firmware_version_short; // 14 bytes
-    const char* thinx_firmware_version;       // max 80 bytes
+    const char* thinx_firmware_version;       // max THINX_FIRMWARE_VERSION_SIZE (80) bytes
     const char* thinx_mqtt_url;               // up to 1k but generally something where FQDN fits
     const char* thinx_version_id;             // max 80 bytes (DEPRECATED?)
 
@@ -135,6 +292,16 @@ public:
     void setMQTTCallback( void (*func)(String) );
     void setLastWill(String nextWill);        // disconnect MQTT and reconnect with different lastWill than default
 
+#ifdef __USE_ENV_STORE__
+    // Configuration Push, handlers are called only when the value of their key changes
+    bool onEnv(const char *key, void (*handler)(const char *));
+    bool onEnv(const char *key, void (*handler)(long));
+    bool onEnv(const char *key, void (*handler)(double));
+    bool onEnv(const char *key, void (*handler)(bool));
+    bool env(const char *key, char *value, size_t size); // last pushed value as text, false if unknown
+    bool envChanged(const char *key);         // changed by last Configuration Push
+#endif
+
     int wifi_connection_in_progress;
 
     // MQTT Support
@@ -144,12 +311,18 @@ public:
     void publishStatusUnretained(String);     // DEPRECATED, send String to status topic (unretained)
     void publishStatusRetain(String, bool);   // DEPRECATED, send String to status topic (optionally retained)
     void publish_status(char *message, bool retain);  // send string to status topic, set retain
+    void publish_status(JsonObject &message, bool retain); // stream JSON to status topic, no String copy
     void publish_status_unretained(char *);   // send string to status topic, unretained
 
     // publish to specified topic
     void publish(String, String, bool);       // send String to any channel, optinally with retain
     void publish(char * message, char * topic, bool retain);
 
+    // publish by handle, topic is formatted once on registration (and when device channel changes)
+    thinx_topic_t registerTopic(const char *subtopic); // THINX_TOPIC_NONE when registry is full
+    bool publish(thinx_topic_t topic, const uint8_t *payload, size_t length, bool retain = false); // queued while MQTT is down
+    bool publish(thinx_topic_t topic, const char *message, bool retain = false);
+
     static const char time_format[];
     static const char date_format[];
 
@@ -208,12 +381,21 @@ private:
     static char thx_owner_key[65];          // static due to accesibility to WiFiManager
 
     char mac_string[17];
-    const char * thinx_mac();
 
-    char json_info[512] = {0};               // statically allocated to prevent fragmentation
+    // Topic registry, each topic is device channel prefix + sub-topic
+    char topic_pool[THINX_TOPIC_POOL_SIZE];
+    uint16_t topic_offset[THINX_TOPICS];
+    uint8_t topic_length[THINX_TOPICS];       // 0 if it did not fit after prefix change
+    uint8_t topic_count = 0;
+    uint8_t topic_prefix_length = 0;          // "/owner/udid/", 0 until known
+    void build_topics();                      // formats device channels, re-prefixes registered topics
+    thinx_topic_t find_topic(const char *subtopic);
+    const char * thinx_mac();
 
     String json_output;
 
+    phase arena_phase;                      // phase whose scratch arena usage is being tracked
+
     // In order of appearance
     bool fsck();                            // check filesystem if using SPIFFS
     void connect();                         // start the connect loop
@@ -221,23 +403,70 @@ private:
 
     void senddata(String);                  // HTTP, will deprecate?
     void send_data(String);                 // HTTPS
-    void fetch_data();                      // fetch and parse; max return char[] later
+    void fetch_data(Client &client);        // reads the response from the client that sent the request, then parses it
     void parse(String);                     // needs to be refactored to char[] from String
+    void parse_payload(JsonObject &root, payload_type ptype, String &body);
+#ifdef __USE_MSGPACK__
+    bool msgpack_accepted = false;          // negotiated by Content-Type of API response
+    void parse_msgpack(const uint8_t *data, size_t length, String *json = NULL); // json: document rendered for user callbacks
+    void parse_msgpack_root(JsonObject &root, String *json);
+#endif
     void update_and_reboot(String);
+    void publish_log(int lines);            // newest log lines to status topic
 
     int timezone_offset = 2;
-    unsigned long checkin_timeout = 3600 * 1000;          // next timeout millis()
+    unsigned long checkin_timeout = 0;                    // next checkin millis()
     unsigned long checkin_interval = 3600 * 1000;  // can be set externaly, defaults to 1h
+    unsigned long checkin_backoff = 0;             // current retry delay after failure, 0 when healthy
+    unsigned long checkin_hint = 0;                // server-sent next_checkin (ms), used once
+    unsigned long retry_after = 0;                 // server-sent Retry-After (ms), used once
+    int checkin_status = 0;                        // HTTP status of last checkin, 0 on connection failure
+
+    unsigned long device_jitter(unsigned long window); // deterministic per-device offset within window
+#ifdef __USE_DELTA_CHECKIN__
+    thinx_checkin_state_t checkin_state;    // acknowledged field hashes, survives deep sleep
+    uint32_t checkin_pending[THINX_CHECKIN_FIELDS]; // field hashes of checkin in flight
+    bool checkin_field(JsonObject &root, int index, const thinx_key<const char *> &key, const char *value, uint32_t hash = 0);
+    uint32_t checkin_state_hash();
+    void acknowledge_checkin(bool accepted);   // commits or drops pending field hashes
+    void restore_checkin_state();
+#endif
+    void schedule_checkin();                // sets checkin_timeout from result of last checkin
+    bool checkin_due();
 
     unsigned long last_checkin_millis;
     unsigned long last_checkin_timestamp;
 
-    unsigned long reboot_timeout = 86400 * 1000;          // next timeout millis()
+    unsigned long reboot_timeout = 0;                     // next reboot millis()
     unsigned long reboot_interval = 86400 * 1000;  // can be set externaly, defaults to 24h
 
     // MQTT
-    bool start_mqtt();                      // connect to broker and subscribe
+    bool start_mqtt();                      // sends CONNECT, mqtt_step() waits for CONNACK
     int mqtt_connected;                    // success or failure on subscription
+
+    // MQTT connection, advanced by loop() without waiting for the broker
+    enum mqtt_connection_state {
+      MQTT_IDLE = 0,                          // not started, CONNECT_MQTT phase starts it
+      MQTT_BACKOFF = 1,                       // next attempt at mqtt_retry_at
+      MQTT_CONNECTING = 2,                    // CONNECT sent, waiting for CONNACK
+      MQTT_SUBSCRIBING = 3,                   // SUBSCRIBE sent, waiting for SUBACK
+      MQTT_UP = 4                             // subscribed
+    };
+    mqtt_connection_state mqtt_state = MQTT_IDLE;
+    unsigned long mqtt_retry_at = 0;
+    unsigned long mqtt_backoff_delay = 0;   // current reconnect delay, 0 after success
+    void mqtt_step();
+    void mqtt_attempt();
+    void mqtt_backoff();                    // doubles delay before next attempt, plus per-device jitter
+    void mqtt_subscribe();                  // subscribes the device channel unless the session kept it
+    void mqtt_established();                // announces, flushes pending publishes
+    uint8_t mqtt_pending[THINX_MQTT_PENDING_SIZE]; // topic, retain, 16-bit length, payload; oldest first
+    uint16_t mqtt_pending_length = 0;
+    #ifdef __USE_MQTT_SESSION__
+    bool mqtt_clean_session = false;        // next CONNECT drops the stored session, device channel changed
+    #endif
+    bool queue_pending(thinx_topic_t topic, const uint8_t *payload, size_t length, bool retain);
+    void flush_pending();
     String mqtt_payload;                    // mqtt_payload store for parsing
     int performed_mqtt_checkin;              // one-time flag
     int all_done;                              // finalize flag
@@ -249,7 +478,24 @@ private:
     void import_build_time_constants();     // sets variables from thinx.h file
     void save_device_info();                // saves variables to SPIFFS or EEPROM
     void restore_device_info();             // reads variables from SPIFFS or EEPROM
-    void deviceInfo();                    // TODO: Refactor to C-string
+    size_t deviceInfo(char *buffer, size_t size); // renders persistent device info JSON, returns length, 0 if not built
+
+#ifdef __USE_ENV_STORE__
+    uint32_t env_keys[THINX_ENV_SLOTS];     // hash index of persisted store, values stay in SPIFFS/EEPROM
+    uint32_t env_values[THINX_ENV_SLOTS];
+    uint32_t env_changed;                   // slot mask of last Configuration Push
+    thinx_env_handler_t env_handlers[THINX_ENV_HANDLERS];
+    size_t env_handler_count = 0;
+    size_t apply_env(JsonObject &configuration); // persists changed keys and calls their handlers, returns count
+    void call_env_handlers(uint32_t key, JsonVariant value, const char *text);
+    bool add_env_handler(const char *key, thinx_env_handler_t &handler);
+    int env_slot(uint32_t key, const char *name = NULL); // -1 if not stored
+    int env_free_slot(uint32_t pushed);     // replaces a key missing from push when full, -1 if none
+    void restore_env();                     // loads hash index, recreates invalid store
+    bool format_env();
+    bool read_env_slot(int slot, thinx_env_slot_t *entry);
+    bool write_env_slot(int slot, const thinx_env_slot_t *entry);
+#endif
 
     // Updates
     void notify_on_successful_update();     // send a MQTT notification back to Web UI
@@ -263,6 +509,52 @@ private:
     void (*_finalize_callback)(void) = NULL;
     void finalize();                        // Complete the checkin, schedule, callback...
 
+#ifdef __ENABLE_WIFI_MIGRATION__
+    // WiFi migration on Configuration Push, advanced by loop()
+    enum wifi_migration_state {
+      MIGRATION_IDLE = 0,
+      MIGRATION_PENDING = 1,                  // credentials received in MQTT callback
+      MIGRATION_CONNECTING = 2,               // joining pushed network until deadline
+      MIGRATION_ROLLBACK = 3                  // joining last working network until deadline
+    };
+    wifi_migration_state wifi_migration = MIGRATION_IDLE;
+    unsigned long wifi_migration_deadline = 0;
+    const char *wifi_migration_result = NULL; // published once MQTT is connected again
+    char wifi_migration_ssid[33];
+    char wifi_migration_pass[65];
+    char wifi_rollback_ssid[33];
+    char wifi_rollback_pass[65];
+    void migrate_wifi(const char *ssid, const char *pass);
+    bool wifi_migration_step();             // true while migration owns the network
+    void publish_wifi_migration();
+#endif
+
+#ifdef __USE_WIFI_STORE__
+    // Remembered networks, tried before the portal opens
+    enum wifi_store_state {
+      STORE_IDLE = 0,
+      STORE_FAST = 1,                         // most recent network with its cached BSSID/channel
+      STORE_SCAN = 2,                         // scanning to rank remembered networks
+      STORE_TRY = 3                           // next remembered network seen by scan
+    };
+    thinx_wifi_store_t wifi_store;
+    wifi_store_state wifi_store_phase = STORE_IDLE;
+    int8_t wifi_store_order[THINX_WIFI_STORE_SIZE]; // candidates by rank, -1 terminated
+    uint8_t wifi_store_next;
+    int wifi_store_current;
+    unsigned long wifi_store_deadline;
+    bool wifi_store_changed = false;        // failures recorded, saved with next success or when all failed
+    bool start_wifi_store();                // true if remembered networks will be tried
+    bool wifi_store_step();                 // true while a remembered network is being tried
+    void wifi_store_attempt(int index);
+    void rank_wifi_store(int count);        // orders candidates by scan result
+    int wifi_store_newest();
+    void remember_network();                // stores current network after successful connection
+    void restore_wifi_store();
+    void save_wifi_store();
+    uint32_t wifi_store_checksum();
+#endif
+
     // Local WiFi Impl
     bool wifi_wait_for_connect;
     unsigned long wifi_wait_start;
@@ -278,6 +570,21 @@ private:
     // SSL/TLS
     void sync_sntp();                     // Synchronize time using SNTP instead of THiNX
 
+    // DNS
+    bool resolve(const char *host, IPAddress &address); // cached hostname lookup used by plain (forceHTTP) connect paths
+    void invalidate_address(const char *host);           // forget cached address after failed connect
+#ifdef __USE_DNS_CACHE__
+    thinx_dns_cache_t dns_cache;
+    bool dns_revalidate;                  // stale entries served, refresh when idle
+    unsigned long dns_retry_at;           // next refresh after a failed lookup
+    unsigned long dns_retry_delay;        // doubles while the resolver is down, 0 after success
+    void restore_dns_cache();             // reads cache from RTC memory (survives reset and deep sleep)
+    void save_dns_cache();                // writes cache to RTC memory
+    void revalidate_dns_cache();          // refreshes stale entries outside of connect paths
+    uint32_t dns_cache_checksum();
+    thinx_dns_entry_t * dns_cache_entry(const char *host);
+#endif
+
     // debug
     void printStackHeap(String);
 };
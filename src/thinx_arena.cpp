@@ -0,0 +1,61 @@
+/*
+* THiNX scratch arena, see thinx_arena.h
+*/
+
+#include "thinx_arena.h"
+#include "thinx_log.h"
+
+uint8_t THiNXArena::buffer[THINX_ARENA_SIZE] __attribute__((aligned(4)));
+size_t THiNXArena::top = 0;
+size_t THiNXArena::high_water = 0;
+uint16_t THiNXArena::overflow_count = 0;
+uint16_t THiNXArena::corruption_count = 0;
+
+void *THiNXArena::alloc(size_t size) {
+  size = (size + 3) & ~3; // keep 4-byte alignment for JsonBuffer nodes
+  if (top + size > THINX_ARENA_SIZE) {
+    overflow_count++;
+    THX_LOGE("Arena overflow, %u bytes requested, %u free.", size, THINX_ARENA_SIZE - top);
+    return NULL;
+  }
+  void *p = &buffer[top];
+  top += size;
+  if (top > high_water) {
+    high_water = top;
+  }
+  return p;
+}
+
+void THiNXArena::release(size_t mark) {
+  if (mark < top) {
+    top = mark;
+  }
+}
+
+void THiNXArena::report(const char *phase) {
+  THX_LOGD("Arena [%s] peak %u/%u bytes, overflows %u, corruptions %u",
+    phase, high_water, THINX_ARENA_SIZE, overflow_count, corruption_count);
+  high_water = top;
+}
+
+THiNXLease::THiNXLease(size_t size) {
+  start = THiNXArena::mark();
+  length = size;
+  ptr = (uint8_t *) THiNXArena::alloc(size + sizeof(uint32_t));
+  if (ptr != NULL) {
+    uint32_t guard = THINX_ARENA_GUARD;
+    memcpy(ptr + size, &guard, sizeof(guard)); // may be unaligned
+  }
+}
+
+THiNXLease::~THiNXLease() {
+  if (ptr != NULL) {
+    uint32_t guard;
+    memcpy(&guard, ptr + length, sizeof(guard));
+    if (guard != THINX_ARENA_GUARD) {
+      THiNXArena::corruption_count++;
+      THX_LOGE("Arena lease of %u bytes overrun!", length);
+    }
+  }
+  THiNXArena::release(start);
+}
@@ -0,0 +1,114 @@
+/*
+* THiNX scratch arena
+*
+* THiNXLib phases (check-in, response parsing, MQTT publish) run one after
+* another, so they borrow scratch memory from one statically reserved arena
+* instead of each keeping its own stack arrays and heap buffers.
+*
+* Leases are scoped and released in reverse order (like stack frames).
+* A lease that does not fit returns NULL and is counted as overflow; writes
+* past the end of a lease are detected by a guard word on release.
+*/
+
+#ifndef THINX_ARENA_H
+#define THINX_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "thinx_schema.h"
+
+// Largest leases, the arena is sized from them
+#define THINX_FETCH_BUFFER_SIZE 1024    // API response body
+#define THINX_DEVICE_INFO_SIZE 512      // persisted device info JSON
+#define THINX_PARSE_SLACK 512           // nodes of a response parsed without schema, beyond its length
+
+constexpr size_t thinx_lease_size(size_t bytes) { return (bytes + sizeof(uint32_t) + 3) & ~(size_t) 3; } // guard word, 4-byte aligned
+constexpr size_t thinx_larger(size_t a, size_t b) { return (a > b) ? a : b; }
+
+// Deepest nesting of leases: a response is parsed once the fetch buffer is
+// released, then saving device info leases its JSON and record on top.
+// MQTT device channel messages up to THINX_FETCH_BUFFER_SIZE take the same path, larger ones are parsed on the heap.
+constexpr size_t thinx_arena_need = thinx_larger(
+  thinx_lease_size(THINX_FETCH_BUFFER_SIZE),
+  thinx_larger(
+    thinx_larger(
+      thinx_lease_size(thinx_registration_response::filter_capacity) + thinx_lease_size(thinx_registration_response::capacity),
+      thinx_lease_size(thinx_update::filter_capacity) + thinx_lease_size(thinx_update::capacity)),
+    thinx_lease_size(THINX_FETCH_BUFFER_SIZE + THINX_PARSE_SLACK))
+  + thinx_lease_size(THINX_DEVICE_INFO_SIZE) + thinx_lease_size(thinx_device_record::capacity));
+
+#ifndef THINX_ARENA_SIZE
+#define THINX_ARENA_SIZE thinx_arena_need
+#endif
+
+static_assert(THINX_ARENA_SIZE >= thinx_arena_need, "THINX_ARENA_SIZE does not fit parsing a response and saving device info");
+
+#define THINX_ARENA_GUARD 0xA5E9A5E9UL
+
+class THiNXArena {
+
+public:
+    static void *alloc(size_t size);      // NULL when arena is exhausted
+    static size_t mark() { return top; }
+    static void release(size_t mark);
+
+    static size_t used() { return top; }
+    static size_t peak() { return high_water; }
+    static uint16_t overflows() { return overflow_count; }
+    static uint16_t corruptions() { return corruption_count; }
+
+    static void report(const char *phase); // prints and resets peak usage
+
+private:
+    friend class THiNXLease;
+    static uint8_t buffer[THINX_ARENA_SIZE];
+    static size_t top;
+    static size_t high_water;
+    static uint16_t overflow_count;
+    static uint16_t corruption_count;
+};
+
+// Scoped scratch memory, released when it goes out of scope.
+class THiNXLease {
+
+public:
+    explicit THiNXLease(size_t size);
+    ~THiNXLease();
+
+    bool ok() const { return ptr != NULL; }
+    size_t size() const { return ptr ? length : 0; }
+    char *c_str() { return (char *) ptr; }
+    uint8_t *bytes() { return ptr; }
+
+private:
+    THiNXLease(const THiNXLease &);             // non-copyable
+    THiNXLease &operator=(const THiNXLease &);
+
+    size_t start;
+    size_t length;
+    uint8_t *ptr;
+};
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+#endif
+
+// StaticJsonBuffer whose memory is leased from the arena for its lifetime.
+// Zero capacity (and failing parse) when the arena is exhausted.
+class THiNXJsonBuffer : private THiNXLease, public ArduinoJson::Internals::StaticJsonBufferBase {
+
+public:
+    explicit THiNXJsonBuffer(size_t capacity)
+        : THiNXLease(capacity),
+          ArduinoJson::Internals::StaticJsonBufferBase(THiNXLease::c_str(), THiNXLease::size()) {}
+
+    using ArduinoJson::Internals::StaticJsonBufferBase::size;
+};
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
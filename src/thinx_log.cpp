@@ -0,0 +1,103 @@
+/*
+* THiNX logging, see thinx_log.h
+*/
+
+#include "thinx_log.h"
+
+#include <stdarg.h>
+
+char THiNXLog::buffer[THINX_LOG_BUFFER_SIZE];
+size_t THiNXLog::head = 0;
+size_t THiNXLog::length = 0;
+size_t THiNXLog::unsent = 0;
+uint16_t THiNXLog::drop_count = 0;
+
+void THiNXLog::write(char level, PGM_P format, ...) {
+  char line[THINX_LOG_LINE_SIZE];
+  size_t len = snprintf(line, sizeof(line), "*TH: %c ", level);
+  size_t room = sizeof(line) - len - 1; // keeps space for '\n'
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf_P(line + len, room, format, args);
+  va_end(args);
+  if (n > 0) {
+    len += ((size_t) n < room) ? (size_t) n : room - 1;
+  }
+  line[len++] = '\n';
+
+  while (length + len > THINX_LOG_BUFFER_SIZE) {
+    discard_oldest();
+  }
+  for (size_t i = 0; i < len; i++) {
+    buffer[head] = line[i];
+    head = (head + 1) % THINX_LOG_BUFFER_SIZE;
+  }
+  length += len;
+  unsent += len;
+  drain();
+}
+
+void THiNXLog::discard_oldest() {
+  size_t start = (head + THINX_LOG_BUFFER_SIZE - length) % THINX_LOG_BUFFER_SIZE;
+  size_t n = 0;
+  while (n < length) {
+    if (buffer[(start + n++) % THINX_LOG_BUFFER_SIZE] == '\n') break;
+  }
+  length -= n;
+  if (unsent > length) {
+    unsent = length; // Serial could not keep up
+    drop_count++;
+  }
+}
+
+void THiNXLog::drain() {
+#if THINX_LOG_SERIAL
+  while (unsent > 0) {
+    int room = Serial.availableForWrite();
+    if (room <= 0) {
+      return; // rest goes out on next write or loop()
+    }
+    size_t start = (head + THINX_LOG_BUFFER_SIZE - unsent) % THINX_LOG_BUFFER_SIZE;
+    size_t chunk = THINX_LOG_BUFFER_SIZE - start; // up to the end of the ring
+    if (chunk > unsent) chunk = unsent;
+    if (chunk > (size_t) room) chunk = room;
+    Serial.write((const uint8_t *) &buffer[start], chunk);
+    unsent -= chunk;
+  }
+#endif
+}
+
+void THiNXLog::flush() {
+#if THINX_LOG_SERIAL
+  while (unsent > 0) {
+    size_t start = (head + THINX_LOG_BUFFER_SIZE - unsent) % THINX_LOG_BUFFER_SIZE;
+    size_t chunk = THINX_LOG_BUFFER_SIZE - start;
+    if (chunk > unsent) chunk = unsent;
+    Serial.write((const uint8_t *) &buffer[start], chunk);
+    unsent -= chunk;
+  }
+  Serial.flush();
+#endif
+}
+
+size_t THiNXLog::tail(char *out, size_t size, uint8_t lines) {
+  if (size == 0) {
+    return 0;
+  }
+  // walks back from the newest line while whole lines fit
+  size_t bytes = 0;
+  for (uint8_t count = 0; (count < lines) && (bytes < length); count++) {
+    size_t line = 1; // its '\n'
+    while ((bytes + line < length) && (buffer[(head + 2 * THINX_LOG_BUFFER_SIZE - bytes - line - 1) % THINX_LOG_BUFFER_SIZE] != '\n')) {
+      line++;
+    }
+    if (bytes + line > size - 1) break;
+    bytes += line;
+  }
+  size_t start = (head + THINX_LOG_BUFFER_SIZE - bytes) % THINX_LOG_BUFFER_SIZE;
+  for (size_t i = 0; i < bytes; i++) {
+    out[i] = buffer[(start + i) % THINX_LOG_BUFFER_SIZE];
+  }
+  out[bytes] = 0;
+  return bytes;
+}
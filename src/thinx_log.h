@@ -0,0 +1,79 @@
+/*
+* THiNX logging
+*
+* Messages below THINX_LOG_LEVEL are removed by the preprocessor together with
+* their arguments. The rest is formatted into one line and appended to a RAM
+* ring buffer, which keeps the last lines for the MQTT "log" command and is
+* drained to Serial only as fast as the UART accepts bytes, so a log line never
+* waits for the UART. With THINX_LOG_SERIAL 0 the ring buffer is the only sink.
+*/
+
+#ifndef THINX_LOG_H
+#define THINX_LOG_H
+
+#include <Arduino.h>
+
+#define THINX_LOG_NONE 0
+#define THINX_LOG_ERROR 1
+#define THINX_LOG_WARN 2
+#define THINX_LOG_INFO 3
+#define THINX_LOG_DEBUG 4
+
+#ifndef THINX_LOG_LEVEL
+#define THINX_LOG_LEVEL THINX_LOG_INFO
+#endif
+
+#ifndef THINX_LOG_SERIAL
+#define THINX_LOG_SERIAL 1                // 0 drops Serial, lines are kept in RAM only
+#endif
+
+#ifndef THINX_LOG_BUFFER_SIZE
+#define THINX_LOG_BUFFER_SIZE 1024        // last lines kept in RAM
+#endif
+
+#define THINX_LOG_LINE_SIZE 128           // longer lines are truncated
+
+class THiNXLog {
+
+public:
+    static void write(char level, PGM_P format, ...); // level 'E', 'W', 'I' or 'D'
+    static void drain();                  // sends what the UART accepts without waiting
+    static void flush();                  // sends everything, waits (before restart)
+    static size_t tail(char *out, size_t size, uint8_t lines); // newest lines that fit, '\n' separated
+
+    static uint16_t dropped() { return drop_count; }
+
+private:
+    static void discard_oldest();
+    static char buffer[THINX_LOG_BUFFER_SIZE];
+    static size_t head;                   // next byte written
+    static size_t length;                 // bytes held, oldest at head - length
+    static size_t unsent;                 // newest bytes not drained to Serial yet
+    static uint16_t drop_count;           // lines overwritten before reaching Serial
+};
+
+#if THINX_LOG_LEVEL >= THINX_LOG_ERROR
+#define THX_LOGE(format, ...) THiNXLog::write('E', PSTR(format), ##__VA_ARGS__)
+#else
+#define THX_LOGE(format, ...) do {} while (0)
+#endif
+
+#if THINX_LOG_LEVEL >= THINX_LOG_WARN
+#define THX_LOGW(format, ...) THiNXLog::write('W', PSTR(format), ##__VA_ARGS__)
+#else
+#define THX_LOGW(format, ...) do {} while (0)
+#endif
+
+#if THINX_LOG_LEVEL >= THINX_LOG_INFO
+#define THX_LOGI(format, ...) THiNXLog::write('I', PSTR(format), ##__VA_ARGS__)
+#else
+#define THX_LOGI(format, ...) do {} while (0)
+#endif
+
+#if THINX_LOG_LEVEL >= THINX_LOG_DEBUG
+#define THX_LOGD(format, ...) THiNXLog::write('D', PSTR(format), ##__VA_ARGS__)
+#else
+#define THX_LOGD(format, ...) do {} while (0)
+#endif
+
+#endif
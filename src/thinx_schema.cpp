@@ -0,0 +1,37 @@
+/*
+* THiNX message schemas, see thinx_schema.h
+*/
+
+#include "thinx_schema.h"
+#include "thinx_log.h"
+
+JsonObject &thinx_filter(JsonBuffer &buffer, const thinx_field *fields, size_t count) {
+  JsonObject &filter = buffer.createObject();
+  for (size_t i = 0; i < count; i++) {
+    JsonObject &parent = fields[i].parent ? filter[fields[i].parent].as<JsonObject>() : filter;
+    if (fields[i].object) {
+      parent.createNestedObject(fields[i].key);
+    } else {
+      parent[fields[i].key] = true;
+    }
+  }
+  return filter;
+}
+
+bool thinx_valid(JsonObject &root, const thinx_field *fields, size_t count) {
+  if (!root.success()) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (fields[i].object) {
+      continue;
+    }
+    JsonObject &parent = fields[i].parent ? root[fields[i].parent].as<JsonObject>() : root;
+    const char *value = parent[fields[i].key].as<const char *>(); // NULL unless a string
+    if ((value != NULL) && (strlen(value) > fields[i].length)) {
+      THX_LOGW("'%s' exceeds %u characters, message rejected.", fields[i].key, fields[i].length);
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,238 @@
+/*
+* THiNX message schemas
+*
+* Each message lists its members once, with the longest value each may hold.
+* JsonBuffer capacities are computed from that list at compile time and the
+* typed accessors below only accept members of the right type, so messages
+* never need a guessed or growing buffer. A parsed message with a value longer
+* than its schema allows is rejected as a whole.
+*/
+
+#ifndef THINX_SCHEMA_H
+#define THINX_SCHEMA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Longest firmware version string (THINX_FIRMWARE_VERSION, thinx_firmware_version)
+#define THINX_FIRMWARE_VERSION_SIZE 80
+
+// What the buffer holds besides objects and members
+enum thinx_buffer_use {
+  THINX_NODES,    // nothing else: filters, in-place parsing of char[]
+  THINX_BUILD,    // values set as char* (duplicated)
+  THINX_PARSE     // keys and values copied from const input
+};
+
+struct thinx_field {
+  const char *key;
+  const char *parent;     // enclosing object member, NULL at top level
+  size_t length;          // longest value in characters (as text when parsed)
+  bool copied;            // char* values are duplicated into the buffer
+  bool object;
+};
+
+template <typename T> struct thinx_value_traits {
+  static const bool copied = false;
+  static const bool object = false;
+};
+template <> struct thinx_value_traits<char *> {
+  static const bool copied = true;
+  static const bool object = false;
+};
+template <> struct thinx_value_traits<JsonObject> {
+  static const bool copied = false;
+  static const bool object = true;
+};
+
+// Member of type T; T = JsonObject for nested objects
+template <typename T> struct thinx_key : thinx_field {
+  constexpr thinx_key(const char *key, size_t length, const char *parent = NULL)
+    : thinx_field{key, parent, length, thinx_value_traits<T>::copied, thinx_value_traits<T>::object} {}
+};
+
+constexpr size_t thinx_align(size_t bytes) {
+  return (bytes + sizeof(void *) - 1) & ~(sizeof(void *) - 1); // JsonBuffer aligns after each string
+}
+
+constexpr size_t thinx_strlen(const char *s) {
+  return *s ? 1 + thinx_strlen(s + 1) : 0;
+}
+
+constexpr size_t thinx_field_size(const thinx_field &f, thinx_buffer_use use) {
+  return JSON_OBJECT_SIZE(1) - JSON_OBJECT_SIZE(0)
+    + (f.object ? JSON_OBJECT_SIZE(0) : 0)
+    + (use == THINX_PARSE ? thinx_align(thinx_strlen(f.key) + 1) : 0)
+    + ((use == THINX_PARSE && !f.object) || (use == THINX_BUILD && f.copied) ? thinx_align(f.length + 1) : 0);
+}
+
+template <size_t N>
+constexpr size_t thinx_fields_size(const thinx_field (&fields)[N], thinx_buffer_use use, size_t i = 0) {
+  return i == N ? 0 : thinx_field_size(fields[i], use) + thinx_fields_size(fields, use, i + 1);
+}
+
+// Exact JsonBuffer capacity for a message (root object included)
+template <size_t N>
+constexpr size_t thinx_capacity(const thinx_field (&fields)[N], thinx_buffer_use use) {
+  return JSON_OBJECT_SIZE(0) + thinx_fields_size(fields, use);
+}
+
+// Filter for JsonBuffer::parseObject(input, filter) selecting schema members only
+JsonObject &thinx_filter(JsonBuffer &buffer, const thinx_field *fields, size_t count);
+
+// True if every string member present fits its schema length
+bool thinx_valid(JsonObject &root, const thinx_field *fields, size_t count);
+
+template <size_t N>
+inline JsonObject &thinx_filter(JsonBuffer &buffer, const thinx_field (&fields)[N]) {
+  return thinx_filter(buffer, fields, N);
+}
+
+template <size_t N>
+inline bool thinx_valid(JsonObject &root, const thinx_field (&fields)[N]) {
+  return thinx_valid(root, fields, N);
+}
+
+// Typed accessors
+
+inline JsonObject &thinx_parent(JsonObject &root, const thinx_field &key) {
+  return key.parent ? root[key.parent].as<JsonObject>() : root;
+}
+
+template <typename T>
+inline bool thinx_has(JsonObject &root, const thinx_key<T> &key) {
+  return thinx_parent(root, key).containsKey(key.key);
+}
+
+template <typename T>
+inline T thinx_get(JsonObject &root, const thinx_key<T> &key) {
+  return thinx_parent(root, key)[key.key].template as<T>();
+}
+
+template <typename T> struct thinx_identity {
+  typedef T type;
+};
+
+inline bool thinx_fits(const char *value, size_t length) {
+  return strlen(value) <= length;
+}
+
+template <typename T>
+inline bool thinx_fits(T, size_t) {
+  return true;
+}
+
+// Rejects (and skips) strings longer than the schema allows
+template <typename T>
+inline bool thinx_set(JsonObject &root, const thinx_key<T> &key, typename thinx_identity<T>::type value) {
+  if (!thinx_fits(value, key.length)) {
+    return false;
+  }
+  return thinx_parent(root, key).set(key.key, value);
+}
+
+inline JsonObject &thinx_create(JsonObject &root, const thinx_key<JsonObject> &key) {
+  return root.createNestedObject(key.key);
+}
+
+/*
+* Registration request (check-in)
+*/
+
+namespace thinx_registration {
+  constexpr thinx_key<JsonObject> registration("registration", 0);
+  constexpr thinx_key<char *> state("state", 8, "registration");  // hex hash, local char[] copy
+  constexpr thinx_key<const char *> mac("mac", 17, "registration");
+  constexpr thinx_key<const char *> firmware("firmware", THINX_FIRMWARE_VERSION_SIZE, "registration");
+  constexpr thinx_key<const char *> version("version", 16, "registration");
+  constexpr thinx_key<const char *> commit("commit", 40, "registration");
+  constexpr thinx_key<const char *> owner("owner", 64, "registration");
+  constexpr thinx_key<const char *> alias("alias", 64, "registration");
+  constexpr thinx_key<const char *> udid("udid", 64, "registration");
+  constexpr thinx_key<const char *> status("status", 255, "registration");
+  constexpr thinx_key<const char *> lat("lat", 15, "registration");
+  constexpr thinx_key<const char *> lon("lon", 15, "registration");
+  constexpr thinx_key<const char *> rssi("rssi", 7, "registration");
+  constexpr thinx_key<const char *> platform("platform", 16, "registration");
+
+  constexpr thinx_field fields[] = {
+    registration, state, mac, firmware, version, commit, owner, alias, udid, status, lat, lon, rssi, platform
+  };
+  constexpr size_t capacity = thinx_capacity(fields, THINX_BUILD);
+}
+
+/*
+* Registration response, including the FIRMWARE_UPDATE status
+*/
+
+namespace thinx_registration_response {
+  constexpr thinx_key<JsonObject> registration("registration", 0);
+  constexpr thinx_key<bool> success("success", 5, "registration");
+  constexpr thinx_key<const char *> status("status", 16, "registration");
+  constexpr thinx_key<const char *> alias("alias", 64, "registration");
+  constexpr thinx_key<const char *> owner("owner", 64, "registration");
+  constexpr thinx_key<const char *> udid("udid", 64, "registration");
+  constexpr thinx_key<bool> auto_update("auto_update", 5, "registration");
+  constexpr thinx_key<bool> forced_update("forced_update", 5, "registration");
+  constexpr thinx_key<unsigned long> next_checkin("next_checkin", 10, "registration");
+  constexpr thinx_key<long> timestamp("timestamp", 11, "registration");
+  constexpr thinx_key<const char *> mac("mac", 17, "registration");
+  constexpr thinx_key<const char *> commit("commit", 40, "registration");
+  constexpr thinx_key<const char *> version("version", 16, "registration");
+  constexpr thinx_key<const char *> url("url", 256, "registration");
+  constexpr thinx_key<const char *> ott("ott", 64, "registration");
+  constexpr thinx_key<const char *> hash("hash", 64, "registration");
+  constexpr thinx_key<const char *> md5("md5", 32, "registration");
+
+  constexpr thinx_field fields[] = {
+    registration, success, status, alias, owner, udid, auto_update, forced_update,
+    next_checkin, timestamp, mac, commit, version, url, ott, hash, md5
+  };
+  constexpr size_t capacity = thinx_capacity(fields, THINX_PARSE);
+  constexpr size_t filter_capacity = thinx_capacity(fields, THINX_NODES);
+}
+
+/*
+* Firmware update push (details are read from its registration node)
+*/
+
+namespace thinx_update {
+  constexpr thinx_key<const char *> udid("udid", 64);
+  constexpr thinx_key<JsonObject> registration("registration", 0);
+  constexpr thinx_key<const char *> mac("mac", 17, "registration");
+  constexpr thinx_key<const char *> commit("commit", 40, "registration");
+  constexpr thinx_key<const char *> version("version", 16, "registration");
+  constexpr thinx_key<const char *> type("type", 16, "registration");
+  constexpr thinx_key<const char *> files("files", 256, "registration");
+  constexpr thinx_key<const char *> url("url", 256, "registration");
+  constexpr thinx_key<const char *> ott("ott", 64, "registration");
+  constexpr thinx_key<const char *> hash("hash", 64, "registration");
+  constexpr thinx_key<const char *> md5("md5", 32, "registration");
+
+  constexpr thinx_field fields[] = {
+    udid, registration, mac, commit, version, type, files, url, ott, hash, md5
+  };
+  constexpr size_t capacity = thinx_capacity(fields, THINX_PARSE);
+  constexpr size_t filter_capacity = thinx_capacity(fields, THINX_NODES);
+}
+
+/*
+* Persistent device record (SPIFFS/EEPROM)
+*/
+
+namespace thinx_device_record {
+  constexpr thinx_key<const char *> owner("owner", 64);
+  constexpr thinx_key<const char *> apikey("apikey", 64);
+  constexpr thinx_key<const char *> udid("udid", 64);
+  constexpr thinx_key<const char *> update("update", 256);
+  constexpr thinx_key<const char *> alias("alias", 64);
+  constexpr thinx_key<const char *> ott("ott", 64);
+
+  constexpr thinx_field fields[] = {
+    owner, apikey, udid, update, alias, ott
+  };
+  constexpr size_t capacity = thinx_capacity(fields, THINX_BUILD);
+  constexpr size_t parse_capacity = thinx_capacity(fields, THINX_NODES); // parsed in place
+}
+
+#endif